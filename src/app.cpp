@@ -1,11 +1,11 @@
 #include <unistd.h>
 #include <sys/wait.h>
-#ifdef __linux__
-#include <sys/prctl.h>
-#endif
+#include <sys/stat.h>
+#include <sys/inotify.h>
 #include <fcntl.h>
 #include <execinfo.h>
 #include <chrono>
+#include <ctime>
 #include <thread>
 #include <algorithm>
 #include <regex>
@@ -39,6 +39,7 @@ void SignalManager::catchSignal(int sig, siginfo_t *info, void *ctxt) {
     auto& tty = Tty::getInstance();
     tty.enableAutoWrap_s();
     tty.disableMouse_s();
+    tty.disableBracketedPaste_s();
     tty.showCursor_s();
     if ( ConfigManager::getInstance().getConfigValue<ConfigType::Height>() == 0 ) {
         tty.disableAlternativeBuffer_s();
@@ -158,7 +159,7 @@ Application::Application(int argc, char* argv[])
     result_content_(std::get<1>(previous_result_)),
     cpu_count_{ std::max(std::thread::hardware_concurrency(), 1u) },
     step_{ 100000 * cpu_count_ },
-    fuzzy_engine_(cpu_count_),
+    fuzzy_engine_(cpu_count_, ConfigManager::getInstance().getConfigValue<ConfigType::HugePage>()),
     key_map_{
         { "Ctrl_@", Key::Ctrl_At },
         { "Ctrl_A", Key::Ctrl_A },
@@ -293,6 +294,8 @@ Application::Application(int argc, char* argv[])
         { "DeleteLeftWord",         Operation::DeleteLeftWord },
         { "Page_Up",                Operation::PageUp },
         { "Page_Down",              Operation::PageDown },
+        { "JumpToFirstLine",        Operation::JumpToFirstLine },
+        { "JumpToLastLine",         Operation::JumpToLastLine },
         { "CursorMoveLeft",         Operation::CursorMoveLeft },
         { "CursorMoveRight",        Operation::CursorMoveRight },
         { "CursorMoveToBegin",      Operation::CursorMoveToBegin },
@@ -323,25 +326,31 @@ Application::Application(int argc, char* argv[])
         //{ Key::Shift_LeftMouse, Operation::Shift_LeftMouse },
     }, task_map_{
         { Operation::CursorLineMoveUp,
-            [this] { ui_queue_.put([this] { tui_.scrollUp<MainWindow>(); }); }
+            [this] { render_scheduler_.post([this] { tui_.scrollUp<MainWindow>(); }); }
         },
         { Operation::CursorLineMoveDown,
-            [this] { ui_queue_.put([this] { tui_.scrollDown<MainWindow>(); }); }
+            [this] { render_scheduler_.post([this] { tui_.scrollDown<MainWindow>(); }); }
         },
         { Operation::PageUp,
-            [this] { ui_queue_.put([this] { tui_.pageUp<MainWindow>(); }); }
+            [this] { render_scheduler_.post([this] { tui_.pageUp<MainWindow>(); }); }
         },
         { Operation::PageDown,
-            [this] { ui_queue_.put([this] { tui_.pageDown<MainWindow>(); }); }
+            [this] { render_scheduler_.post([this] { tui_.pageDown<MainWindow>(); }); }
+        },
+        { Operation::JumpToFirstLine,
+            [this] { render_scheduler_.post([this] { tui_.jumpTo<MainWindow>(0); }); }
+        },
+        { Operation::JumpToLastLine,
+            [this] { render_scheduler_.post([this] { tui_.jumpTo<MainWindow>(UINT32_MAX); }); }
         },
         { Operation::Single_Click,
-            [this] { ui_queue_.put([this, yx=current_yx_] { tui_.singleClick(yx); }); }
+            [this] { render_scheduler_.post([this, yx=current_yx_] { tui_.singleClick(yx); }); }
         },
         { Operation::Wheel_Down,
-            [this] { ui_queue_.put([this, yx=current_yx_] { tui_.wheelDown(yx); }); }
+            [this] { render_scheduler_.post([this, yx=current_yx_] { tui_.wheelDown(yx); }); }
         },
         { Operation::Wheel_Up,
-            [this] { ui_queue_.put([this, yx=current_yx_] { tui_.wheelUp(yx); }); }
+            [this] { render_scheduler_.post([this, yx=current_yx_] { tui_.wheelUp(yx); }); }
         },
     }, cmdline_task_map_{
         { Operation::Backspace,
@@ -354,7 +363,7 @@ Application::Application(int argc, char* argv[])
                     } while ( cursor_pos > 0 && !utils::is_utf8_boundary(pattern[cursor_pos]) );
                     pattern.erase(cursor_pos, orig_cursor_pos - cursor_pos);
 
-                    cmdline_queue_.put([this, pattern, cursor_pos] {
+                    render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                         tui_.updateCmdline(pattern, cursor_pos);
                     });
                 }
@@ -380,7 +389,7 @@ Application::Application(int argc, char* argv[])
                         } while ( cursor_pos > 0 && !utils::is_utf8_boundary(pattern[cursor_pos]) );
                         pattern.erase(cursor_pos, orig_cursor_pos - cursor_pos);
                     }
-                    cmdline_queue_.put([this, pattern, cursor_pos] {
+                    render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                         tui_.updateCmdline(pattern, cursor_pos);
                     });
                 }
@@ -392,7 +401,7 @@ Application::Application(int argc, char* argv[])
                     already_zero_ = false;
                     pattern.erase(0, cursor_pos);
                     cursor_pos = 0;
-                    cmdline_queue_.put([this, pattern, cursor_pos] {
+                    render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                         tui_.updateCmdline(pattern, cursor_pos);
                     });
                     _shorten(pattern, cursor_pos);
@@ -412,7 +421,7 @@ Application::Application(int argc, char* argv[])
                     --cursor_pos;
                 }
                 pattern.erase(cursor_pos, orig_cursor_pos - cursor_pos);
-                cmdline_queue_.put([this, pattern, cursor_pos] {
+                render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                     tui_.updateCmdline(pattern, cursor_pos);
                 });
 
@@ -429,7 +438,7 @@ Application::Application(int argc, char* argv[])
                         --cursor_pos;
                     } while ( cursor_pos > 0 && !utils::is_utf8_boundary(pattern[cursor_pos]) );
 
-                    cmdline_queue_.put([this, pattern, cursor_pos] {
+                    render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                         tui_.updateCmdline(pattern, cursor_pos);
                     });
                 }
@@ -446,7 +455,7 @@ Application::Application(int argc, char* argv[])
                     } while ( cursor_pos < pattern.length()
                               && !utils::is_utf8_boundary(pattern[cursor_pos]) );
 
-                    cmdline_queue_.put([this, pattern, cursor_pos] {
+                    render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                         tui_.updateCmdline(pattern, cursor_pos);
                     });
                 }
@@ -457,7 +466,7 @@ Application::Application(int argc, char* argv[])
                 if ( cursor_pos > 0 ) {
                     cursor_pos = 0;
                     already_zero_ = true;
-                    cmdline_queue_.put([this, pattern, cursor_pos] {
+                    render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                         tui_.updateCmdline(pattern, cursor_pos);
                     });
                 }
@@ -466,74 +475,75 @@ Application::Application(int argc, char* argv[])
         { Operation::CursorMoveToEnd,
             [this](std::string& pattern, uint32_t& cursor_pos) {
                 cursor_pos = pattern.length();
-                cmdline_queue_.put([this, pattern, cursor_pos] {
+                render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                     tui_.updateCmdline(pattern, cursor_pos);
                 });
             }
         },
     }
 {
-    content_.reserve(255);
-}
+    // the first pages of a result are highlighted without being matched again
+    fuzzy_engine_.setSpanCount(SpanCount);
+
+    auto& config = ConfigManager::getInstance();
+    if ( !config.getConfigValue<ConfigType::NoHistory>() ) {
+        auto file = FileCache::defaultPath(".", ".history");
+        if ( !file.empty() ) {
+            history_.open(file, time(nullptr));
+        }
+    }
 
-#ifdef __APPLE__
-constexpr int SIG_UserDefined = SIGUSR1;
-#else
-const int SIG_UserDefined = SIGRTMIN+8;
-#endif
-
-void Application::_handleSignal() {
-    sigset_t waitset;
-    sigemptyset(&waitset);
-
-    sigaddset(&waitset, SIGINT);    // ctrl-c
-    sigaddset(&waitset, SIGQUIT);
-    sigaddset(&waitset, SIGTERM);
-    sigaddset(&waitset, SIGTSTP);
-    sigaddset(&waitset, SIGCONT);
-    sigaddset(&waitset, SIGWINCH);
-    sigaddset(&waitset, SIG_UserDefined);
-
-    while ( running_.load(std::memory_order_relaxed) )  {
-        int sig;
-        int ret = sigwait(&waitset, &sig);
-        if ( ret != -1 ) {
-            switch ( sig )
-            {
-            case SIGINT:
-            case SIGQUIT:
-            case SIGTERM:
-                Tty::getInstance().exit();
-                return;
-            case SIGTSTP:
-                Cleanup::getInstance().doWork(false);
-                kill(getpid(), SIGSTOP);
-                sigstop_ = true;
-                break;
-            case SIGCONT:
-                if ( sigstop_ ) {
-                    sigstop_ = false;
-                    Tty::getInstance().setNewTerminal();
-                    _resume();
-                }
-                break;
-            case SIGWINCH:
-                break;
-            default:
-                if ( sig == SIG_UserDefined ) {
-                    return;
-                }
-                break;
+    // the lines are not hashed for an empty history
+    dedup_boost_ = config.getConfigValue<ConfigType::DedupBoost>();
+    keep_hashes_ = dedup_ || history_.size() > 0;
+    if ( dedup_boost_ || history_.size() > 0 ) {
+        // a bonus grows with the log of the count, e.g., a line accepted once in the last hour
+        // gains 40000, 2/3 of a character matched, so it decides between close matches only
+        fuzzy_engine_.setBonus([this](const StrType& str) -> weight_t {
+            // the hash kept at ingest, neither hashed again nor locked per line matched
+            uint32_t n = str.id - static_cast<uint32_t>(hash_snapshot_.first());
+            if ( n >= hash_snapshot_.size() ) {
+                return 0;
             }
+            const auto& line = hash_snapshot_[n];
+            weight_t bonus = 0;
+            if ( dedup_boost_ ) {
+                auto count = __atomic_load_n(&line.count, __ATOMIC_RELAXED);
+                bonus += count > 1 ? DedupBonus * (31 - __builtin_clz(count)) : 0;
+            }
+            auto frecency = history_.frecency(line.hash);
+            bonus += frecency > 0 ? HistoryBonus * (32 - __builtin_clz(frecency)) : 0;
+            return bonus;
+        });
+    }
+}
+
+// in the loop thread
+void Application::_handleSignal(int sig) {
+    switch ( sig )
+    {
+    case SIGINT:
+    case SIGQUIT:
+    case SIGTERM:
+        _notifyExit();
+        break;
+    case SIGTSTP:
+        Cleanup::getInstance().doWork(false);
+        kill(getpid(), SIGSTOP);
+        sigstop_ = true;
+        break;
+    case SIGCONT:
+        if ( sigstop_ ) {
+            sigstop_ = false;
+            Tty::getInstance().setNewTerminal();
+            _resume();
         }
-        //// for sigwaitinfo
-        //else if ( errno == EINTR ) {
-        //    continue;
-        //}
-        else {
-            Error::getInstance().appendError(ErrorMessage);
-            std::exit(EXIT_FAILURE);
-        }
+        break;
+    case SIGWINCH:
+        _resize();
+        break;
+    default:
+        break;
     }
 }
 
@@ -542,130 +552,254 @@ void Application::_readConfig() {
 }
 
 void Application::start() {
-    std::thread sig_handler(&Application::_handleSignal, this);
-    std::thread reader(&Application::_readData, this);
-    std::thread input(&Application::_input, this);
-    std::thread ui(&Application::_doWork, this, std::ref(ui_queue_));
-    std::thread cmdline(&Application::_doWork, this, std::ref(cmdline_queue_));
-    std::thread show_flag(&Application::_showFlag, this);
-
-    _doWork(task_queue_);
-
-    show_flag.join();
-    sig_handler.join();
-    reader.join();
-    input.join();
-    ui.join();
-    cmdline.join();
-}
+    using namespace std::chrono;
 
-int Application::_exec(const char* cmd) {
-    int fd[2];
+    sigset_t sig_set;
+    sigemptyset(&sig_set);
+    sigaddset(&sig_set, SIGINT);    // ctrl-c
+    sigaddset(&sig_set, SIGQUIT);
+    sigaddset(&sig_set, SIGTERM);
+    sigaddset(&sig_set, SIGTSTP);
+    sigaddset(&sig_set, SIGCONT);
+    sigaddset(&sig_set, SIGWINCH);
+    loop_.addSignals(sig_set, [this](int sig) { _handleSignal(sig); });
 
-    if ( pipe(fd) < 0 ) {
-        Error::getInstance().appendError(ErrorMessage);
-        std::exit(EXIT_FAILURE);
-        return -1;
+    auto& tty = Tty::getInstance();
+    input_timer_ = loop_.addTimer([this] {
+        auto& tty = Tty::getInstance();
+        tty.inputTimeout();
+        // e.g. a lone ESC is followed by a Timeout after another InputTimeout ms
+        if ( tty.hasPendingInput() ) {
+            loop_.startTimer(input_timer_, std::chrono::milliseconds(Tty::InputTimeout));
+        }
+        _handleKeys();
+    });
+    loop_.addReader(tty.inputFd(), [this] { _input(); });
+
+    ingest_timer_ = loop_.addTimer([this] { _ingest(); });
+    _openData();
+
+    flag_timer_ = loop_.addTimer([this] { _showFlag(true); });
+    loop_.startTimer(flag_timer_, microseconds(0), milliseconds(150));
+
+    std::thread task(&Application::_doWork, this, std::ref(task_queue_));
+
+    loop_.run();
+
+    task.join();
+
+    ConstString accepted;
+    if ( history_.isOpen() && tui_.getAcceptedString(accepted) ) {
+        history_.record(utils::hash64(accepted.str, accepted.len), time(nullptr));
     }
 
-    auto pid = fork();
-    if ( pid < 0 ) {
-        close(fd[0]);
-        close(fd[1]);
-        Error::getInstance().appendError(ErrorMessage);
-        std::exit(EXIT_FAILURE);
-        return -1;
+    if ( read_fd_ != STDIN_FILENO ) {
+        close(read_fd_);
     }
-    else if ( pid == 0 ) {
-#ifdef __linux__
-        prctl(PR_SET_PDEATHSIG, SIGKILL);
-#endif
-        close(fd[0]);
-        if ( fd[1] != STDOUT_FILENO ) {
-            dup2(fd[1], STDOUT_FILENO);
-            close(fd[1]);
-        }
-        execl("/bin/sh", "sh", "-c", cmd, nullptr);
-        std::exit(127);
+    if ( inotify_fd_ != -1 ) {
+        close(inotify_fd_);
     }
 
-    close(fd[1]);
-
-    return fd[0];
+    if ( ConfigManager::getInstance().getConfigValue<ConfigType::Stats>() ) {
+        _reportStatistics();
+    }
 }
 
-void Application::_readData() {
-    using namespace std::chrono;
+void Application::_reportStatistics() {
+    const auto& stats = fuzzy_engine_.getStatistics();
+    auto count = std::max(stats.search_count, static_cast<uint64_t>(1));
+    Statistics::getInstance().append(
+        utils::strFormat("searches: %llu, page faults per search: %.1f minor, %.1f major, %llu max",
+                         static_cast<unsigned long long>(stats.search_count),
+                         static_cast<double>(stats.minor_faults) / count,
+                         static_cast<double>(stats.major_faults) / count,
+                         static_cast<unsigned long long>(stats.max_faults)));
+    if ( dedup_ ) {
+        Statistics::getInstance().append(
+            utils::strFormat("duplicate lines skipped: %llu", static_cast<unsigned long long>(duplicate_count_)));
+    }
+}
 
-    struct FdRAII
-    {
-        explicit FdRAII(int fd) : fd(fd) {}
-        ~FdRAII() {
-            if ( fd != STDIN_FILENO ) {
-                close(fd);
-            }
+void Application::_openData() {
+    read_fd_ = STDIN_FILENO;
+    const auto& index_file = ConfigManager::getInstance().getConfigValue<ConfigType::Index>();
+    if ( !index_file.empty() ) {
+        std::string error;
+        line_index_.reset(new LineIndex);
+        if ( !line_index_->load(index_file, error) ) {
+            Error::getInstance().appendError(std::move(error));
+            std::exit(EXIT_FAILURE);
         }
-        int fd;
-    };
+        loop_.post([this] { _readIndex(0); });
+        return;
+    }
 
-    FdRAII read_fd = FdRAII(STDIN_FILENO);
     if ( isatty(STDIN_FILENO) ) {
-#ifdef __APPLE__
-        auto cmd = "find . -name \".\" -o -name \".*\" -prune -o -type f -print 2>/dev/null | cut -b3-";
-#else
-        auto cmd = "find . -name \".\" -o -name \".*\" -prune -o -type f -printf \"%P\n\" 2>/dev/null";
-#endif
-        read_fd.fd = _exec(cmd);
+        // the files under the current directory
+        file_walker_.reset(new FileWalker(cpu_count_,
+            [this](std::unique_ptr<char[]>&& data, uint32_t len) {
+                auto buffer = std::make_shared<DataBuffer>();
+                buffer->buffer = data.release();
+                buffer->len = len;
+                loop_.post([this, buffer]() mutable { _putData(std::move(buffer)); });
+            },
+            [this] {
+                loop_.post([this] { _endData(); });
+            }));
+        auto& config = ConfigManager::getInstance();
+        auto no_ignore = config.getConfigValue<ConfigType::NoIgnore>();
+        file_walker_->setIgnoreFiles(!no_ignore);
+        if ( !config.getConfigValue<ConfigType::NoCache>() ) {
+            file_walker_->setCacheFile(FileCache::defaultPath(".", no_ignore ? ".all" : ".files"));
+        }
+        file_walker_->start();
+        return;
+    }
+
+    if ( !loop_.addReader(read_fd_, [this] { _readData(); }) ) {
+        // a regular file is always readable, so it is read a buffer per loop iteration
+        loop_.post([this] { _readData(); });
     }
+}
 
-    BufferStorage storage;
-    auto start_time = steady_clock::now();
+// in the loop thread, reads a buffer each time read_fd_ is readable
+void Application::_readData() {
     char buffer[BufferLen];
-    while ( running_ ) {
-        auto len = read(read_fd.fd, buffer, sizeof(buffer));
-        if ( len < 0 ) {
-            if ( errno == EINTR ) {
-                continue;
-            }
-            else {
-                Error::getInstance().appendError(ErrorMessage);
-                std::exit(EXIT_FAILURE);
-            }
+    auto len = read(read_fd_, buffer, sizeof(buffer));
+    if ( len < 0 ) {
+        if ( errno == EINTR || errno == EAGAIN ) {
+            return;
         }
-        else if ( len == 0 ) {
-            // indicate the end
-            storage.put(std::make_shared<DataBuffer>());
-            task_queue_.put([this, s=std::move(storage)]() mutable {
-                _processData(std::move(s));
-            });
-
-            break;
+        else {
+            Error::getInstance().appendError(ErrorMessage);
+            std::exit(EXIT_FAILURE);
         }
-        storage.put(std::make_shared<DataBuffer>(buffer, len));
-        auto end_time = steady_clock::now();
-        if ( duration_cast<milliseconds>(end_time - start_time).count() > 50 ) {
-            start_time = end_time;
-            task_queue_.put([this, s=std::move(storage)]() mutable {
-                _processData(std::move(s));
-            });
+    }
+    else if ( len == 0 ) {
+        if ( ConfigManager::getInstance().getConfigValue<ConfigType::Follow>() && _watchData() ) {
+            return;
         }
+        loop_.removeReader(read_fd_);
+        _endData();
+        return;
+    }
+
+    _putData(std::make_shared<DataBuffer>(buffer, len));
+
+    if ( !loop_.hasReader(read_fd_) ) {
+        loop_.post([this] { _readData(); });
+    }
+}
+
+// in the loop thread, the end of a regular file is reached with --follow,
+// returns false if read_fd_ cannot be watched, e.g., it is a pipe
+bool Application::_watchData() {
+    if ( inotify_fd_ != -1 ) {
+        return true;
+    }
+
+    struct stat st;
+    if ( fstat(read_fd_, &st) == -1 || !S_ISREG(st.st_mode) ) {
+        return false;
+    }
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( inotify_fd_ == -1 ) {
+        return false;
+    }
+
+    // stdin has no path, the watch follows the file even if it is renamed
+    auto path = utils::strFormat<64>("/proc/self/fd/%d", read_fd_);
+    if ( inotify_add_watch(inotify_fd_, path.c_str(), IN_MODIFY) == -1 ) {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+        return false;
+    }
+    loop_.addReader(inotify_fd_, [this] { _readEvents(); });
+
+    // the lines read so far are all there is until the file grows
+    _ingest();
+    loop_.stopTimer(flag_timer_);
+    _showFlag(false);
+    return true;
+}
+
+// in the loop thread, the file followed is modified
+void Application::_readEvents() {
+    char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while ( read(inotify_fd_, events, sizeof(events)) > 0 ) {
+        // only the size of the file matters
+    }
+
+    // truncated, e.g., the log is rotated by copytruncate, read it from the beginning
+    struct stat st;
+    auto offset = lseek(read_fd_, 0, SEEK_CUR);
+    if ( fstat(read_fd_, &st) == 0 && offset != -1 && st.st_size < offset ) {
+        // the partial last line read before is a line of its own, as at the end of the input,
+        // instead of being continued by the new data
+        _ingest();
+        _pushIncomplete();
+        _evict();
+        _publish();
+        eol_ = '\0';
+        lseek(read_fd_, 0, SEEK_SET);
+    }
+
+    _readData();
+}
+
+// in the loop thread, adds IndexStep lines of line_index_ each time, no line is parsed
+void Application::_readIndex(uint64_t first) {
+    auto data = line_index_->data();
+    auto offsets = line_index_->offsets();
+    auto lengths = line_index_->lengths();
+    auto last = std::min(first + IndexStep, line_index_->size());
+    for ( auto i = first; i < last; ++i ) {
+        auto line = makeConstString(data + offsets[i], lengths[i]);
+        _pushContent(line, keep_hashes_ ? utils::hash64(line.str, line.len) : 0);
+    }
+
+    if ( last < line_index_->size() ) {
+        _publish();
+        loop_.post([this, last] { _readIndex(last); });
+    }
+    else {
+        _endData();
+    }
+}
+
+// in the loop thread, the buffers are ingested together at most every IngestInterval ms
+void Application::_putData(DataBufferPtr&& buffer) {
+    bool first = pending_storage_.empty();
+    pending_storage_.put(std::move(buffer));
+    if ( first ) {
+        loop_.startTimer(ingest_timer_, std::chrono::milliseconds(IngestInterval));
+    }
+}
+
+// in the loop thread, all the data has been read
+void Application::_endData() {
+    // indicate the end
+    loop_.stopTimer(ingest_timer_);
+    pending_storage_.put(std::make_shared<DataBuffer>());
+    _ingest();
+}
+
+void Application::_ingest() {
+    if ( !pending_storage_.empty() ) {
+        _processData(std::move(pending_storage_));
+        pending_storage_ = BufferStorage();
     }
 }
 
 void Application::_processData(BufferStorage&& storage) {
-    static char eol = '\0';
     for ( auto& sp_buffer : storage.getBuffers() ) {
         // end
         if ( sp_buffer->len == 0 ) {
-            if ( !incomplete_str_.empty() ) {
-                DataBufferPtr data = std::make_shared<DataBuffer>(incomplete_str_.c_str(),
-                                                                  incomplete_str_.length());
-                buffer_storage_.put(data);
-                incomplete_str_.clear();
-                content_.push_back(makeConstString(data->buffer, data->len));
-            }
+            _pushIncomplete();
 
-            flag_running_ = false;
+            loop_.stopTimer(flag_timer_);
+            _showFlag(false);
             break;
         }
         uint32_t i = 0;
@@ -679,10 +813,11 @@ void Application::_processData(BufferStorage&& storage) {
                     if ( i > 0 ) {
                         memcpy(data->buffer + incomplete_len, sp_buffer->buffer, i);
                     }
-                    buffer_storage_.put(data);
                     incomplete_str_.clear();
-                    content_.push_back(makeConstString(data->buffer, str_len));
-                    eol = sp_buffer->buffer[i];
+                    if ( _pushLine(makeConstString(data->buffer, str_len)) ) {
+                        buffer_storage_.put(data, 1);
+                    }
+                    eol_ = sp_buffer->buffer[i];
                     ++i;    // point to next character
                     break;
                 }
@@ -690,26 +825,33 @@ void Application::_processData(BufferStorage&& storage) {
 
             if ( i == sp_buffer->len ) {
                 // no '\r' or '\n' found
-                if ( eol == '\0' ) {
+                if ( eol_ == '\0' ) {
                     incomplete_str_.append(sp_buffer->buffer, sp_buffer->len);
                 }
                 continue;
             }
         }
 
-        if ( eol == '\r' && i < sp_buffer->len && sp_buffer->buffer[i] == '\n' ) {
+        if ( eol_ == '\r' && i < sp_buffer->len && sp_buffer->buffer[i] == '\n' ) {
             ++i;
         }
 
-        eol = '\0';
+        eol_ = '\0';
 
+        auto line_count = content_.writerSize();
         auto start = sp_buffer->buffer + i;
         for ( ; i < sp_buffer->len; ++i ) {
             if ( sp_buffer->buffer[i] == '\r' || sp_buffer->buffer[i] == '\n' ) {
-                content_.push_back(makeConstString(start, sp_buffer->buffer + i - start));
+                if ( dedup_ ) {
+                    buffer_lines_.push_back(makeConstString(start, sp_buffer->buffer + i - start));
+                }
+                else {
+                    auto line = makeConstString(start, sp_buffer->buffer + i - start);
+                    _pushContent(line, keep_hashes_ ? utils::hash64(line.str, line.len) : 0);
+                }
                 if ( sp_buffer->buffer[i] == '\r' ) {
                     if ( i + 1 == sp_buffer->len ) {
-                        eol = '\r';
+                        eol_ = '\r';
                     }
                     else if ( sp_buffer->buffer[i + 1] == '\n' ) {
                         ++i;
@@ -722,41 +864,248 @@ void Application::_processData(BufferStorage&& storage) {
         if ( start < sp_buffer->buffer + sp_buffer->len ) {
             incomplete_str_ = std::string(start, sp_buffer->buffer + sp_buffer->len - start);
         }
+
+        if ( dedup_ ) {
+            _pushUnique(buffer_lines_);
+            buffer_lines_.clear();
+        }
+
+        // the buffer is not kept if no line points into it
+        line_count = content_.writerSize() - line_count;
+        if ( line_count > 0 ) {
+            buffer_storage_.put(sp_buffer, line_count);
+        }
+    }
+
+    _evict();
+    _publish();
+}
+
+// in the loop thread, pushes the last line read, which has no end of line, if any
+void Application::_pushIncomplete() {
+    if ( !incomplete_str_.empty() ) {
+        DataBufferPtr data = std::make_shared<DataBuffer>(incomplete_str_.c_str(),
+                                                          incomplete_str_.length());
+        incomplete_str_.clear();
+        if ( _pushLine(makeConstString(data->buffer, data->len)) ) {
+            buffer_storage_.put(data, 1);
+        }
+    }
+}
+
+// in the loop thread, returns false if line is skipped by --dedup
+bool Application::_pushLine(const StrType& line) {
+    auto hash = keep_hashes_ ? utils::hash64(line.str, line.len) : 0;
+    if ( dedup_ && !_insertUnique(hash) ) {
+        return false;
+    }
+
+    _pushContent(line, hash);
+    return true;
+}
+
+// in the loop thread, returns false if hash is of a line of content_, which is counted once more
+bool Application::_insertUnique(uint64_t hash) {
+    auto id = line_id_;
+    auto count = line_set_.insert(hash, id);
+    if ( count == 1 ) {
+        return true;
     }
 
-    buffer_storage_.extend(std::move(storage));
+    ++duplicate_count_;
+    if ( dedup_boost_ ) {
+        auto first = line_id_ - static_cast<uint32_t>(line_hashes_.writerSize());
+        __atomic_store_n(&line_hashes_.writerAt(static_cast<uint32_t>(id - first)).count, count, __ATOMIC_RELAXED);
+    }
+    return false;
+}
+
+// in the loop thread, the hash of line is kept if keep_hashes_, line is numbered by it
+void Application::_pushContent(StrType line, uint64_t hash) {
+    if ( keep_hashes_ ) {
+        line.id = line_id_++;
+        line_hashes_.push_back(LineHash{ hash, 1 });
+    }
+    content_.push_back(line);
+}
+
+/**
+ * In the loop thread, pushes the lines of a buffer except the duplicates.
+ * The slots of the lines PrefetchDistance ahead are prefetched while a line is
+ * inserted, so that the cache misses of the lines overlap instead of adding up.
+ */
+void Application::_pushUnique(const std::vector<StrType>& lines) {
+    constexpr size_t PrefetchDistance = 16;
+    auto& hashes = buffer_hashes_;
+    hashes.clear();
+    for ( const auto& line : lines ) {
+        hashes.push_back(utils::hash64(line.str, line.len));
+    }
+
+    for ( size_t i = 0; i < hashes.size() && i < PrefetchDistance; ++i ) {
+        line_set_.prefetch(hashes[i]);
+    }
+    for ( size_t i = 0; i < hashes.size(); ++i ) {
+        if ( i + PrefetchDistance < hashes.size() ) {
+            line_set_.prefetch(hashes[i + PrefetchDistance]);
+        }
+        if ( _insertUnique(hashes[i]) ) {
+            _pushContent(lines[i], hashes[i]);
+        }
+    }
+}
+
+// in the loop thread, the oldest lines beyond --max-lines or --max-bytes are evicted,
+// their buffers are freed after they have been removed from the result
+void Application::_evict() {
+    auto& config = ConfigManager::getInstance();
+    auto max_lines = config.getConfigValue<ConfigType::MaxLines>();
+    auto max_bytes = config.getConfigValue<ConfigType::MaxBytes>();
+    if ( max_lines == 0 && max_bytes == 0 ) {
+        return;
+    }
+
+    uint64_t size = content_.writerSize();
+    uint64_t count = max_lines > 0 && size > max_lines ? size - max_lines : 0;
+    if ( max_bytes > 0 ) {
+        count = std::max(count, buffer_storage_.linesOver(max_bytes));
+    }
+    if ( count == 0 ) {
+        return;
+    }
+
+    // a line evicted is no longer a duplicate
+    if ( dedup_ ) {
+        for ( uint64_t i = 0; i < count && i < size; ++i ) {
+            line_set_.erase(line_hashes_.writerAt(i).hash);
+        }
+    }
+
+    auto evicted = std::make_shared<EvictedLines>();
+    buffer_storage_.evict(count, count < size ? &content_.writerAt(count) : nullptr, *evicted);
+    content_.pop_front(count);
+    if ( keep_hashes_ ) {
+        line_hashes_.pop_front(count);
+    }
+    task_queue_.put([this, evicted] { _dropEvicted(evicted); });
+}
+
+// in the task thread, the lines evicted are removed from the result so that they are not merged again
+void Application::_dropEvicted(const std::shared_ptr<EvictedLines>& evicted) {
+    {
+        std::unique_lock<std::mutex> lock(result_mutex_);
+        while ( access_count_ > 0 ) {
+            result_cond_.wait(lock);
+        }
+        if ( !pattern_.empty() ) {
+            access_count_++;
+        }
+    }
+
+    // the lines kept are moved forward in place
+    auto& weights = std::get<0>(previous_result_);
+    auto weight_iter = weights.begin();
+    auto result_iter = result_content_.begin();
+    auto weight = weights.begin();
+    uint32_t kept = 0;
+    for ( auto iter = result_content_.begin(); iter != result_content_.end(); ++iter, ++weight ) {
+        if ( !evicted->contains(*iter) ) {
+            *weight_iter++ = *weight;
+            *result_iter++ = *iter;
+            ++kept;
+        }
+    }
+    weights.pop_back(weights.size() - kept);
+    result_content_.pop_back(result_content_.size() - kept);
+
+    kept = 0;
+    auto cb_iter = cb_content_.begin();
+    for ( auto iter = cb_content_.begin(); iter != cb_content_.end(); ++iter ) {
+        if ( !evicted->contains(*iter) ) {
+            *cb_iter++ = *iter;
+            ++kept;
+        }
+    }
+    cb_content_.pop_back(cb_content_.size() - kept);
+
+    // the rows drawn from the lines evicted are replaced before the lines are freed
+    auto total_size = content_.size();
+    if ( pattern_.empty() ) {
+        result_content_size_.store(total_size, std::memory_order_relaxed);
+        render_scheduler_.mark(Region::LineInfo, [this, total_size] {
+            tui_.updateLineInfo(total_size, total_size);
+        });
+        render_scheduler_.mark(Region::Result, [this]{ _initBuffer(true); });
+    }
+    else {
+        result_content_size_.store(result_content_.size(), std::memory_order_relaxed);
+        render_scheduler_.mark(Region::LineInfo, [this, result_size=result_content_.size(), total_size] {
+            tui_.updateLineInfo(result_size, total_size);
+        });
+        std::shared_ptr<void> release(nullptr, [this](void*) { _releaseResult(); });
+        render_scheduler_.mark(Region::Result, [this, pattern=pattern_, result_size=result_content_.size(), release]{
+            _updateResult(result_size, pattern);
+        });
+    }
+    render_scheduler_.defer([this, evicted] { fuzzy_engine_.releaseStrings(); });
+}
+
+void Application::_publish() {
+    // the hashes first, so that a snapshot of them covers the lines of an older snapshot
+    line_hashes_.publish();
+    content_.publish();
+
+    // coalesce the notifications if the task thread is busy
+    if ( ingest_pending_.exchange(true) == false ) {
+        task_queue_.put([this] { _afterIngest(); });
+    }
+}
+
+void Application::_afterIngest() {
+    ingest_pending_ = false;
 
     if ( !pattern_.empty() ) {
         _search(true);
     }
     else {
-        result_content_size_.store(content_.size(), std::memory_order_relaxed);
-        cmdline_queue_.put([this, result_size=content_.size(), total_size=content_.size()] {
-            tui_.updateLineInfo(result_size, total_size);
+        auto content_size = content_.size();
+        result_content_size_.store(content_size, std::memory_order_relaxed);
+        render_scheduler_.mark(Region::LineInfo, [this, content_size] {
+            tui_.updateLineInfo(content_size, content_size);
         });
         static bool enough_size = false;
         if ( enough_size == false ) {
-            if ( content_.size() >= tui_.getCoreHeight<MainWindow>() ) {
+            if ( content_size >= tui_.getCoreHeight<MainWindow>() ) {
                 enough_size = true;
             }
-            ui_queue_.put([this]{ _initBuffer(); });
+            render_scheduler_.mark(Region::Result, [this]{ _initBuffer(); });
+        }
+        else {
+            // the lines read since are appended without moving the view
+            render_scheduler_.mark(Region::Result, [this]{ _initBuffer(true); });
         }
     }
 }
 
+// in the loop thread, the terminal is readable
 void Application::_input() {
+    Tty::getInstance().readInput();
+    loop_.startTimer(input_timer_, std::chrono::milliseconds(Tty::InputTimeout));
+    _handleKeys();
+}
+
+void Application::_handleKeys() {
     using namespace std::chrono;
     using Ms = std::chrono::milliseconds;
-    using TimePoint = decltype(steady_clock::now());
-
-    TimePoint cur_time;
-    TimePoint start_time;
-    bool timeout = true;
-    std::string pattern;
-    uint32_t cursor_pos = 0;
-    Operation last_op = Operation::Invalid;
-    while ( true ) {
-        auto tup = Tty::getInstance().getchar();
+
+    auto& cur_time = input_.cur_time;
+    auto& start_time = input_.start_time;
+    auto& timeout = input_.timeout;
+    auto& pattern = input_.pattern;
+    auto& cursor_pos = input_.cursor_pos;
+    auto& last_op = input_.last_op;
+    std::tuple<Key, std::string> tup;
+    while ( running_ && Tty::getInstance().nextKey(tup) ) {
         if ( timeout == true ) {
             timeout = false;
             start_time = steady_clock::now();
@@ -764,34 +1113,64 @@ void Application::_input() {
         auto key = std::get<0>(tup);
         if ( key == Key::Ctrl_I ) { // tab
             normal_mode_ = !normal_mode_;
-            cmdline_queue_.put([this] {
+            render_scheduler_.mark(Region::Prompt, [this] {
                 tui_.redrawPrompt(normal_mode_);
             });
         }
 
         if ( normal_mode_ ) {
-            if ( std::get<1>(tup) == "j" ) {
+            // g: the first line, G: the last line, NG: line N, N%: N percent of the lines
+            auto& str = std::get<1>(tup);
+            auto count = input_.count;
+            input_.count = 0;
+            if ( str == "j" ) {
                 key = Key::Ctrl_J;
             }
-            else if ( std::get<1>(tup) == "k" ) {
+            else if ( str == "k" ) {
                 key = Key::Ctrl_K;
             }
-            else if ( key == Key::Char ) {
+            else if ( key == Key::Char && str[0] >= '0' && str[0] <= '9' ) {
+                input_.count = std::min(count * 10 + (str[0] - '0'), 100000000u);
+                continue;
+            }
+            else if ( (str == "G" || str == "%") && count > 0 ) {
+                bool percent = str == "%";
+                task_queue_.put([this, count, percent] {
+                    render_scheduler_.post([this, count, percent] {
+                        if ( percent ) {
+                            tui_.jumpToPercent<MainWindow>(count);
+                        }
+                        else {
+                            tui_.jumpTo<MainWindow>(count - 1);
+                        }
+                    });
+                });
+                continue;
+            }
+            else if ( str == "g" || str == "G" ) {
+                task_queue_.put(task_map_[str == "g" ? Operation::JumpToFirstLine
+                                                     : Operation::JumpToLastLine]);
+                continue;
+            }
+            else if ( key == Key::Char || key == Key::Paste ) {
                 key = Key::Unknown;
             }
         }
 
-        if ( key == Key::Char ) {
+        if ( key == Key::Char || key == Key::Paste ) {
             last_op = Operation::Input;
             pattern.insert(cursor_pos, std::get<1>(tup));
-            ++cursor_pos;
-            cmdline_queue_.put([this, pattern, cursor_pos] {
+            cursor_pos += std::get<1>(tup).length();
+            render_scheduler_.mark(Region::Cmdline, [this, pattern, cursor_pos] {
                 tui_.updateCmdline(pattern, cursor_pos);
             });
 
+            // the characters typed ahead are searched at once, a paste is searched immediately
             cur_time = steady_clock::now();
-            if ( result_content_size_.load(std::memory_order_relaxed) < 20000
-                 || duration_cast<Ms>(cur_time - start_time).count() > 500 ) {
+            if ( key == Key::Paste
+                 || (!Tty::getInstance().hasPendingInput()
+                     && (result_content_size_.load(std::memory_order_relaxed) < 20000
+                         || duration_cast<Ms>(cur_time - start_time).count() > 500)) ) {
                 start_time = cur_time;
 
                 search_count_++;
@@ -823,10 +1202,6 @@ void Application::_input() {
                 break;
             }
         }
-        else if ( key == Key::Exit ) {
-            _notifyExit();
-            break;
-        }
         else {
             if ( key == Key::Single_Click || key == Key::Right_Click
                  || key == Key::Middle_Click || key == Key::Wheel_Down
@@ -844,12 +1219,12 @@ void Application::_input() {
                 last_op = op;
                 if ( op == Operation::Exit ) {
                     _notifyExit();
-                    break;
+                    return;
                 }
                 else if ( op == Operation::Accept ) {
                     _notifyExit();
                     tui_.setAccept();
-                    break;
+                    return;
                 }
 
                 auto it = cmdline_task_map_.find(op);
@@ -878,18 +1253,11 @@ void Application::_input() {
 }
 
 void Application::_notifyExit() {
-#ifdef __APPLE__
-    kill(getpid(), SIG_UserDefined);
-#else
-    union sigval sigv;
-    sigqueue(getpid(), SIG_UserDefined, sigv);
-#endif
-
     running_ = false;
 
-    ui_queue_.put(Task());
+    render_scheduler_.stop();
     task_queue_.put(Task());
-    cmdline_queue_.put(Task());
+    loop_.stop();
 }
 
 void Application::_shorten(const std::string& pattern, uint32_t cursor_pos) {
@@ -906,15 +1274,16 @@ void Application::_shorten(const std::string& pattern, uint32_t cursor_pos) {
 
     if ( pattern.empty() ) {
         task_queue_.put([this] {
-            result_content_size_.store(content_.size(), std::memory_order_relaxed);
-            cmdline_queue_.put([this, content_size=content_.size()] {
+            auto content_size = content_.size();
+            result_content_size_.store(content_size, std::memory_order_relaxed);
+            render_scheduler_.mark(Region::LineInfo, [this, content_size] {
                 tui_.updateLineInfo(content_size, content_size);
             });
         });
         task_queue_.put([this] {
             index_ = 0;
             pattern_.clear();
-            ui_queue_.put([this]{ _initBuffer(); });
+            render_scheduler_.mark(Region::Result, [this]{ _initBuffer(); });
         });
     }
     else {
@@ -940,7 +1309,19 @@ void Application::_search(bool is_continue) {
     using namespace std::chrono;
     StrContainer::const_iterator source_begin;
     uint32_t content_size{ 0 };
-    auto total_size{ content_.size() };
+    SpanList<StrType> content_spans;
+    uint32_t spans_first{ 0 };     // the index of content_spans in content_
+    // lines published during the search are picked up by the next _afterIngest()
+    auto corpus = content_.snapshot();
+    auto total_size{ corpus.size() };
+    // the hashes of the lines of corpus and of the results, for the bonus
+    hash_snapshot_ = line_hashes_.snapshot();
+    // the lines evicted since index_ was counted, see --max-lines
+    if ( corpus.first() != origin_ ) {
+        uint32_t evicted = std::min(corpus.first() - origin_, static_cast<size_t>(index_));
+        index_ -= evicted;
+        origin_ = corpus.first();
+    }
     StrContainer cur_content;
     std::function<void()> guard;
 
@@ -948,8 +1329,7 @@ void Application::_search(bool is_continue) {
         cb_content_.clear();
         result_content_.clear();
         index_ = std::min(step_, static_cast<decltype(step_)>(total_size));
-        source_begin = content_.cbegin();
-        content_size = index_;
+        content_spans = corpus.spans(0, index_);
     }
     else {
         uint32_t result_size = is_continue ? 0 : result_content_.size();
@@ -989,24 +1369,32 @@ void Application::_search(bool is_continue) {
                     uint32_t offset = step_ - result_size - cb_size;
                     auto size = std::min(offset, static_cast<decltype(step_)>(total_size - index_));
                     if ( offset == step_ ) {
-                        source_begin = content_.cbegin() + index_;
-                        content_size = size;
+                        spans_first = index_;
+                        content_spans = corpus.spans(index_, index_ + size);
                     }
                     else {
-                        cur_content.push_back(content_.cbegin() + index_, content_.cbegin() + (index_ + size));
+                        for ( const auto& span : corpus.spans(index_, index_ + size) ) {
+                            cur_content.append(span.data, span.size);
+                        }
                     }
                     index_ += size;
                 }
             }
         }
 
-        if ( source_begin == nullptr ) {
+        if ( source_begin == nullptr && content_spans.empty() ) {
             source_begin = cur_content.cbegin();
             content_size = cur_content.size();
         }
     }
 
-    auto result = fuzzy_engine_.fuzzyMatch(source_begin, content_size, pattern_, preference_);
+    // content_ is searched block by block
+    auto result = content_spans.empty()
+        ? fuzzy_engine_.fuzzyMatch(source_begin, content_size, pattern_, preference_,
+                                   DigestFn(), true, sort_method_)
+        : fuzzy_engine_.fuzzyMatch(content_spans, pattern_, preference_,
+                                   DigestFn(), true, sort_method_,
+                                   line_index_ ? line_index_->signatures() + spans_first : nullptr);
     if ( is_continue && result_content_.size() > 0 ) {
         result = fuzzy_engine_.merge(previous_result_, result);
     }
@@ -1025,13 +1413,15 @@ void Application::_search(bool is_continue) {
 
     previous_result_ = std::move(result);
     result_content_size_.store(result_content_.size(), std::memory_order_relaxed);
-    cmdline_queue_.put([this, result_size=result_content_.size(), total_size] {
+    render_scheduler_.mark(Region::LineInfo, [this, result_size=result_content_.size(), total_size] {
         tui_.updateLineInfo(result_size, total_size);
     });
 
     // update result only when not continue or last continue
     if ( !is_continue || (index_ >= total_size && cb_content_.size() == 0) ) {
-        ui_queue_.put([this, pattern=pattern_, result_size=result_content_.size()]{
+        // access_count_ is released after the task has run or has been replaced by a newer one
+        std::shared_ptr<void> release(nullptr, [this](void*) { _releaseResult(); });
+        render_scheduler_.mark(Region::Result, [this, pattern=pattern_, result_size=result_content_.size(), release]{
             _updateResult(result_size, pattern);
         });
     }
@@ -1058,49 +1448,49 @@ void Application::_doWork(BlockingQueue<Task>& q) {
     }
 }
 
-std::vector<HighlightString> Application::_generateHighlightStr(uint32_t first, uint32_t last,
-                                                                const std::string& pattern) {
-    std::vector<HighlightString> res;
+std::vector<AttributedLine> Application::_generateHighlightStr(uint32_t first, uint32_t last,
+                                                               const std::string& pattern) {
+    std::vector<AttributedLine> res;
 
     if ( first == last ) {
         return res;
     }
-    res.reserve(last - first);
-
-    auto highlights = fuzzy_engine_.getHighlights(result_content_.cbegin() + first,
-                                                  last - first, pattern);
-    const char* reset_color = "\033[0m";
-    auto& match_color = tui_.getColor(HighlightGroup::Match0);
-    auto& normal_color = tui_.getColor(HighlightGroup::Normal);
 
     auto max_width = tui_.getCoreWidth<MainWindow>() - indent_;
     if ( static_cast<int32_t>(max_width) <= 0 ) {
         return res;
     }
-    auto iter = result_content_.cbegin() + first;
-    auto end = result_content_.cbegin() + last;
+    res.reserve(last - first);
+
+    auto copyRows = [this](uint32_t first, uint32_t last) {
+        std::vector<StrType> rows;
+        rows.reserve(last - first);
+        for ( const auto& span : StrContainer::spans(result_content_.cbegin() + first,
+                                                     result_content_.cbegin() + last) ) {
+            rows.insert(rows.end(), span.data, span.data + span.size);
+        }
+        return rows;
+    };
+
+    auto strs = copyRows(first, last);
+    auto highlights = fuzzy_engine_.getHighlights(strs.data(), strs.size(), pattern);
+
+    // so that the next page is ready when it is scrolled to
+    uint32_t page_size = std::max(last - first, tui_.getCoreHeight<MainWindow>());
+    uint32_t next = std::min(last + page_size, static_cast<uint32_t>(result_content_.size()));
+    if ( last < next ) {
+        fuzzy_engine_.prefetchHighlights(copyRows(last, next), pattern);
+    }
+
+    auto iter = strs.cbegin();
+    auto end = strs.cend();
     for (uint32_t i = 0; iter != end; ++iter, ++i ) {
-        std::string s;
-        s.reserve(iter->len << 1);
         auto& p_context = highlights[i];
-
         if ( iter->len <= max_width  ) {
-            auto p = iter->str;
-            for ( uint32_t j = 0; j < p_context->end_index; ++j ) {
-                s.append(normal_color);
-                s.append(p, iter->str + p_context->positions[j].col - p);
-                p = iter->str + p_context->positions[j].col;
-                s.append(match_color);
-                s.append(p, p_context->positions[j].len);
-                p += p_context->positions[j].len;
-            }
-
-            if ( auto len = iter->str + iter->len - p ) {
-                s.append(normal_color);
-                s.append(p, len);
-            }
+            res.emplace_back(*iter, 0, iter->len);
         }
         else {
+            // keep the last highlighted character and up to 10 characters after it visible
             uint32_t right = p_context->end + std::min(iter->len - p_context->end, 10u);
             uint32_t left = 0;
             if ( right > max_width ) {
@@ -1110,135 +1500,90 @@ std::vector<HighlightString> Application::_generateHighlightStr(uint32_t first,
                 right = max_width;
             }
 
-            auto p = iter->str + left;
-            bool is_beginning = true;
-            for ( uint32_t j = 0; j < p_context->end_index; ++j ) {
-                auto col = p_context->positions[j].col;
-                if ( col < left ) {
-                    continue;
-                }
-                else if ( left == 0 || is_beginning == false ) {
-                    is_beginning = false;
-                    s.append(normal_color);
-                    s.append(p, iter->str + p_context->positions[j].col - p);
-                }
-                else {
-                    if ( col >= left + 2 ) {
-                        is_beginning = false;
-
-                        s.append(normal_color);
-                        s.append("..");
-                        s.append(p + 2, iter->str + p_context->positions[j].col - p - 2);
-                    }
-                    else {
-                        continue;
-                    }
-                }
-
-                p = iter->str + p_context->positions[j].col;
-                s.append(match_color);
-                s.append(p, p_context->positions[j].len);
-                p += p_context->positions[j].len;
-            }
-
-            if ( auto len = right - p_context->end ) {
-                s.append(normal_color);
-                if ( right < iter->len ) {
-                    s.append(p, len - 2);
-                    s.append("..");
-                }
-                else {
-                    s.append(p, len);
-                }
-            }
+            res.emplace_back(*iter, left, right);
+            res.back().left_ellipsis = left > 0;
+            res.back().right_ellipsis = right < iter->len;
         }
 
-        s.append(reset_color);
-
-        res.emplace_back(std::move(s), *iter);
+        auto& line = res.back();
+        for ( uint32_t j = 0; j < p_context->end_index; ++j ) {
+            line.addSpan(p_context->positions[j].col, p_context->positions[j].len, HighlightGroup::Match0);
+        }
     }
 
     return res;
 }
 
-void Application::_initBuffer() {
-    tui_.setBuffer<MainWindow>([this, indicator=0u]() mutable {
-        auto height = tui_.getCoreHeight<MainWindow>();
-
-        auto first = indicator;
-        auto last = std::min(indicator + height,
-                             static_cast<decltype(indicator)>(content_.size()));
-        indicator = last;
-
-        std::vector<HighlightString> res;
+void Application::_initBuffer(bool append) {
+    auto corpus = content_.snapshot();
+    auto size = corpus.size();
+    // the rows of the lines evicted since the rows were shown
+    uint32_t removed = corpus.first() - shown_first_;
+    shown_first_ = corpus.first();
+    RowSource source = [this, corpus](uint32_t first, uint32_t last) {
+        std::vector<AttributedLine> res;
         res.reserve(last - first);
 
-        const char* reset_color = "\033[0m";
-        auto& normal_color = tui_.getColor(HighlightGroup::Normal);
-
         auto max_width = tui_.getCoreWidth<MainWindow>() - indent_;
-        auto iter = content_.cbegin() + first;
-        auto end = content_.cbegin() + last;
-        if ( normal_color == reset_color ) {
-            for ( ; iter != end; ++iter ) {
-                if ( iter->len <= max_width  ) {
-                    res.emplace_back(std::string(iter->str, iter->len), *iter);
-                }
-                else {
-                    res.emplace_back(std::string(iter->str, max_width - 2) + "..", *iter);
-                }
+        auto iter = corpus.cbegin() + first;
+        auto end = corpus.cbegin() + last;
+        for ( ; iter != end; ++iter ) {
+            if ( iter->len <= max_width  ) {
+                res.emplace_back(*iter, 0, iter->len);
             }
-        }
-        else {
-            for ( ; iter != end; ++iter ) {
-                if ( iter->len <= max_width  ) {
-                    res.emplace_back(normal_color + std::string(iter->str, iter->len) + reset_color,
-                                     *iter);
-                }
-                else {
-                    res.emplace_back(normal_color + std::string(iter->str, max_width - 2) + ".."
-                                     + reset_color, *iter);
-                }
+            else {
+                res.emplace_back(*iter, 0, max_width);
+                res.back().right_ellipsis = true;
             }
         }
 
         return res;
-    });
-}
+    };
 
-void Application::_showFlag() {
-    while ( flag_running_ && running_ ) {
-        tui_.showFlag(true);
-        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    if ( append ) {
+        tui_.appendBuffer<MainWindow>(size, std::move(source), removed);
+    }
+    else {
+        tui_.setBuffer<MainWindow>(size, std::move(source));
     }
-    tui_.showFlag(false);
 }
 
-// in ui_queue_ thread
-void Application::_updateResult(uint32_t result_size, const std::string& pattern) {
-    // [0, indicator) has been translated into highlight string
-    tui_.setBuffer<MainWindow>([this, result_size, pattern, indicator=0u]() mutable {
-        auto height = tui_.getCoreHeight<MainWindow>();
-
-        auto first = indicator;
-        auto last = std::min(indicator + height, result_size);
-        indicator = last;
+// in the loop thread, the spinner turns while the data is being read
+void Application::_showFlag(bool show) {
+    render_scheduler_.post([this, show] {
+        tui_.showFlag(show);
+    });
+}
 
+// in the loop thread
+void Application::_updateResult(uint32_t result_size, const std::string& pattern) {
+    // only the rows displayed are highlighted
+    tui_.setBuffer<MainWindow>(result_size, [this, pattern](uint32_t first, uint32_t last) {
         return _generateHighlightStr(first, last, pattern);
     });
+}
 
-    {
-        std::lock_guard<std::mutex> lock(result_mutex_);
-        if ( access_count_ > 0 ) {
-            access_count_--;
-        }
-        result_cond_.notify_one();
+void Application::_releaseResult() {
+    std::lock_guard<std::mutex> lock(result_mutex_);
+    if ( access_count_ > 0 ) {
+        access_count_--;
     }
+    result_cond_.notify_one();
 }
 
 void Application::_resume() {
     tui_.init(true);
-    cmdline_queue_.put([this] {
+    _redraw();
+}
+
+// the result is neither searched for again nor regenerated, only the rows displayed are
+void Application::_resize() {
+    tui_.resize();
+    _redraw();
+}
+
+void Application::_redraw() {
+    render_scheduler_.post([this] {
         tui_.drawBorder();
         tui_.redrawPrompt(normal_mode_);
         tui_.updateCmdline(pattern_);
@@ -1,6 +1,8 @@
 _Pragma("once");
 
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <memory>
 #include <atomic>
 #include <string>
@@ -8,19 +10,42 @@ _Pragma("once");
 #include <unordered_map>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 #include <signal.h>
 
 #include "tui.h"
 #include "queue.h"
+#include "renderScheduler.h"
+#include "eventLoop.h"
+#include "fileWalker.h"
+#include "lineIndex.h"
+#include "server.h"
+#include "client.h"
 #include "error.h"
 #include "constString.h"
 #include "fuzzyEngine.h"
+#include "segmentedArray.h"
+#include "lineSet.h"
+#include "history.h"
+#include "statistics.h"
 #include "configManager.h"
 
 namespace leaf
 {
 
 constexpr uint32_t BufferLen = 16 * 1024;
+constexpr uint32_t IngestInterval = 50;  // ms
+constexpr uint32_t SpanCount = 4096;      // the top results whose match spans are kept
+constexpr uint32_t IndexStep = 1 << 20;   // the lines of --index added to the corpus per loop iteration
+constexpr weight_t DedupBonus = 5000;     // the weight of a line gained each time its count doubles
+constexpr weight_t HistoryBonus = 10000;  // the weight of a line gained each time its frecency doubles
+
+// the hash of a line of content_, kept for the bonus of the line and for --dedup
+struct LineHash
+{
+    uint64_t hash;
+    uint32_t count;     // the times the line has been read if --dedup-boost, accessed atomically
+};
 
 enum class Operation
 {
@@ -40,6 +65,8 @@ enum class Operation
     CursorMoveToEnd,
     CursorLineMoveUp,
     CursorLineMoveDown,
+    JumpToFirstLine,
+    JumpToLastLine,
     Single_Click,
     Double_Click,
     Right_Click,
@@ -90,10 +117,6 @@ public:
         buffers_.emplace_back(std::move(sp_buffer));
     }
 
-    void extend(BufferStorage&& storage) {
-        buffers_.insert(buffers_.end(), storage.buffers_.begin(), storage.buffers_.end());
-    }
-
     bool empty() const noexcept {
         return buffers_.empty();
     }
@@ -106,6 +129,78 @@ private:
     std::vector<DataBufferPtr> buffers_;
 };
 
+// the lines evicted from content_ by --max-lines or --max-bytes
+struct EvictedLines
+{
+    using Range = std::pair<const char*, const char*>;
+
+    std::vector<Range>         ranges;     // the addresses of the lines, sorted
+    std::vector<DataBufferPtr> buffers;    // the buffers holding only these lines
+
+    bool contains(const StrType& str) const noexcept {
+        auto iter = std::upper_bound(ranges.begin(), ranges.end(), str.str,
+                                     [](const char* p, const Range& range) { return p < range.first; });
+        return iter != ranges.begin() && str.str < (iter - 1)->second;
+    }
+};
+
+/**
+ * The buffers the lines of content_ point into, in the order of the lines,
+ * so that the buffers of the lines evicted can be freed.
+ */
+class LineStorage
+{
+public:
+    // sp_buffer holds the next line_count lines
+    void put(DataBufferPtr sp_buffer, uint64_t line_count) {
+        bytes_ += sp_buffer->len;
+        buffers_.push_back({ std::move(sp_buffer), line_count });
+    }
+
+    // the number of the first lines to be evicted so that at most max_bytes are kept
+    uint64_t linesOver(uint64_t max_bytes) const noexcept {
+        uint64_t count = 0;
+        uint64_t bytes = bytes_;
+        for ( auto iter = buffers_.begin(); iter != buffers_.end() && bytes > max_bytes; ++iter ) {
+            bytes -= iter->buffer->len;
+            count += iter->line_count;
+        }
+        return count;
+    }
+
+    /**
+     * Takes out the buffers of the first count lines, first_kept is the line after them,
+     * which may be in the same buffer as the last of them.
+     */
+    void evict(uint64_t count, const StrType* first_kept, EvictedLines& evicted) {
+        while ( !buffers_.empty() && count >= buffers_.front().line_count ) {
+            auto& front = buffers_.front();
+            evicted.ranges.emplace_back(front.buffer->buffer, front.buffer->buffer + front.buffer->len);
+            count -= front.line_count;
+            bytes_ -= front.buffer->len;
+            evicted.buffers.push_back(std::move(front.buffer));
+            buffers_.pop_front();
+        }
+
+        if ( count > 0 ) {
+            auto& front = buffers_.front();
+            evicted.ranges.emplace_back(front.buffer->buffer, first_kept->str);
+            front.line_count -= count;
+        }
+        std::sort(evicted.ranges.begin(), evicted.ranges.end());
+    }
+
+private:
+    struct Entry
+    {
+        DataBufferPtr buffer;
+        uint64_t      line_count;
+    };
+
+    std::deque<Entry> buffers_;
+    uint64_t          bytes_{ 0 };
+};
+
 class SignalManager
 {
 public:
@@ -147,7 +242,32 @@ class Configuration : private SignalManager
 public:
     Configuration(int argc, char* argv[]) {
         Error::getInstance(); // make sure Error object instance is created before Cleanup object instance
-        ConfigManager::getInstance().loadConfig(argc, argv);
+        auto& config = ConfigManager::getInstance();
+        config.loadConfig(argc, argv);
+
+        // the modes without the terminal
+        const auto& file = config.getConfigValue<ConfigType::BuildIndex>();
+        if ( !file.empty() ) {
+            if ( !LineIndex::build(file, file + ".idx") ) {
+                Error::getInstance().appendError(utils::strFormat("%s: %s", file.c_str(), strerror(errno)));
+                std::exit(EXIT_FAILURE);
+            }
+            std::exit(0);
+        }
+
+        const auto& query_socket = config.getConfigValue<ConfigType::Query>();
+        if ( !query_socket.empty() ) {
+            std::exit(Client(query_socket, config.getConfigValue<ConfigType::Top>()).run());
+        }
+
+        const auto& serve_socket = config.getConfigValue<ConfigType::Serve>();
+        if ( !serve_socket.empty() ) {
+            {
+                Server server(serve_socket, std::max(std::thread::hardware_concurrency(), 1u));
+                server.start();
+            }
+            std::exit(0);
+        }
     }
 };
 
@@ -160,58 +280,115 @@ public:
 private:
     using Task = std::function<void()>;
 
-    void _handleSignal();
+    void _handleSignal(int sig);
     void _readConfig();
+    void _openData();
     void _readData();
+    bool _watchData();
+    void _readEvents();
+    void _readIndex(uint64_t first);
+    void _putData(DataBufferPtr&& buffer);
+    void _endData();
+    void _ingest();
     void _processData(BufferStorage&& storage);
+    void _pushIncomplete();
+    bool _pushLine(const StrType& line);
+    bool _insertUnique(uint64_t hash);
+    void _pushContent(StrType line, uint64_t hash);
+    void _pushUnique(const std::vector<StrType>& lines);
+    void _evict();
+    void _dropEvicted(const std::shared_ptr<EvictedLines>& evicted);
+    void _publish();
+    void _afterIngest();
     void _input();
+    void _handleKeys();
     void _shorten(const std::string& pattern, uint32_t cursor_pos);
     void _search(bool is_continue);
     void _doWork(BlockingQueue<Task>& q);
     void _updateResult(uint32_t result_size, const std::string& pattern);
-    void _initBuffer();
+    void _releaseResult();
+    void _initBuffer(bool append=false);
     void _notifyExit();
-    void _showFlag();
+    void _showFlag(bool show);
     void _resume();
+    void _resize();
+    void _redraw();
+    void _reportStatistics();
 
-    static int _exec(const char* cmd);
-
-    std::vector<HighlightString> _generateHighlightStr(uint32_t first, uint32_t last,
-                                                       const std::string& pattern);
+    std::vector<AttributedLine> _generateHighlightStr(uint32_t first, uint32_t last,
+                                                      const std::string& pattern);
 private:
     Result        previous_result_;
     StrContainer& result_content_;
-    StrContainer  content_;
+    SegmentedArray<StrType> content_;
     StrContainer  cb_content_;
-    BufferStorage buffer_storage_;
-    std::string   incomplete_str_;
-
+    LineStorage   buffer_storage_;
+    bool          dedup_{ ConfigManager::getInstance().getConfigValue<ConfigType::Dedup>() };
+    LineSet       line_set_;        // the lines of content_ if --dedup
+    uint64_t      duplicate_count_{ 0 };    // the lines skipped by --dedup
+    std::vector<StrType>  buffer_lines_;    // the lines of a buffer to be deduplicated
+    std::vector<uint64_t> buffer_hashes_;   // of buffer_lines_
+    bool          keep_hashes_{ false };    // if --dedup or the lines are ranked by a bonus
+    bool          dedup_boost_{ false };
+    SegmentedArray<LineHash> line_hashes_;  // of content_, the id of a line is the index of its hash
+    uint32_t      line_id_{ 0 };            // the id of the next line, counted modulo 2^32
+    SegmentedArray<LineHash>::Snapshot hash_snapshot_;  // read by the bonus during a search
+    History       history_;         // the lines accepted, unless --no-history
+    std::string   incomplete_str_;  // the last line read if it has no end of line yet
+    char          eol_{ '\0' };     // '\r' if a buffer ends with it, a '\n' starting the next is skipped
+
+    // searches and the operations on the result run in the task thread,
+    // everything else runs in the loop thread
     BlockingQueue<Task> task_queue_;
-    BlockingQueue<Task> ui_queue_; // should be called in task_queue_ thread
-    BlockingQueue<Task> cmdline_queue_;
+    EventLoop           loop_;
+    EventLoop::TimerId  input_timer_;   // no input for Tty::InputTimeout ms
+    EventLoop::TimerId  ingest_timer_;  // the data read is ingested at most every IngestInterval ms
+    EventLoop::TimerId  flag_timer_;    // the spinner
+    int                 read_fd_{ -1 };
+    int                 inotify_fd_{ -1 };  // watches read_fd_ for the lines appended if --follow
+    BufferStorage       pending_storage_;   // read but not ingested yet
+    std::unique_ptr<FileWalker> file_walker_;   // lists the files if stdin is a terminal
+    std::unique_ptr<LineIndex>  line_index_;    // the lines of --index, content_ is built from it
 
     uint32_t      access_count_{ 0 };
     std::mutex    result_mutex_;
     std::condition_variable result_cond_;
 
     std::atomic<bool>     running_{ true };
-    std::atomic<bool>     flag_running_{ true };
+    std::atomic<bool>     ingest_pending_{ false };
     std::atomic<uint32_t> search_count_{ 0 };
     std::atomic<uint32_t> result_content_size_{ 0 };
 
     Tui tui_;
+    RenderScheduler render_scheduler_{ loop_, ConfigManager::getInstance().getConfigValue<ConfigType::Fps>() };
     std::string pattern_;
     bool     already_zero_{ true };
     uint32_t index_{ 0 };
+    size_t   origin_{ 0 };      // the lines of content_ evicted when index_ was counted
+    size_t   shown_first_{ 0 }; // the lines of content_ evicted when the rows shown were counted
     uint32_t cpu_count_;
     const uint32_t step_;
     Point    current_yx_;
     uint32_t indent_{ ConfigManager::getInstance().getConfigValue<ConfigType::Indentation>() };
     bool     normal_mode_{ false };
+
+    // the command line, only accessed in the loop thread
+    struct InputState
+    {
+        std::string pattern;
+        uint32_t    cursor_pos{ 0 };
+        Operation   last_op{ Operation::Invalid };
+        bool        timeout{ true };
+        uint32_t    count{ 0 };     // the number typed in normal mode, e.g., 50 of 50%
+        std::chrono::steady_clock::time_point start_time;
+        std::chrono::steady_clock::time_point cur_time;
+    };
+    InputState input_;
     bool     sigstop_{ false };
 
     FuzzyEngine fuzzy_engine_;
     Preference  preference_{ ConfigManager::getInstance().getConfigValue<ConfigType::SortPreference>() };
+    SortMethod  sort_method_{ ConfigManager::getInstance().getConfigValue<ConfigType::SortMethod>() };
     std::unordered_map<std::string, Key>       key_map_;
     std::unordered_map<std::string, Operation> op_map_;
     std::unordered_map<Key, Operation>         key_op_map_;
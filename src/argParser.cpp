@@ -1,6 +1,7 @@
 #include <cstring>
 #include <vector>
 #include <map>
+#include <stdexcept>
 #include <stdio.h>
 #include "argParser.h"
 #include "tty.h"
@@ -15,6 +16,7 @@ ArgumentParser::ArgumentParser()
     }, category_name_ {
         { ArgCategory::Layout, "Layout" },
         { ArgCategory::Search, "Search" },
+        { ArgCategory::Server, "Server" },
     }, args_{
         { "--reverse",
             {
@@ -26,6 +28,16 @@ ArgumentParser::ArgumentParser()
                 "Display from the bottom of the screen to top.",
             }
         },
+        { "--fps",
+            {
+                ArgCategory::Layout,
+                "",
+                ConfigType::Fps,
+                "1",
+                "N",
+                "Redraw the screen at most N times per second, 0 means no limit. (default: 60)"
+            }
+        },
         { "--height",
             {
                 ArgCategory::Layout,
@@ -73,6 +85,17 @@ ArgumentParser::ArgumentParser()
                 "[10,20%]: top and bottom margin are 10, left and right margin are 20% of the terminal width."
         }
         },
+        { "--sync-update",
+            {
+                ArgCategory::Layout,
+                "",
+                ConfigType::SyncUpdate,
+                "0",
+                "",
+                "Wrap each frame in synchronized update escape sequences, "
+                "so that the terminal renders the frame at once."
+            }
+        },
         { "--sort-preference",
             {
                 ArgCategory::Search,
@@ -83,6 +106,183 @@ ArgumentParser::ArgumentParser()
                 "Specify the sort preference to apply, value can be [begin|end]. (default: end)"
             }
         },
+        { "--sort-method",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::SortMethod,
+                "1",
+                "METHOD",
+                "Specify the algorithm used to sort the matched lines, value can be [merge|radix]. "
+                "radix keeps lines with equal scores in input order. (default: merge)"
+            }
+        },
+        { "--build-index",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::BuildIndex,
+                "1",
+                "FILE",
+                "Write the index of the lines of FILE to FILE.idx and exit, see --index."
+            }
+        },
+        { "--index",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::Index,
+                "1",
+                "FILE",
+                "Read the lines of the file indexed by FILE, which is written by --build-index, "
+                "instead of stdin. The file and the index are mapped into memory, and the lines "
+                "without the characters of the pattern are skipped without being matched."
+            }
+        },
+        { "--follow",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::Follow,
+                "0",
+                "",
+                "Keep reading stdin after its end if it is a regular file, as tail -f does. "
+                "Only the lines appended are searched, and the lines matched are merged into the result."
+            }
+        },
+        { "--max-lines",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::MaxLines,
+                "1",
+                "N",
+                "Keep only the last N lines read, the oldest lines are evicted from the lines searched "
+                "and from the result as new lines are read, so that a stream that never ends, e.g., "
+                "with --follow, is searched in bounded memory. Not applied to --index. 0 means no limit. "
+                "(default: 0)"
+            }
+        },
+        { "--max-bytes",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::MaxBytes,
+                "1",
+                "N[K|M|G]",
+                "Keep at most N bytes of the lines read, the oldest lines are evicted as --max-lines does. "
+                "Not applied to --index. 0 means no limit. (default: 0)"
+            }
+        },
+        { "--dedup",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::Dedup,
+                "0",
+                "",
+                "Skip the lines read that are the same as a line read before, so that each line is "
+                "kept and searched once. A line evicted by --max-lines or --max-bytes is kept again "
+                "the next time it is read. Not applied to --index."
+            }
+        },
+        { "--dedup-boost",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::DedupBoost,
+                "0",
+                "",
+                "Implies --dedup, and ranks a line matched higher the more times it has been read."
+            }
+        },
+        { "--hugepage",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::HugePage,
+                "0",
+                "",
+                "Back the scratch buffers of the search with transparent huge pages and pre-fault them."
+            }
+        },
+        { "--no-cache",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::NoCache,
+                "0",
+                "",
+                "Do not keep the list of the files under the current directory in ~/.cache/yoyo-leaf, "
+                "by which the next listing only reads the directories changed since."
+            }
+        },
+        { "--no-history",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::NoHistory,
+                "0",
+                "",
+                "Do not remember the line accepted in ~/.cache/yoyo-leaf, nor rank the lines accepted "
+                "before higher. The lines accepted in the current directory are ranked higher the more "
+                "often and the more recently they have been accepted."
+            }
+        },
+        { "--no-ignore",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::NoIgnore,
+                "0",
+                "",
+                "Do not skip the files matched by .gitignore and .ignore "
+                "when listing the files under the current directory."
+            }
+        },
+        { "--stats",
+            {
+                ArgCategory::Search,
+                "",
+                ConfigType::Stats,
+                "0",
+                "",
+                "Print the statistics of the searches to stderr on exit, e.g., page faults per search."
+            }
+        },
+        { "--serve",
+            {
+                ArgCategory::Server,
+                "",
+                ConfigType::Serve,
+                "1",
+                "SOCKET",
+                "Read the lines as usual, keep them in memory and answer the queries sent to the "
+                "Unix domain socket SOCKET instead of displaying them, see --query."
+            }
+        },
+        { "--query",
+            {
+                ArgCategory::Server,
+                "",
+                ConfigType::Query,
+                "1",
+                "SOCKET",
+                "Send each line read from stdin as a pattern to the server listening on SOCKET, "
+                "and print the top lines of each result as \"weight<TAB>col:len,...<TAB>line\", "
+                "followed by an empty line."
+            }
+        },
+        { "--top",
+            {
+                ArgCategory::Server,
+                "",
+                ConfigType::Top,
+                "1",
+                "N",
+                "The number of the lines printed for each pattern by --query. (default: 20)"
+            }
+        },
     }
 {
 
@@ -293,6 +493,15 @@ void ArgumentParser::parseArgs(int argc, char* argv[], std::vector<std::unique_p
             SetConfigValue(cfg, Height, value);
             break;
         }
+        case ConfigType::Fps:
+            try {
+                SetConfigValue(cfg, Fps, std::stoul(val_list[0]));
+            }
+            catch(...) {
+                appendError("invalid value: %s", val_list[0].c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            break;
         case ConfigType::SortPreference:
             if ( val_list[0] == "begin" ) {
                 SetConfigValue(cfg, SortPreference, Preference::Begin);
@@ -305,6 +514,103 @@ void ArgumentParser::parseArgs(int argc, char* argv[], std::vector<std::unique_p
                 std::exit(EXIT_FAILURE);
             }
             break;
+        case ConfigType::SortMethod:
+            if ( val_list[0] == "merge" ) {
+                SetConfigValue(cfg, SortMethod, SortMethod::Merge);
+            }
+            else if ( val_list[0] == "radix" ) {
+                SetConfigValue(cfg, SortMethod, SortMethod::Radix);
+            }
+            else {
+                appendError("invalid value: %s for %s", val_list[0].c_str(), key.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            break;
+        case ConfigType::Dedup:
+            SetConfigValue(cfg, Dedup, true);
+            break;
+        case ConfigType::DedupBoost:
+            SetConfigValue(cfg, Dedup, true);
+            SetConfigValue(cfg, DedupBoost, true);
+            break;
+        case ConfigType::HugePage:
+            SetConfigValue(cfg, HugePage, true);
+            break;
+        case ConfigType::Stats:
+            SetConfigValue(cfg, Stats, true);
+            break;
+        case ConfigType::BuildIndex:
+            SetConfigValue(cfg, BuildIndex, val_list[0]);
+            break;
+        case ConfigType::Index:
+            SetConfigValue(cfg, Index, val_list[0]);
+            break;
+        case ConfigType::Follow:
+            SetConfigValue(cfg, Follow, true);
+            break;
+        case ConfigType::MaxLines:
+            try {
+                SetConfigValue(cfg, MaxLines, std::stoull(val_list[0]));
+            }
+            catch(...) {
+                appendError("invalid value: %s", val_list[0].c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            break;
+        case ConfigType::MaxBytes:
+        {
+            uint64_t value = 0;
+            try {
+                size_t pos = 0;
+                value = std::stoull(val_list[0], &pos);
+                auto unit = val_list[0].substr(pos);
+                if ( unit == "K" ) {
+                    value <<= 10;
+                }
+                else if ( unit == "M" ) {
+                    value <<= 20;
+                }
+                else if ( unit == "G" ) {
+                    value <<= 30;
+                }
+                else if ( !unit.empty() ) {
+                    throw std::invalid_argument(unit);
+                }
+            }
+            catch(...) {
+                appendError("invalid value: %s", val_list[0].c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            SetConfigValue(cfg, MaxBytes, value);
+            break;
+        }
+        case ConfigType::Serve:
+            SetConfigValue(cfg, Serve, val_list[0]);
+            break;
+        case ConfigType::Query:
+            SetConfigValue(cfg, Query, val_list[0]);
+            break;
+        case ConfigType::Top:
+            try {
+                SetConfigValue(cfg, Top, std::stoul(val_list[0]));
+            }
+            catch(...) {
+                appendError("invalid value: %s", val_list[0].c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            break;
+        case ConfigType::NoCache:
+            SetConfigValue(cfg, NoCache, true);
+            break;
+        case ConfigType::NoHistory:
+            SetConfigValue(cfg, NoHistory, true);
+            break;
+        case ConfigType::NoIgnore:
+            SetConfigValue(cfg, NoIgnore, true);
+            break;
+        case ConfigType::SyncUpdate:
+            SetConfigValue(cfg, SyncUpdate, true);
+            break;
         case ConfigType::Border:
             if ( !val_list.empty() ) {
                 auto pos = val_list[0].find(':');
@@ -15,6 +15,7 @@ namespace leaf
 enum class ArgCategory {
     Layout,
     Search,
+    Server,
 
     MaxNum
 };
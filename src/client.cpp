@@ -0,0 +1,136 @@
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "client.h"
+#include "protocol.h"
+#include "error.h"
+#include "utils.h"
+
+namespace leaf
+{
+
+Client::Client(const std::string& socket_path, uint32_t top)
+    : socket_path_(socket_path), top_(top)
+{
+
+}
+
+Client::~Client() {
+    if ( fd_ != -1 ) {
+        close(fd_);
+    }
+}
+
+int Client::run() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ( socket_path_.length() >= sizeof(addr.sun_path) ) {
+        Error::getInstance().appendError(utils::strFormat("%s: the path of the socket is too long",
+                                                          socket_path_.c_str()));
+        return EXIT_FAILURE;
+    }
+    memcpy(addr.sun_path, socket_path_.c_str(), socket_path_.length());
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ( fd_ == -1 || connect(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1 ) {
+        Error::getInstance().appendError(utils::strFormat("%s: %s", socket_path_.c_str(), strerror(errno)));
+        return EXIT_FAILURE;
+    }
+
+    std::string pattern;
+    std::string query;
+    std::string output;
+    std::vector<char> text;
+    std::vector<HighlightPos> positions;
+    while ( std::getline(std::cin, pattern) ) {
+        if ( !pattern.empty() && pattern.back() == '\r' ) {
+            pattern.pop_back();
+        }
+        if ( pattern.length() > MaxPatternLen ) {
+            pattern.resize(MaxPatternLen);
+        }
+
+        QueryHeader header;
+        header.pattern_len = pattern.length();
+        header.top = top_;
+        query.assign(reinterpret_cast<const char*>(&header), sizeof(header)).append(pattern);
+        size_t sent = 0;
+        while ( sent < query.length() ) {
+            auto len = send(fd_, query.data() + sent, query.length() - sent, MSG_NOSIGNAL);
+            if ( len < 0 && errno == EINTR ) {
+                continue;
+            }
+            else if ( len < 0 ) {
+                Error::getInstance().appendError(utils::strFormat("%s: %s", socket_path_.c_str(),
+                                                                  strerror(errno)));
+                return EXIT_FAILURE;
+            }
+            sent += len;
+        }
+
+        ReplyHeader reply;
+        if ( !_receive(&reply, sizeof(reply)) ) {
+            return EXIT_FAILURE;
+        }
+
+        output.clear();
+        for ( uint32_t i = 0; i < reply.line_count; ++i ) {
+            ReplyLine line;
+            if ( !_receive(&line, sizeof(line)) ) {
+                return EXIT_FAILURE;
+            }
+            text.resize(line.len);
+            positions.resize(line.position_count);
+            if ( !_receive(text.data(), text.size())
+                 || !_receive(positions.data(), sizeof(HighlightPos) * positions.size()) ) {
+                return EXIT_FAILURE;
+            }
+
+            output += std::to_string(line.weight);
+            output.push_back('\t');
+            for ( uint32_t j = 0; j < positions.size(); ++j ) {
+                if ( j > 0 ) {
+                    output.push_back(',');
+                }
+                output += utils::strFormat<32>("%u:%u", positions[j].col, positions[j].len);
+            }
+            output.push_back('\t');
+            output.append(text.data(), text.size());
+            output.push_back('\n');
+        }
+        output.push_back('\n');
+
+        fwrite(output.data(), 1, output.length(), stdout);
+        fflush(stdout);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+bool Client::_receive(void* data, size_t len) {
+    size_t received = 0;
+    while ( received < len ) {
+        auto n = recv(fd_, static_cast<char*>(data) + received, len - received, 0);
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        else if ( n <= 0 ) {
+            Error::getInstance().appendError(utils::strFormat("%s: %s", socket_path_.c_str(),
+                                                              n == 0 ? "the server has closed the connection"
+                                                                     : strerror(errno)));
+            return false;
+        }
+        received += n;
+    }
+
+    return true;
+}
+
+} // end namespace leaf
@@ -0,0 +1,36 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <string>
+
+namespace leaf
+{
+
+/**
+ * The client of --serve, sends each line read from stdin to the server as a pattern,
+ * and prints the top lines of each result to stdout, one line each as
+ *   weight<TAB>col:len,col:len...<TAB>line
+ * followed by an empty line, the positions are the bytes matched.
+ */
+class Client
+{
+public:
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    Client(const std::string& socket_path, uint32_t top);
+    ~Client();
+
+    // returns the exit status
+    int run();
+
+private:
+    bool _receive(void* data, size_t len);
+
+private:
+    std::string socket_path_;
+    uint32_t    top_;
+    int         fd_{ -1 };
+};
+
+} // end namespace leaf
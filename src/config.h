@@ -15,9 +15,27 @@ enum class ConfigType
     Height,
     Indentation,
     SortPreference,
+    SortMethod,
+    HugePage,
+    Stats,
     Border,
     BorderChars,
     Margin,
+    SyncUpdate,
+    Fps,
+    NoIgnore,
+    NoCache,
+    NoHistory,
+    BuildIndex,
+    Index,
+    Follow,
+    MaxLines,
+    MaxBytes,
+    Dedup,
+    DedupBoost,
+    Serve,
+    Query,
+    Top,
 
     MaxConfigNum
 };
@@ -27,6 +45,11 @@ enum class Preference {
     End,
 };
 
+enum class SortMethod {
+    Merge,
+    Radix,
+};
+
 template <ConfigType T>
 struct ConfigValueType {
     using type = bool;
@@ -42,9 +65,18 @@ struct ConfigValueType {
 DefineConfigValue(Height, uint32_t)
 DefineConfigValue(Indentation, uint32_t)
 DefineConfigValue(SortPreference, Preference)
+DefineConfigValue(SortMethod, SortMethod)
 DefineConfigValue(Border, std::string)
 DefineConfigValue(BorderChars, std::vector<std::string>)
 DefineConfigValue(Margin, std::vector<uint32_t>)
+DefineConfigValue(Fps, uint32_t)
+DefineConfigValue(BuildIndex, std::string)
+DefineConfigValue(Index, std::string)
+DefineConfigValue(MaxLines, uint64_t)
+DefineConfigValue(MaxBytes, uint64_t)
+DefineConfigValue(Serve, std::string)
+DefineConfigValue(Query, std::string)
+DefineConfigValue(Top, uint32_t)
 
 #define SetConfigValue(container, cfg_type, value)                  \
     container[static_cast<uint32_t>(ConfigType::cfg_type)].reset(   \
@@ -43,10 +43,28 @@ private:
         SetConfigValue(cfg_, Height, 0);
         SetConfigValue(cfg_, Indentation, 2);
         SetConfigValue(cfg_, SortPreference, Preference::End);
+        SetConfigValue(cfg_, SortMethod, SortMethod::Merge);
+        SetConfigValue(cfg_, HugePage, false);
+        SetConfigValue(cfg_, Stats, false);
         SetConfigValue(cfg_, Border, "");
         SetConfigValue(cfg_, BorderChars,
                        std::vector<std::string>({"─","│","─","│","╭","╮","╯","╰"}));
         SetConfigValue(cfg_, Margin, std::vector<uint32_t>({0, 0, 0, 0}));
+        SetConfigValue(cfg_, SyncUpdate, false);
+        SetConfigValue(cfg_, Fps, 60);
+        SetConfigValue(cfg_, NoIgnore, false);
+        SetConfigValue(cfg_, NoCache, false);
+        SetConfigValue(cfg_, NoHistory, false);
+        SetConfigValue(cfg_, BuildIndex, "");
+        SetConfigValue(cfg_, Index, "");
+        SetConfigValue(cfg_, Follow, false);
+        SetConfigValue(cfg_, MaxLines, 0);
+        SetConfigValue(cfg_, MaxBytes, 0);
+        SetConfigValue(cfg_, Dedup, false);
+        SetConfigValue(cfg_, DedupBoost, false);
+        SetConfigValue(cfg_, Serve, "");
+        SetConfigValue(cfg_, Query, "");
+        SetConfigValue(cfg_, Top, 20);
     }
 
     std::vector<std::unique_ptr<ConfigBase>> cfg_;
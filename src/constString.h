@@ -10,12 +10,14 @@ struct ConstString
 {
     const char* str;
     uint32_t    len;
+    uint32_t    id;     // free for the owner of the string, e.g., yy numbers the lines read
 };
 
-static inline ConstString makeConstString(const char* str, uint32_t len) {
+static inline ConstString makeConstString(const char* str, uint32_t len, uint32_t id=0) {
     ConstString const_str;
     const_str.str = str;
     const_str.len = len;
+    const_str.id = id;
     return const_str;
 }
 
@@ -157,6 +157,7 @@ enum class Key
     Alt_Y,
     Alt_Z,
 
+    Paste   = 996,
     Char    = 997,
     Resize  = 998,
     Timeout = 999,
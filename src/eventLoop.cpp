@@ -0,0 +1,195 @@
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include "eventLoop.h"
+#include "error.h"
+
+namespace leaf
+{
+
+EventLoop::EventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if ( epoll_fd_ == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ( event_fd_ == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+
+    _add(event_fd_, [this] {
+        uint64_t count;
+        while ( read(event_fd_, &count, sizeof(count)) == -1 && errno == EINTR ) {
+        }
+        _runPosted();
+    });
+}
+
+EventLoop::~EventLoop() {
+    for ( auto fd : owned_fds_ ) {
+        close(fd);
+    }
+    close(event_fd_);
+    close(epoll_fd_);
+}
+
+void EventLoop::_add(int fd, std::function<void()>&& handler) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if ( epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+    handlers_[fd] = std::move(handler);
+}
+
+bool EventLoop::addReader(int fd, Callback&& callback) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if ( epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1 ) {
+        if ( errno == EPERM ) {
+            return false;
+        }
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+    handlers_[fd] = std::move(callback);
+    return true;
+}
+
+void EventLoop::removeReader(int fd) {
+    if ( handlers_.erase(fd) > 0 ) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+void EventLoop::addSignals(const sigset_t& sig_set, SignalCallback&& callback) {
+    auto fd = signalfd(-1, &sig_set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if ( fd == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+    owned_fds_.push_back(fd);
+
+    _add(fd, [fd, callback=std::move(callback)] {
+        struct signalfd_siginfo info;
+        while ( read(fd, &info, sizeof(info)) == sizeof(info) ) {
+            callback(info.ssi_signo);
+        }
+    });
+}
+
+EventLoop::TimerId EventLoop::addTimer(Callback&& callback) {
+    auto fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ( fd == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+    owned_fds_.push_back(fd);
+
+    _add(fd, [fd, callback=std::move(callback)] {
+        uint64_t expirations;
+        if ( read(fd, &expirations, sizeof(expirations)) == sizeof(expirations) ) {
+            callback();
+        }
+    });
+
+    return fd;
+}
+
+static struct timespec toTimespec(std::chrono::microseconds us) {
+    struct timespec ts;
+    ts.tv_sec = us.count() / 1000000;
+    ts.tv_nsec = (us.count() % 1000000) * 1000;
+    return ts;
+}
+
+void EventLoop::startTimer(TimerId timer, std::chrono::microseconds delay,
+                           std::chrono::microseconds interval) {
+    struct itimerspec spec;
+    // a zero it_value disarms the timer
+    spec.it_value = toTimespec(std::max(delay, std::chrono::microseconds(1)));
+    spec.it_interval = toTimespec(interval);
+    if ( timerfd_settime(timer, 0, &spec, nullptr) == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+void EventLoop::stopTimer(TimerId timer) {
+    struct itimerspec spec = {};
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+void EventLoop::post(Callback&& task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(task));
+        if ( posted_.size() > 1 ) {
+            // already woken up
+            return;
+        }
+    }
+    _wakeup();
+}
+
+void EventLoop::_wakeup() {
+    uint64_t one = 1;
+    while ( write(event_fd_, &one, sizeof(one)) == -1 && errno == EINTR ) {
+    }
+}
+
+void EventLoop::_runPosted() {
+    std::vector<Callback> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks.swap(posted_);
+    }
+
+    for ( auto& task : tasks ) {
+        if ( !running_.load(std::memory_order_relaxed) ) {
+            break;
+        }
+        task();
+    }
+}
+
+void EventLoop::run() {
+    struct epoll_event events[16];
+    while ( running_.load(std::memory_order_relaxed) ) {
+        auto n = epoll_wait(epoll_fd_, events, sizeof(events) / sizeof(events[0]), -1);
+        if ( n == -1 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            Error::getInstance().appendError(ErrorMessage);
+            std::exit(EXIT_FAILURE);
+        }
+
+        for ( int i = 0; i < n && running_.load(std::memory_order_relaxed); ++i ) {
+            auto iter = handlers_.find(events[i].data.fd);
+            if ( iter != handlers_.end() ) {
+                // the handler may remove itself
+                auto handler = iter->second;
+                handler();
+            }
+        }
+    }
+}
+
+void EventLoop::stop() {
+    running_.store(false, std::memory_order_relaxed);
+    _wakeup();
+}
+
+} // end namespace leaf
@@ -0,0 +1,91 @@
+_Pragma("once");
+
+#include <signal.h>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace leaf
+{
+
+/**
+ * A single-threaded event loop built on epoll.
+ * File descriptors, signals (signalfd), timers (timerfd) and tasks posted by other
+ * threads (eventfd) are all dispatched in the thread calling run().
+ * Except post() and stop(), the functions should be called in that thread, or
+ * before run() is called.
+ */
+class EventLoop
+{
+public:
+    using Callback = std::function<void()>;
+    using SignalCallback = std::function<void(int)>;
+    using TimerId = int;
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    EventLoop();
+    ~EventLoop();
+
+    /**
+     * callback is called whenever fd is readable.
+     * Returns false if fd does not support polling, e.g., fd is a regular file.
+     */
+    bool addReader(int fd, Callback&& callback);
+    void removeReader(int fd);
+
+    bool hasReader(int fd) const {
+        return handlers_.find(fd) != handlers_.end();
+    }
+
+    /**
+     * The signals in sig_set must be blocked in all threads.
+     */
+    void addSignals(const sigset_t& sig_set, SignalCallback&& callback);
+
+    /**
+     * Creates a disarmed timer.
+     */
+    TimerId addTimer(Callback&& callback);
+
+    /**
+     * Arms the timer to expire after delay, then every interval if interval is not zero.
+     * An armed timer is rearmed.
+     */
+    void startTimer(TimerId timer, std::chrono::microseconds delay,
+                    std::chrono::microseconds interval=std::chrono::microseconds(0));
+    void stopTimer(TimerId timer);
+
+    /**
+     * Runs task in the loop thread, can be called by any thread.
+     */
+    void post(Callback&& task);
+
+    void run();
+
+    /**
+     * Makes run() return, can be called by any thread.
+     */
+    void stop();
+
+private:
+    void _add(int fd, std::function<void()>&& handler);
+    void _wakeup();
+    void _runPosted();
+
+private:
+    int epoll_fd_{ -1 };
+    int event_fd_{ -1 };
+    std::unordered_map<int, Callback> handlers_;
+    std::vector<int> owned_fds_;    // signalfd and timerfd
+    std::atomic<bool> running_{ true };
+    std::mutex mutex_;              // guards posted_
+    std::vector<Callback> posted_;
+};
+
+} // end namespace leaf
@@ -0,0 +1,193 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include "fileCache.h"
+#include "utils.h"
+
+namespace leaf
+{
+
+constexpr uint32_t FileCache::NoDir;
+constexpr char FileCache::Magic[8];
+
+FileCache::~FileCache() {
+    if ( data_ != nullptr ) {
+        munmap(data_, size_);
+    }
+}
+
+std::string FileCache::defaultPath(const std::string& root, const char* suffix) {
+    auto real_path = realpath(root.c_str(), nullptr);
+    if ( real_path == nullptr ) {
+        return std::string();
+    }
+    std::string real_root(real_path);
+    free(real_path);
+
+    std::string dir;
+    auto cache_home = getenv("XDG_CACHE_HOME");
+    if ( cache_home != nullptr && cache_home[0] == '/' ) {
+        dir = cache_home;
+    }
+    else {
+        auto home = getenv("HOME");
+        if ( home == nullptr || home[0] == '\0' ) {
+            return std::string();
+        }
+        dir = std::string(home) + "/.cache";
+    }
+
+    mkdir(dir.c_str(), 0700);
+    dir += "/yoyo-leaf";
+    if ( mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST ) {
+        return std::string();
+    }
+
+    auto hash = static_cast<unsigned long long>(std::hash<std::string>()(real_root));
+    return dir + utils::strFormat<64>("/%016llx%s", hash, suffix);
+}
+
+bool FileCache::load(const std::string& file, const std::string& real_root, uint64_t stamp) {
+    auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(Header) ) {
+        close(fd);
+        return false;
+    }
+
+    size_ = st.st_size;
+    auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if ( data == MAP_FAILED ) {
+        return false;
+    }
+    data_ = data;
+
+    auto p = static_cast<const char*>(data_);
+    auto& header = *reinterpret_cast<const Header*>(p);
+    if ( memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.stamp != stamp
+         || header.size != size_ || header.dir_count == 0 ) {
+        return false;
+    }
+
+    size_t offset = sizeof(Header);
+    auto dirs_offset = offset + utils::align8(header.root_len);
+    auto children_offset = dirs_offset + sizeof(Dir) * header.dir_count;
+    auto names_offset = children_offset + utils::align8(sizeof(uint32_t) * header.child_count);
+    if ( names_offset + header.names_len != size_ ) {
+        return false;
+    }
+
+    if ( header.root_len != real_root.length()
+         || memcmp(p + offset, real_root.data(), real_root.length()) != 0 ) {
+        return false;
+    }
+
+    dirs_ = reinterpret_cast<const Dir*>(p + dirs_offset);
+    children_ = reinterpret_cast<const uint32_t*>(p + children_offset);
+    names_ = p + names_offset;
+
+    // the offsets are trusted once they are in range
+    for ( uint32_t i = 0; i < header.dir_count; ++i ) {
+        const auto& dir = dirs_[i];
+        if ( static_cast<uint64_t>(dir.path_offset) + dir.path_len > header.names_len
+             || static_cast<uint64_t>(dir.files_offset) + dir.files_len > header.names_len
+             || static_cast<uint64_t>(dir.subdirs_offset) + dir.subdirs_len > header.names_len
+             || static_cast<uint64_t>(dir.children_offset) + dir.child_count > header.child_count ) {
+            return false;
+        }
+    }
+
+    for ( uint32_t i = 0; i < header.child_count; ++i ) {
+        if ( children_[i] != NoDir && children_[i] >= header.dir_count ) {
+            return false;
+        }
+    }
+
+    dir_count_ = header.dir_count;
+    return true;
+}
+
+bool FileCache::save(const std::string& file, const std::string& real_root, uint64_t stamp,
+                     std::vector<Entry>&& entries) {
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.path < b.path;
+    });
+
+    if ( entries.empty() || !entries[0].path.empty() ) {
+        return false;
+    }
+
+    std::vector<Dir> dirs(entries.size());
+    std::vector<uint32_t> children;
+    std::string names;
+    std::string child_path;
+    for ( uint32_t i = 0; i < entries.size(); ++i ) {
+        const auto& entry = entries[i];
+        auto& dir = dirs[i];
+        dir.mtime = entry.mtime;
+        dir.rules_stamp = entry.rules_stamp;
+        dir.has_ignore_files = entry.has_ignore_files;
+        dir.path_offset = names.length();
+        dir.path_len = entry.path.length();
+        names += entry.path;
+        dir.files_offset = names.length();
+        dir.files_len = entry.files.length();
+        names += entry.files;
+        dir.subdirs_offset = names.length();
+        dir.subdirs_len = entry.subdirs.length();
+        names += entry.subdirs;
+
+        dir.children_offset = children.size();
+        const auto& subdirs = entry.subdirs;
+        for ( size_t start = 0; start < subdirs.length(); ) {
+            auto end = subdirs.find('\n', start);
+            child_path.assign(entry.path).append(subdirs, start, end - start).push_back('/');
+            auto iter = std::lower_bound(entries.begin() + i + 1, entries.end(), child_path,
+                                         [](const Entry& e, const std::string& path) {
+                                             return e.path < path;
+                                         });
+            children.push_back(iter != entries.end() && iter->path == child_path
+                               ? static_cast<uint32_t>(iter - entries.begin()) : NoDir);
+            start = end + 1;
+        }
+        dir.child_count = children.size() - dir.children_offset;
+    }
+
+    Header header;
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.stamp = stamp;
+    header.root_len = real_root.length();
+    header.dir_count = dirs.size();
+    header.child_count = children.size();
+    header.names_len = names.length();
+    header.size = sizeof(Header) + utils::align8(real_root.length()) + sizeof(Dir) * dirs.size()
+                  + utils::align8(sizeof(uint32_t) * children.size()) + names.length();
+
+    std::string data;
+    data.reserve(header.size);
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(real_root);
+    data.resize(utils::align8(data.length()), '\0');
+    data.append(reinterpret_cast<const char*>(dirs.data()), sizeof(Dir) * dirs.size());
+    data.append(reinterpret_cast<const char*>(children.data()), sizeof(uint32_t) * children.size());
+    data.resize(utils::align8(data.length()), '\0');
+    data.append(names);
+
+    // a walk running at the same time never maps a partial file
+    return utils::replaceFile(file, data.length(), 0600, [&data](char* p) {
+        memcpy(p, data.data(), data.length());
+    });
+}
+
+} // end namespace leaf
@@ -0,0 +1,113 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace leaf
+{
+
+/**
+ * The list of the files found by the last walk of a directory tree, saved to a file
+ * and mapped into memory by the next walk of the tree.
+ * Each directory has its mtime, the names of its files and the names of its
+ * subdirectories, so that a directory whose mtime has not changed is not read again.
+ *
+ * The file is made up of the Header, the root, the Dir records sorted by path, the
+ * indices of the subdirectories and the names, the root directory is the first Dir.
+ */
+class FileCache
+{
+public:
+    static constexpr uint32_t NoDir = UINT32_MAX;
+
+    struct Dir
+    {
+        int64_t  mtime;             // ns
+        uint64_t rules_stamp;       // IgnoreRules::stamp() of the rules applied to the directory
+        uint32_t path_offset;       // relative to the root, ending with '/' except the root
+        uint32_t path_len;
+        uint32_t files_offset;      // "name\n" for each file
+        uint32_t files_len;
+        uint32_t subdirs_offset;    // "name\n" for each subdirectory
+        uint32_t subdirs_len;
+        uint32_t children_offset;   // the index of each subdirectory, NoDir if it is not cached
+        uint32_t child_count;
+        uint32_t has_ignore_files;  // .gitignore or .ignore is in the directory
+    };
+
+    // a directory found by the walk
+    struct Entry
+    {
+        std::string path;
+        int64_t     mtime;
+        uint64_t    rules_stamp;
+        bool        has_ignore_files;
+        std::string files;
+        std::string subdirs;
+    };
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    FileCache() = default;
+    ~FileCache();
+
+    /**
+     * Returns $XDG_CACHE_HOME/yoyo-leaf/<hash of the real path of root><suffix>,
+     * or ~/.cache/yoyo-leaf/..., the directories are created if they do not exist.
+     * Returns "" if there is no home.
+     */
+    static std::string defaultPath(const std::string& root, const char* suffix);
+
+    /**
+     * Maps file, returns false if it cannot be read, or it is not the cache of real_root
+     * saved with the same stamp.
+     */
+    bool load(const std::string& file, const std::string& real_root, uint64_t stamp);
+
+    // replaces file atomically
+    static bool save(const std::string& file, const std::string& real_root, uint64_t stamp,
+                     std::vector<Entry>&& entries);
+
+    uint32_t size() const noexcept {
+        return dir_count_;
+    }
+
+    const Dir& dir(uint32_t index) const noexcept {
+        return dirs_[index];
+    }
+
+    const char* names(uint32_t offset) const noexcept {
+        return names_ + offset;
+    }
+
+    const uint32_t* children(const Dir& dir) const noexcept {
+        return children_ + dir.children_offset;
+    }
+
+private:
+    struct Header
+    {
+        char     magic[8];
+        uint64_t stamp;
+        uint64_t size;          // of the file
+        uint32_t root_len;
+        uint32_t dir_count;
+        uint32_t child_count;
+        uint32_t names_len;
+    };
+
+    static constexpr char Magic[8] = { 'L', 'E', 'A', 'F', 'F', 'C', '0', '1' };
+
+private:
+    void*           data_{ nullptr };
+    size_t          size_{ 0 };
+    uint32_t        dir_count_{ 0 };
+    const Dir*      dirs_{ nullptr };
+    const uint32_t* children_{ nullptr };
+    const char*     names_{ nullptr };
+};
+
+} // end namespace leaf
@@ -0,0 +1,466 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <iterator>
+#include "fileWalker.h"
+#include "utils.h"
+
+namespace leaf
+{
+
+constexpr uint32_t FileWalker::BufferSize;
+constexpr uint32_t FileWalker::DirentBufferSize;
+constexpr std::chrono::milliseconds FileWalker::FlushInterval;
+constexpr std::chrono::seconds FileWalker::RacyInterval;
+
+// the layout of the records returned by getdents64
+struct LinuxDirent64
+{
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+// calls f(name, len) for each line of names
+template <typename F>
+static void forEachName(const char* names, uint32_t len, F&& f) {
+    auto end = names + len;
+    while ( names < end ) {
+        auto eol = static_cast<const char*>(memchr(names, '\n', end - names));
+        if ( eol == nullptr ) {
+            eol = end;
+        }
+        f(names, static_cast<uint32_t>(eol - names));
+        names = eol + 1;
+    }
+}
+
+FileWalker::FileWalker(uint32_t thread_count, Output&& output, Done&& done)
+    : output_(std::move(output)), done_(std::move(done))
+{
+    thread_count = std::max(thread_count, 1u);
+    workers_.reserve(thread_count);
+    for ( uint32_t i = 0; i < thread_count; ++i ) {
+        workers_.emplace_back(new Worker);
+    }
+}
+
+FileWalker::~FileWalker() {
+    stop();
+}
+
+void FileWalker::start(const std::string& root) {
+    root_fd_ = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if ( root_fd_ == -1 ) {
+        done_();
+        return;
+    }
+
+    auto real_path = realpath(root.c_str(), nullptr);
+    if ( real_path != nullptr ) {
+        real_root_ = real_path;
+        free(real_path);
+    }
+    else {
+        cache_file_.clear();
+    }
+
+    Dir dir{ std::string(), _loadParentRules() };
+    if ( !cache_file_.empty() ) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        racy_mtime_ = utils::toNs(now) - std::chrono::nanoseconds(RacyInterval).count();
+
+        cache_.reset(new FileCache);
+        if ( cache_->load(cache_file_, real_root_, ignore_files_) ) {
+            dir.cached = 0;
+        }
+        else {
+            cache_.reset();
+        }
+    }
+
+    running_ = true;
+    _push(0, std::move(dir));
+    threads_.reserve(workers_.size());
+    for ( uint32_t i = 0; i < workers_.size(); ++i ) {
+        threads_.emplace_back(&FileWalker::_run, this, i);
+    }
+}
+
+void FileWalker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        running_ = false;
+    }
+    idle_cond_.notify_all();
+
+    for ( auto& t : threads_ ) {
+        t.join();
+    }
+    threads_.clear();
+
+    if ( root_fd_ != -1 ) {
+        close(root_fd_);
+        root_fd_ = -1;
+    }
+}
+
+void FileWalker::_run(uint32_t id) {
+    auto& worker = *workers_[id];
+    worker.dirents.reset(new char[DirentBufferSize]);
+
+    Dir dir;
+    while ( running_ ) {
+        if ( _take(id, dir) ) {
+            if ( dir.cached == FileCache::NoDir || !_readCachedDir(id, dir) ) {
+                _readDir(id, dir);
+            }
+            if ( worker.len > 0 && std::chrono::steady_clock::now() - worker.last_flush >= FlushInterval ) {
+                _flush(worker);
+            }
+            if ( --pending_ == 0 ) {
+                std::lock_guard<std::mutex> lock(idle_mutex_);
+                idle_cond_.notify_all();
+            }
+            continue;
+        }
+
+        // the lines found so far are not held back while waiting
+        _flush(worker);
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        idle_cond_.wait(lock, [this] {
+            return !running_ || queued_ > 0 || pending_ == 0;
+        });
+        if ( pending_ == 0 ) {
+            break;
+        }
+    }
+
+    _flush(worker);
+    if ( ++finished_ == workers_.size() && running_ ) {
+        done_();
+        _saveCache();
+    }
+}
+
+bool FileWalker::_take(uint32_t id, Dir& dir) {
+    if ( queued_ == 0 ) {
+        return false;
+    }
+
+    // depth first in its own queue, the directories stolen are close to the root
+    {
+        auto& worker = *workers_[id];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if ( !worker.dirs.empty() ) {
+            dir = std::move(worker.dirs.back());
+            worker.dirs.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+
+    for ( uint32_t i = 1; i < workers_.size(); ++i ) {
+        auto& victim = *workers_[(id + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if ( !victim.dirs.empty() ) {
+            dir = std::move(victim.dirs.front());
+            victim.dirs.pop_front();
+            --queued_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FileWalker::_push(uint32_t id, Dir&& dir) {
+    // counted first, so that queued_ is never less than the directories in the queues
+    ++pending_;
+    ++queued_;
+    {
+        auto& worker = *workers_[id];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.dirs.push_back(std::move(dir));
+    }
+    {
+        // the idle workers check queued_ with the lock held
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_cond_.notify_one();
+}
+
+void FileWalker::_readDir(uint32_t id, const Dir& dir) {
+    auto& worker = *workers_[id];
+    const auto& path = dir.path;
+    auto fd = openat(root_fd_, path.empty() ? "." : path.c_str(),
+                     O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if ( fd == -1 ) {
+        // e.g., permission denied, skipped like find does
+        return;
+    }
+
+    /**
+     * The mtime is taken before the directory is read, so a change while reading is seen
+     * next time. The mtime has a coarse granularity, a directory changed again within the
+     * same tick keeps its mtime, so a recent mtime is not trusted.
+     */
+    FileCache::Entry* entry = nullptr;
+    struct stat st;
+    if ( !cache_file_.empty() && fstat(fd, &st) == 0 ) {
+        auto mtime = utils::toNs(st.st_mtim);
+        worker.entries.push_back({ path, mtime < racy_mtime_ ? mtime : -1, 0, false,
+                                   std::string(), std::string() });
+        entry = &worker.entries.back();
+    }
+
+    auto rules = dir.rules;
+    if ( ignore_files_ ) {
+        auto loaded = _loadRules(fd, std::string(), dir);
+        if ( entry != nullptr ) {
+            entry->rules_stamp = loaded->stamp();
+            entry->has_ignore_files = loaded->hasFiles();
+        }
+        if ( !loaded->empty() ) {
+            rules = std::move(loaded);
+        }
+    }
+
+    // the directory has changed since the last walk, its subdirectories may have not
+    std::unordered_map<std::string, uint32_t> cached_subdirs;
+    if ( dir.cached != FileCache::NoDir ) {
+        const auto& cached = cache_->dir(dir.cached);
+        auto children = cache_->children(cached);
+        uint32_t i = 0;
+        forEachName(cache_->names(cached.subdirs_offset), cached.subdirs_len,
+                    [&](const char* name, uint32_t len) {
+                        if ( i < cached.child_count ) {
+                            cached_subdirs.emplace(std::string(name, len), children[i++]);
+                        }
+                    });
+    }
+
+    while ( running_ ) {
+        auto n = syscall(SYS_getdents64, fd, worker.dirents.get(), DirentBufferSize);
+        if ( n <= 0 ) {
+            break;
+        }
+
+        for ( long pos = 0; pos < n; ) {
+            auto dirent = reinterpret_cast<LinuxDirent64*>(worker.dirents.get() + pos);
+            pos += dirent->d_reclen;
+
+            // ".", ".." and the hidden files
+            if ( dirent->d_name[0] == '.' ) {
+                continue;
+            }
+
+            auto type = dirent->d_type;
+            if ( type == DT_UNKNOWN ) {
+                if ( fstatat(fd, dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1 ) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if ( type != DT_REG && type != DT_DIR ) {
+                continue;
+            }
+
+            uint32_t name_len = strlen(dirent->d_name);
+            if ( rules && rules->isIgnored(path, dirent->d_name, name_len, type == DT_DIR) ) {
+                continue;
+            }
+
+            if ( type == DT_REG ) {
+                _append(worker, path, dirent->d_name, name_len);
+                if ( entry != nullptr ) {
+                    entry->files.append(dirent->d_name, name_len).push_back('\n');
+                }
+            }
+            else {
+                std::string sub_dir;
+                sub_dir.reserve(path.length() + name_len + 1);
+                sub_dir.append(path).append(dirent->d_name, name_len).push_back('/');
+                auto cached = FileCache::NoDir;
+                if ( !cached_subdirs.empty() ) {
+                    auto iter = cached_subdirs.find(dirent->d_name);
+                    if ( iter != cached_subdirs.end() ) {
+                        cached = iter->second;
+                    }
+                }
+                if ( entry != nullptr ) {
+                    entry->subdirs.append(dirent->d_name, name_len).push_back('\n');
+                }
+                _push(id, { std::move(sub_dir), rules, cached });
+            }
+        }
+    }
+
+    close(fd);
+}
+
+bool FileWalker::_readCachedDir(uint32_t id, const Dir& dir) {
+    const auto& cached = cache_->dir(dir.cached);
+    const auto& path = dir.path;
+    struct stat st;
+    if ( fstatat(root_fd_, path.empty() ? "." : path.c_str(), &st, AT_SYMLINK_NOFOLLOW) == -1
+         || !S_ISDIR(st.st_mode) || utils::toNs(st.st_mtim) != cached.mtime ) {
+        return false;
+    }
+
+    // the files were listed with the same rules if the ignore files have not changed
+    auto rules = dir.rules;
+    uint64_t stamp = rules ? rules->stamp() : 0;
+    if ( ignore_files_ && cached.has_ignore_files ) {
+        auto loaded = _loadRules(root_fd_, path, dir);
+        stamp = loaded->stamp();
+        if ( !loaded->empty() ) {
+            rules = std::move(loaded);
+        }
+    }
+
+    if ( stamp != cached.rules_stamp ) {
+        return false;
+    }
+
+    auto& worker = *workers_[id];
+    auto files = cache_->names(cached.files_offset);
+    forEachName(files, cached.files_len, [&](const char* name, uint32_t len) {
+        _append(worker, path, name, len);
+    });
+
+    auto subdirs = cache_->names(cached.subdirs_offset);
+    auto children = cache_->children(cached);
+    uint32_t i = 0;
+    forEachName(subdirs, cached.subdirs_len, [&](const char* name, uint32_t len) {
+        std::string sub_dir;
+        sub_dir.reserve(path.length() + len + 1);
+        sub_dir.append(path).append(name, len).push_back('/');
+        auto child = i < cached.child_count ? children[i++] : FileCache::NoDir;
+        _push(id, { std::move(sub_dir), rules, child });
+    });
+
+    if ( !cache_file_.empty() ) {
+        worker.entries.push_back({ path, cached.mtime, stamp, cached.has_ignore_files != 0,
+                                   std::string(files, cached.files_len),
+                                   std::string(subdirs, cached.subdirs_len) });
+    }
+
+    return true;
+}
+
+std::shared_ptr<IgnoreRules> FileWalker::_loadRules(int fd, const std::string& prefix, const Dir& dir) {
+    auto rules = std::make_shared<IgnoreRules>(dir.rules, dir.path.length());
+    // the patterns of .ignore take precedence over the ones of .gitignore
+    rules->load(fd, (prefix + ".gitignore").c_str());
+    rules->load(fd, (prefix + ".ignore").c_str());
+    return rules;
+}
+
+std::shared_ptr<const IgnoreRules> FileWalker::_loadParentRules() {
+    struct stat st;
+    if ( !ignore_files_ || real_root_.empty() || fstatat(root_fd_, ".git", &st, AT_SYMLINK_NOFOLLOW) == 0 ) {
+        return nullptr;
+    }
+
+    std::string path(real_root_);
+
+    // the directories above root up to the root of the git repository,
+    // with the path of root relative to each of them
+    std::vector<std::pair<std::string, std::string>> dirs;
+    bool found = false;
+    std::string prefix;
+    while ( !found && path.length() > 1 ) {
+        auto pos = path.rfind('/');
+        prefix = path.substr(pos + 1) + "/" + prefix;
+        path.resize(pos == 0 ? 1 : pos);
+        dirs.emplace_back(path, prefix);
+        found = fstatat(AT_FDCWD, (path + "/.git").c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0;
+    }
+
+    // the ignore files outside a git repository do not apply
+    if ( !found ) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const IgnoreRules> parent;
+    for ( auto iter = dirs.rbegin(); iter != dirs.rend(); ++iter ) {
+        auto fd = open(iter->first.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if ( fd == -1 ) {
+            continue;
+        }
+
+        auto rules = std::make_shared<IgnoreRules>(parent, 0, iter->second);
+        rules->load(fd, ".gitignore");
+        rules->load(fd, ".ignore");
+        close(fd);
+        if ( !rules->empty() ) {
+            parent = rules;
+        }
+    }
+
+    return parent;
+}
+
+void FileWalker::_saveCache() {
+    if ( cache_file_.empty() ) {
+        return;
+    }
+
+    std::vector<FileCache::Entry> entries;
+    for ( auto& worker : workers_ ) {
+        std::move(worker->entries.begin(), worker->entries.end(), std::back_inserter(entries));
+        worker->entries.clear();
+    }
+
+    FileCache::save(cache_file_, real_root_, ignore_files_, std::move(entries));
+    cache_.reset();
+}
+
+void FileWalker::_append(Worker& worker, const std::string& dir, const char* name, uint32_t name_len) {
+    uint32_t len = dir.length() + name_len + 1;
+    if ( worker.len + len > BufferSize ) {
+        _flush(worker);
+    }
+
+    if ( !worker.buffer ) {
+        worker.buffer.reset(new char[BufferSize]);
+    }
+
+    auto p = worker.buffer.get() + worker.len;
+    memcpy(p, dir.data(), dir.length());
+    memcpy(p + dir.length(), name, name_len);
+    p[len - 1] = '\n';
+    worker.len += len;
+}
+
+void FileWalker::_flush(Worker& worker) {
+    if ( worker.len == 0 ) {
+        return;
+    }
+
+    // a buffer flushed early is copied, so that little memory is wasted
+    if ( worker.len < (BufferSize >> 1) ) {
+        std::unique_ptr<char[]> data(new char[worker.len]);
+        memcpy(data.get(), worker.buffer.get(), worker.len);
+        output_(std::move(data), worker.len);
+    }
+    else {
+        output_(std::move(worker.buffer), worker.len);
+    }
+
+    worker.len = 0;
+    worker.last_flush = std::chrono::steady_clock::now();
+}
+
+} // end namespace leaf
@@ -0,0 +1,126 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include "ignoreRules.h"
+#include "fileCache.h"
+
+namespace leaf
+{
+
+/**
+ * Lists the regular files under a directory on several threads, the same files as
+ *   find . -name "." -o -name ".*" -prune -o -type f -printf "%P\n"
+ * lists, but in no particular order.
+ * Every worker has a queue of directories, it reads the directories it has found
+ * itself first, and steals from the other queues when its own one is empty.
+ * The paths are appended line by line to a large buffer of the worker, which is
+ * handed over when it is full, when the worker runs out of directories, or after
+ * FlushInterval, so the lines come out while the tree is being walked.
+ * Unless disabled, the files and directories matched by the .gitignore and .ignore
+ * files are skipped, and an ignored directory is never opened. The ignore files of
+ * the directories above the root are honoured up to the root of the git repository.
+ * With a cache file, the directories whose mtime has not changed since the last walk
+ * are not read, their files are listed from the cache.
+ */
+class FileWalker
+{
+public:
+    // data holds len bytes of complete lines
+    using Output = std::function<void(std::unique_ptr<char[]>&& data, uint32_t len)>;
+    using Done = std::function<void()>;
+
+    FileWalker(const FileWalker&) = delete;
+    FileWalker& operator=(const FileWalker&) = delete;
+
+    /**
+     * output and done are called in the worker threads, done is called once after
+     * the last output if the walk is not stopped.
+     */
+    FileWalker(uint32_t thread_count, Output&& output, Done&& done);
+    ~FileWalker();
+
+    // called before start()
+    void setIgnoreFiles(bool enable) {
+        ignore_files_ = enable;
+    }
+
+    /**
+     * Called before start(), the list of the files is loaded from file if it is the
+     * cache of the same root, and saved to file when the walk is done.
+     */
+    void setCacheFile(const std::string& file) {
+        cache_file_ = file;
+    }
+
+    // the paths are relative to root
+    void start(const std::string& root=".");
+    void stop();
+
+private:
+    static constexpr uint32_t BufferSize = 256 * 1024;
+    static constexpr uint32_t DirentBufferSize = 32 * 1024;
+    static constexpr std::chrono::milliseconds FlushInterval{ 20 };
+    // the directories modified within RacyInterval before the walk are read again next time
+    static constexpr std::chrono::seconds RacyInterval{ 2 };
+
+    struct Dir
+    {
+        // relative to root, ending with '/' except the root itself, which is ""
+        std::string path;
+        // the rules inherited from the parent directories, nullptr if there is none
+        std::shared_ptr<const IgnoreRules> rules;
+        uint32_t cached{ FileCache::NoDir };    // the index in cache_
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;       // guards dirs
+        std::deque<Dir> dirs;
+        std::unique_ptr<char[]> buffer;
+        uint32_t len{ 0 };
+        std::chrono::steady_clock::time_point last_flush;
+        std::unique_ptr<char[]> dirents;
+        std::vector<FileCache::Entry> entries;  // the directories to save to the cache file
+    };
+
+    void _run(uint32_t id);
+    bool _take(uint32_t id, Dir& dir);
+    void _push(uint32_t id, Dir&& dir);
+    void _readDir(uint32_t id, const Dir& dir);
+    bool _readCachedDir(uint32_t id, const Dir& dir);
+    std::shared_ptr<IgnoreRules> _loadRules(int fd, const std::string& prefix, const Dir& dir);
+    std::shared_ptr<const IgnoreRules> _loadParentRules();
+    void _saveCache();
+    void _append(Worker& worker, const std::string& dir, const char* name, uint32_t name_len);
+    void _flush(Worker& worker);
+
+private:
+    Output output_;
+    Done   done_;
+    int    root_fd_{ -1 };
+    bool   ignore_files_{ true };
+    std::string real_root_;
+    std::string cache_file_;
+    std::unique_ptr<FileCache> cache_;     // loaded from cache_file_, nullptr if there is none
+    int64_t     racy_mtime_{ 0 };
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool>     running_{ false };
+    std::atomic<uint64_t> pending_{ 0 };    // the directories queued or being read
+    std::atomic<uint64_t> queued_{ 0 };     // the directories queued
+    std::atomic<uint32_t> finished_{ 0 };   // the workers that have finished
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cond_;
+};
+
+} // end namespace leaf
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cstring>
+#include <sys/resource.h>
 #include "fuzzyEngine.h"
 
 namespace leaf
@@ -7,17 +8,150 @@ namespace leaf
 
 #define MAX_TASK_COUNT(cpu_count) ((cpu_count) << 3)
 
+// counts the page faults of a search and trims the scratch buffers
+struct FuzzyEngine::SearchScope
+{
+    explicit SearchScope(FuzzyEngine* engine) : engine(engine) {
+        getrusage(RUSAGE_SELF, &usage);
+    }
+    ~SearchScope() {
+        struct rusage end_usage;
+        getrusage(RUSAGE_SELF, &end_usage);
+        auto& stats = engine->statistics_;
+        uint64_t minor_faults = end_usage.ru_minflt - usage.ru_minflt;
+        uint64_t major_faults = end_usage.ru_majflt - usage.ru_majflt;
+        ++stats.search_count;
+        stats.minor_faults += minor_faults;
+        stats.major_faults += major_faults;
+        stats.max_faults = std::max(stats.max_faults, minor_faults + major_faults);
+        engine->scratch_pool_.recycle();
+    }
+    FuzzyEngine* engine;
+    struct rusage usage;
+};
+
 Result FuzzyEngine::fuzzyMatch(const StrContainer::const_iterator& source_begin,
                                uint32_t source_size,
                                const std::string& pattern,
                                Preference preference,
                                DigestFn get_digest,
-                               bool sort_results)
+                               bool sort_results,
+                               SortMethod sort_method)
 {
     if ( source_begin == nullptr || source_size == 0 ) {
         return Result();
     }
 
+    auto source = StrContainer::spans(source_begin, source_begin + source_size);
+    return fuzzyMatch(source, pattern, preference, get_digest, sort_results, sort_method);
+}
+
+Result FuzzyEngine::fuzzyMatch(const SpanList<StrType>& source,
+                               const std::string& pattern,
+                               Preference preference,
+                               DigestFn get_digest,
+                               bool sort_results,
+                               SortMethod sort_method,
+                               const uint64_t* signatures)
+{
+    // offsets[k] is the index of the first element of source[k]
+    std::vector<uint32_t> offsets;
+    offsets.reserve(source.size());
+    uint32_t source_size = 0;
+    for ( const auto& span : source ) {
+        offsets.push_back(source_size);
+        source_size += span.size;
+    }
+
+    if ( source_size == 0 ) {
+        return Result();
+    }
+
+    // returns the index of the span that contains the element at index
+    auto locate = [&offsets](uint32_t index) -> uint32_t {
+        return std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+    };
+
+    SearchScope search_scope(this);
+
+    auto results = scratch_pool_.get<MatchResult>(ScratchPool::Results, source_size);
+    MatchSpan* spans = span_count_ > 0 ? scratch_pool_.get<MatchSpan>(ScratchPool::Spans, source_size) : nullptr;
+    auto results_count = _match(source, offsets, pattern, preference, signatures, results, spans);
+    if ( results_count == 0 ) {
+        return Result();
+    }
+
+    if ( sort_results ) {
+        sort(results, results_count, sort_method);
+    }
+
+    if ( spans != nullptr ) {
+        _recordSpans(source, offsets, results, results_count, spans);
+    }
+
+    Result r{ WeightContainer(results_count), StrContainer(results_count) };
+    auto& weight_list = std::get<0>(r);
+    auto& str_list = std::get<1>(r);
+    auto gather = [&source, &offsets, &locate, &weight_list, &str_list, results](uint32_t first,
+                                                                                 uint32_t last) {
+        if ( source.size() == 1 ) {
+            auto data = source[0].data;
+            for ( auto i = first; i < last; ++i ) {
+                weight_list[i] = results[i].weight;
+                str_list[i] = data[results[i].index];
+            }
+        }
+        else {
+            for ( auto i = first; i < last; ++i ) {
+                auto index = results[i].index;
+                auto k = locate(index);
+                weight_list[i] = results[i].weight;
+                str_list[i] = source[k].data[index - offsets[k]];
+            }
+        }
+    };
+
+    if ( cpu_count_ == 1 || results_count < 50000 ) {
+        gather(0, results_count);
+    }
+    else
+    {
+        uint32_t max_task_count = MAX_TASK_COUNT(cpu_count_);
+        uint32_t chunk_size = (results_count + max_task_count - 1) / max_task_count;
+        if ( chunk_size < 4096 ) {
+            chunk_size = std::max(4096u, (source_size + cpu_count_ - 1) / cpu_count_);
+        }
+        for ( uint32_t offset = 0; offset < results_count; offset += chunk_size ) {
+            uint32_t length = std::min(chunk_size, results_count - offset);
+
+            thread_pool_.enqueueTask([&gather, offset, length] {
+                gather(offset, offset + length);
+            });
+        }
+        thread_pool_.join();
+    }
+
+    return r;
+}
+
+/**
+ * Matches each element of source against pattern in parallel, and moves the elements
+ * matched to the front of results, in the order of index. Returns their number.
+ */
+uint32_t FuzzyEngine::_match(const SpanList<StrType>& source,
+                             const std::vector<uint32_t>& offsets,
+                             const std::string& pattern,
+                             Preference preference,
+                             const uint64_t* signatures,
+                             MatchResult* results,
+                             MatchSpan* spans,
+                             const std::atomic<bool>* cancel)
+{
+    auto source_size = static_cast<uint32_t>(offsets.back() + source[source.size() - 1].size);
+    auto locate = [&offsets](uint32_t index) -> uint32_t {
+        return std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+    };
+
     if ( pattern != pattern_ ) {
         pattern_ = pattern;
         pattern_ctxt_.reset(initPattern(pattern_.c_str(), pattern_.length()));
@@ -27,6 +161,9 @@ Result FuzzyEngine::fuzzyMatch(const StrContainer::const_iterator& source_begin,
         thread_pool_.start(cpu_count_);
     }
 
+    // getWeight() only looks at the first 63 characters of the pattern
+    uint64_t pattern_signature = getSignature(pattern_.c_str(), std::min(pattern_.length(), static_cast<size_t>(63)));
+
     uint32_t max_task_count  = MAX_TASK_COUNT(cpu_count_);
     uint32_t chunk_size = (source_size + max_task_count - 1) / max_task_count;
     if ( cpu_count_ == 1 ) {
@@ -36,16 +173,35 @@ Result FuzzyEngine::fuzzyMatch(const StrContainer::const_iterator& source_begin,
         chunk_size = std::max(4096u, (source_size + cpu_count_ - 1) / cpu_count_);
     }
 
-    std::unique_ptr<MatchResult[]> the_results(new MatchResult[source_size]);
-    auto results = the_results.get();
+    const BonusFn* bonus = bonus_ ? &bonus_ : nullptr;
     for ( uint32_t offset = 0; offset < source_size; offset += chunk_size ) {
         uint32_t length = std::min(chunk_size, source_size - offset);
 
-        thread_pool_.enqueueTask([&source_begin, this, results, offset, length, preference] {
-            for ( auto i = offset; i < offset + length; ++i ) {
-                results[i].weight = getWeight((source_begin + i)->str, (source_begin + i)->len,
-                                              pattern_ctxt_.get(), preference);
-                results[i].index = i;
+        thread_pool_.enqueueTask([&source, &offsets, &locate, this, results, spans, offset, length, preference,
+                                  signatures, pattern_signature, cancel, bonus] {
+            // a chunk may cross several spans, sweep them one by one
+            auto i = offset;
+            auto last = offset + length;
+            for ( auto k = locate(offset); i < last; ++k ) {
+                auto data = source[k].data;
+                auto span_offset = offsets[k];
+                auto span_last = std::min(last, static_cast<uint32_t>(span_offset + source[k].size));
+                for ( ; i < span_last; ++i ) {
+                    if ( cancel != nullptr && (i & 1023) == 0 && cancel->load(std::memory_order_relaxed) ) {
+                        return;
+                    }
+                    results[i].index = i;
+                    if ( signatures != nullptr && (signatures[i] & pattern_signature) != pattern_signature ) {
+                        results[i].weight = MIN_WEIGHT;
+                        continue;
+                    }
+                    const auto& str = data[i - span_offset];
+                    results[i].weight = getWeight(str.str, str.len, pattern_ctxt_.get(), preference,
+                                                  spans ? spans + i : nullptr);
+                    if ( bonus != nullptr && results[i].weight > MIN_WEIGHT ) {
+                        results[i].weight += (*bonus)(str);
+                    }
+                }
             }
         });
     }
@@ -53,6 +209,10 @@ Result FuzzyEngine::fuzzyMatch(const StrContainer::const_iterator& source_begin,
     // blocks until all tasks are done
     thread_pool_.join();
 
+    if ( cancel != nullptr && cancel->load(std::memory_order_relaxed) ) {
+        return 0;
+    }
+
     uint32_t results_count = 0;
     for (uint32_t i = 0; i < source_size; ++i ) {
         if ( results[i].weight > MIN_WEIGHT ) {
@@ -63,183 +223,518 @@ Result FuzzyEngine::fuzzyMatch(const StrContainer::const_iterator& source_begin,
         }
     }
 
-    if ( results_count == 0 ) {
-        return Result();
+    return results_count;
+}
+
+uint32_t FuzzyEngine::topMatch(const SpanList<StrType>& source,
+                               const std::string& pattern,
+                               Preference preference,
+                               MatchResult* top,
+                               uint32_t top_count,
+                               uint32_t& match_count,
+                               const std::atomic<bool>* cancel,
+                               const uint64_t* signatures)
+{
+    match_count = 0;
+    std::vector<uint32_t> offsets;
+    offsets.reserve(source.size());
+    uint32_t source_size = 0;
+    for ( const auto& span : source ) {
+        offsets.push_back(source_size);
+        source_size += span.size;
     }
 
-    if ( sort_results ) {
-        if ( cpu_count_ == 1 || results_count < 50000 ) {
-            std::sort(results, results + results_count,
-                      [](const MatchResult& a, const MatchResult& b) {
-                          return a.weight > b.weight;
-                      });
-        }
-        else {
-            chunk_size = (results_count + max_task_count - 1) / max_task_count;
-            if ( chunk_size < 4096 ) {
-                chunk_size = std::max(4096u, (source_size + cpu_count_ - 1) / cpu_count_);
-            }
-            for ( uint32_t offset = 0; offset < results_count; offset += chunk_size ) {
-                uint32_t length = std::min(chunk_size, results_count - offset);
-
-                thread_pool_.enqueueTask([results, offset, length] {
-                    std::sort(results + offset, results + (offset + length),
-                              [](const MatchResult& a, const MatchResult& b) {
-                                  return a.weight > b.weight;
-                              });
-                });
-            }
+    if ( source_size == 0 ) {
+        return 0;
+    }
 
-            // blocks until all tasks are done
-            thread_pool_.join();
-
-            auto task_count = (results_count + chunk_size - 1) / chunk_size;
-            std::unique_ptr<MatchResult[]> result_buffer(new MatchResult[chunk_size * (task_count >> 1)]);
-            while ( chunk_size < results_count ) {
-                uint32_t two_chunk_size = chunk_size << 1;
-                uint32_t q = results_count / two_chunk_size;
-                uint32_t r = results_count % two_chunk_size;
-                for (uint32_t i = 0; i < q; ++i ) {
-                    auto offset_1 = i * two_chunk_size;
-                    auto length_1 = chunk_size;
-                    auto length_2 = chunk_size;
-                    auto buffer = result_buffer.get() + (offset_1 >> 1);
-
-                    thread_pool_.enqueueTask([this, results, offset_1, length_1, length_2, buffer] {
-                        _merge(results, buffer, offset_1, length_1, length_2);
-                    });
-                }
+    SearchScope search_scope(this);
 
-                if ( r > chunk_size ) {
-                    auto offset_1 = q * two_chunk_size;
-                    auto length_1 = chunk_size;
-                    auto length_2 = r - chunk_size;
-                    auto buffer = result_buffer.get() + (offset_1 >> 1);
+    auto results = scratch_pool_.get<MatchResult>(ScratchPool::Results, source_size);
+    MatchSpan* spans = span_count_ > 0 ? scratch_pool_.get<MatchSpan>(ScratchPool::Spans, source_size) : nullptr;
+    match_count = _match(source, offsets, pattern, preference, signatures, results, spans, cancel);
 
-                    thread_pool_.enqueueTask([this, results, offset_1, length_1, length_2, buffer] {
-                        _merge(results, buffer, offset_1, length_1, length_2);
-                    });
-                }
+    // only the top results are sorted
+    auto count = std::min(top_count, match_count);
+    std::partial_sort(results, results + count, results + match_count,
+                      [](const MatchResult& a, const MatchResult& b) {
+                          return a.weight > b.weight || (a.weight == b.weight && a.index < b.index);
+                      });
+    if ( spans != nullptr ) {
+        _recordSpans(source, offsets, results, count, spans);
+    }
+    memcpy(top, results, sizeof(MatchResult) * count);
+    return count;
+}
 
-                chunk_size <<= 1;
+/**
+ * The spans are kept until the pattern changes, as the results of a pattern are
+ * usually searched for chunk by chunk and merged.
+ */
+void FuzzyEngine::_recordSpans(const SpanList<StrType>& source,
+                               const std::vector<uint32_t>& offsets,
+                               const MatchResult* results,
+                               uint32_t results_count,
+                               const MatchSpan* spans)
+{
+    auto count = std::min(span_count_, results_count);
 
-                // blocks until all tasks are done
-                thread_pool_.join();
-            }
-        }
+    std::lock_guard<std::mutex> lock(span_mutex_);
+    if ( span_pattern_ != pattern_ || spans_.size() + count > (span_count_ << 4) ) {
+        span_pattern_ = pattern_;
+        spans_.clear();
     }
 
-    Result r{ WeightContainer(results_count), StrContainer(results_count) };
-    auto& weight_list = std::get<0>(r);
-    auto& str_list = std::get<1>(r);
-    if ( cpu_count_ == 1 || results_count < 50000 ) {
-        for (uint32_t i = 0; i < results_count; ++i ) {
-            weight_list[i] = results[i].weight;
-            str_list[i] = *(source_begin + results[i].index);
-        }
+    for ( uint32_t i = 0; i < count; ++i ) {
+        auto index = results[i].index;
+        auto k = std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+        spans_[source[k].data[index - offsets[k]].str] = spans[index];
     }
-    else
-    {
-        chunk_size = (results_count + max_task_count - 1) / max_task_count;
-        if ( chunk_size < 4096 ) {
-            chunk_size = std::max(4096u, (source_size + cpu_count_ - 1) / cpu_count_);
-        }
-        for ( uint32_t offset = 0; offset < results_count; offset += chunk_size ) {
-            uint32_t length = std::min(chunk_size, results_count - offset);
+}
 
-            thread_pool_.enqueueTask([&source_begin, &weight_list, &str_list, results, offset, length] {
-                for ( auto i = offset; i < offset + length; ++i ) {
-                    weight_list[i] = results[i].weight;
-                    str_list[i] = *(source_begin + results[i].index);
-                }
-            });
+/**
+ * Splits a Result into pieces that are contiguous in both containers.
+ */
+std::vector<FuzzyEngine::ResultPiece> FuzzyEngine::_pieces(const Result& r)
+{
+    std::vector<ResultPiece> res;
+    auto weight_spans = std::get<0>(r).spans();
+    auto str_spans = std::get<1>(r).spans();
+    size_t m = 0;
+    size_t n = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while ( m < weight_spans.size() && n < str_spans.size() ) {
+        auto len = std::min(weight_spans[m].size - i, str_spans[n].size - j);
+        res.push_back({ weight_spans[m].data + i, str_spans[n].data + j, len });
+        i += len;
+        j += len;
+        if ( i == weight_spans[m].size ) {
+            ++m;
+            i = 0;
+        }
+        if ( j == str_spans[n].size ) {
+            ++n;
+            j = 0;
         }
-        thread_pool_.join();
     }
 
-    return r;
+    return res;
 }
 
 Result FuzzyEngine::merge(const Result& a, const Result& b)
 {
-    const auto& weights_a = std::get<0>(a);
-    auto size_a = weights_a.size();
+    auto size_a = std::get<0>(a).size();
     if ( size_a == 0 ) {
         return b;
     }
-    const auto& weights_b = std::get<0>(b);
-    auto size_b = weights_b.size();
+    auto size_b = std::get<0>(b).size();
     if ( size_b == 0 ) {
         return a;
     }
 
+    // the new containers are not wrapped around, so they can be written as raw arrays
     Result result{ WeightContainer(size_a + size_b), StrContainer(size_a + size_b) };
-    auto& weight_list = std::get<0>(result);
-    auto& str_list = std::get<1>(result);
-
-    decltype(size_a) i = 0;
-    decltype(size_b) j = 0;
-
-    const auto& weights_a_iter = weights_a.begin();
-    const auto& weights_b_iter = weights_b.begin();
-    const auto& str_list_a_iter = std::get<1>(a).begin();
-    const auto& str_list_b_iter = std::get<1>(b).begin();
-    while ( i < size_a && j < size_b ) {
-        if ( *(weights_a_iter + i) > *(weights_b_iter + j) ) {
-            weight_list[i + j] = *(weights_a_iter + i);
-            str_list[i + j] = *(str_list_a_iter + i);
-            ++i;
+    auto weight_list = std::get<0>(result).buffer();
+    auto str_list = std::get<1>(result).buffer();
+
+    auto pieces_a = _pieces(a);
+    auto pieces_b = _pieces(b);
+    size_t m = 0;
+    size_t n = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    while ( m < pieces_a.size() && n < pieces_b.size() ) {
+        const auto& x = pieces_a[m];
+        const auto& y = pieces_b[n];
+        while ( i < x.size && j < y.size ) {
+            if ( x.weights[i] > y.weights[j] ) {
+                weight_list[k] = x.weights[i];
+                str_list[k] = x.strs[i];
+                ++i;
+            }
+            else {
+                weight_list[k] = y.weights[j];
+                str_list[k] = y.strs[j];
+                ++j;
+            }
+            ++k;
         }
-        else {
-            weight_list[i + j] = *(weights_b_iter + j);
-            str_list[i + j] = *(str_list_b_iter + j);
-            ++j;
+
+        if ( i == x.size ) {
+            ++m;
+            i = 0;
+        }
+        if ( j == y.size ) {
+            ++n;
+            j = 0;
         }
     }
 
-    if ( i < size_a ) {
-        // move tail_ pointer back
-        weight_list.pop_back(size_a - i);
-        weight_list.push_back(weights_a_iter + i, weights_a.cend());
-        // move tail_ pointer back
-        str_list.pop_back(size_a - i);
-        str_list.push_back(str_list_a_iter + i, str_list_a_iter + size_a);
+    // copy the rest
+    auto copy = [weight_list, str_list, &k](const std::vector<ResultPiece>& pieces,
+                                            size_t first, size_t offset) {
+        for ( auto p = first; p < pieces.size(); ++p, offset = 0 ) {
+            auto len = pieces[p].size - offset;
+            memcpy(weight_list + k, pieces[p].weights + offset, sizeof(weight_t) * len);
+            memcpy(str_list + k, pieces[p].strs + offset, sizeof(StrType) * len);
+            k += len;
+        }
+    };
+    copy(pieces_a, m, i);
+    copy(pieces_b, n, j);
+
+    return result;
+}
+
+void FuzzyEngine::sort(MatchResult* results, uint32_t results_count, SortMethod sort_method)
+{
+    if ( results_count < 2 ) {
+        return;
     }
 
-    if ( j < size_b ) {
-        // move tail_ pointer back
-        weight_list.pop_back(size_b - j);
-        weight_list.push_back(weights_b.cbegin() + j, weights_b.cend());
-        // move tail_ pointer back
-        str_list.pop_back(size_b - j);
-        str_list.push_back(str_list_b_iter + j, str_list_b_iter + size_b);
+    if ( thread_pool_.size() == 0 ) {
+        thread_pool_.start(cpu_count_);
     }
 
-    return result;
+    if ( sort_method == SortMethod::Radix ) {
+        _radixSort(results, results_count);
+    }
+    else {
+        _mergeSort(results, results_count);
+    }
 }
 
-std::vector<Unique_ptr<HighlightContext>>
-FuzzyEngine::getHighlights(const StrContainer::const_iterator& source_begin,
-                           uint32_t source_size,
-                           const std::string& pattern,
-                           DigestFn get_digest)
+void FuzzyEngine::_mergeSort(MatchResult* results, uint32_t results_count)
 {
-    std::vector<Unique_ptr<HighlightContext>> res;
+    if ( cpu_count_ == 1 || results_count < 50000 ) {
+        std::sort(results, results + results_count,
+                  [](const MatchResult& a, const MatchResult& b) {
+                      return a.weight > b.weight;
+                  });
+        return;
+    }
+
+    uint32_t max_task_count  = MAX_TASK_COUNT(cpu_count_);
+    uint32_t chunk_size = (results_count + max_task_count - 1) / max_task_count;
+    if ( chunk_size < 4096 ) {
+        chunk_size = std::max(4096u, (results_count + cpu_count_ - 1) / cpu_count_);
+    }
+    for ( uint32_t offset = 0; offset < results_count; offset += chunk_size ) {
+        uint32_t length = std::min(chunk_size, results_count - offset);
+
+        thread_pool_.enqueueTask([results, offset, length] {
+            std::sort(results + offset, results + (offset + length),
+                      [](const MatchResult& a, const MatchResult& b) {
+                          return a.weight > b.weight;
+                      });
+        });
+    }
+
+    // blocks until all tasks are done
+    thread_pool_.join();
+
+    auto task_count = (results_count + chunk_size - 1) / chunk_size;
+    auto result_buffer = scratch_pool_.get<MatchResult>(ScratchPool::MergeBuffer,
+                                                        chunk_size * (task_count >> 1));
+    while ( chunk_size < results_count ) {
+        uint32_t two_chunk_size = chunk_size << 1;
+        uint32_t q = results_count / two_chunk_size;
+        uint32_t r = results_count % two_chunk_size;
+        for (uint32_t i = 0; i < q; ++i ) {
+            auto offset_1 = i * two_chunk_size;
+            auto length_1 = chunk_size;
+            auto length_2 = chunk_size;
+            auto buffer = result_buffer + (offset_1 >> 1);
+
+            thread_pool_.enqueueTask([this, results, offset_1, length_1, length_2, buffer] {
+                _merge(results, buffer, offset_1, length_1, length_2);
+            });
+        }
+
+        if ( r > chunk_size ) {
+            auto offset_1 = q * two_chunk_size;
+            auto length_1 = chunk_size;
+            auto length_2 = r - chunk_size;
+            auto buffer = result_buffer + (offset_1 >> 1);
+
+            thread_pool_.enqueueTask([this, results, offset_1, length_1, length_2, buffer] {
+                _merge(results, buffer, offset_1, length_1, length_2);
+            });
+        }
+
+        chunk_size <<= 1;
+
+        // blocks until all tasks are done
+        thread_pool_.join();
+    }
+}
+
+/**
+ * LSD radix sort on the key `(~weight << 32) | index`, sorting the key in ascending
+ * order is the same as sorting weight in descending order and index in ascending order.
+ *
+ * The results are compacted in the order of index before sorting, and every pass is
+ * stable, so only the 4 bytes of weight need to be sorted. A pass is skipped if all
+ * keys have the same byte, e.g., the highest byte of weight is usually the same.
+ */
+void FuzzyEngine::_radixSort(MatchResult* results, uint32_t results_count)
+{
+    constexpr uint32_t radix = 256;
+
+    uint32_t task_count = cpu_count_;
+    if ( cpu_count_ == 1 || results_count < 50000 ) {
+        task_count = 1;
+    }
+    uint32_t chunk_size = (results_count + task_count - 1) / task_count;
+    task_count = (results_count + chunk_size - 1) / chunk_size;
+
+    // run tasks in thread pool, or in current thread if there is only one task
+    auto run = [this, task_count](const std::function<void(uint32_t)>& task) {
+        if ( task_count == 1 ) {
+            task(0);
+            return;
+        }
+        for ( uint32_t t = 0; t < task_count; ++t ) {
+            thread_pool_.enqueueTask([&task, t] { task(t); });
+        }
+        // blocks until all tasks are done
+        thread_pool_.join();
+    };
+
+    auto src = scratch_pool_.get<uint64_t>(ScratchPool::RadixKeys, results_count);
+    auto dst = scratch_pool_.get<uint64_t>(ScratchPool::RadixBuffer, results_count);
+
+    run([results, results_count, chunk_size, src](uint32_t t) {
+        auto last = std::min(results_count, (t + 1) * chunk_size);
+        for ( auto i = t * chunk_size; i < last; ++i ) {
+            uint32_t w = ~(static_cast<uint32_t>(results[i].weight) ^ 0x80000000u);
+            src[i] = (static_cast<uint64_t>(w) << 32) | results[i].index;
+        }
+    });
+
+    std::unique_ptr<uint32_t[]> counts(new uint32_t[task_count * radix]);
+    for ( uint32_t shift = 32; shift < 64; shift += 8 ) {
+        memset(counts.get(), 0, sizeof(uint32_t) * task_count * radix);
+        run([results_count, chunk_size, src, shift, &counts](uint32_t t) {
+            auto count = counts.get() + t * radix;
+            auto last = std::min(results_count, (t + 1) * chunk_size);
+            for ( auto i = t * chunk_size; i < last; ++i ) {
+                ++count[(src[i] >> shift) & (radix - 1)];
+            }
+        });
+
+        // convert counts to offsets, buckets of task t follow the same buckets of task t-1
+        bool skip = false;
+        uint32_t offset = 0;
+        for ( uint32_t b = 0; b < radix; ++b ) {
+            uint32_t bucket_size = 0;
+            for ( uint32_t t = 0; t < task_count; ++t ) {
+                auto count = counts[t * radix + b];
+                counts[t * radix + b] = offset;
+                offset += count;
+                bucket_size += count;
+            }
+            if ( bucket_size == results_count ) {
+                skip = true;
+                break;
+            }
+        }
+
+        if ( skip ) {
+            continue;
+        }
 
+        run([results_count, chunk_size, src, dst, shift, &counts](uint32_t t) {
+            auto offsets = counts.get() + t * radix;
+            auto last = std::min(results_count, (t + 1) * chunk_size);
+            for ( auto i = t * chunk_size; i < last; ++i ) {
+                dst[offsets[(src[i] >> shift) & (radix - 1)]++] = src[i];
+            }
+        });
+
+        std::swap(src, dst);
+    }
+
+    run([results, results_count, chunk_size, src](uint32_t t) {
+        auto last = std::min(results_count, (t + 1) * chunk_size);
+        for ( auto i = t * chunk_size; i < last; ++i ) {
+            results[i].weight = static_cast<weight_t>(~static_cast<uint32_t>(src[i] >> 32) ^ 0x80000000u);
+            results[i].index = static_cast<uint32_t>(src[i]);
+        }
+    });
+}
+
+HighlightList FuzzyEngine::getHighlights(const StrContainer::const_iterator& source_begin,
+                                        uint32_t source_size,
+                                        const std::string& pattern,
+                                        DigestFn get_digest)
+{
     if ( source_begin == nullptr || source_size == 0 ) {
+        return HighlightList();
+    }
+
+    std::vector<StrType> strs;
+    strs.reserve(source_size);
+    for ( const auto& span : StrContainer::spans(source_begin, source_begin + source_size) ) {
+        strs.insert(strs.end(), span.data, span.data + span.size);
+    }
+    return getHighlights(strs.data(), source_size, pattern);
+}
+
+FuzzyEngine::HighlightPatternPtr FuzzyEngine::_highlightPattern(const std::string& pattern) {
+    if ( !highlight_pattern_ || highlight_pattern_->pattern != pattern ) {
+        highlight_pattern_ = std::make_shared<HighlightPattern>();
+        highlight_pattern_->pattern = pattern;
+        highlight_pattern_->ctxt.reset(initPattern(highlight_pattern_->pattern.c_str(),
+                                                   highlight_pattern_->pattern.length()));
+    }
+
+    if ( highlight_pool_.size() == 0 ) {
+        highlight_pool_.start(std::min(cpu_count_, 4u));
+    }
+
+    return highlight_pattern_;
+}
+
+/**
+ * The tasks are counted in group, owner keeps strs, highlights and group alive until
+ * the tasks have run. The rows already highlighted, e.g., from their spans, are skipped.
+ */
+void FuzzyEngine::_highlight(const HighlightPatternPtr& pattern, const StrType* strs,
+                             Unique_ptr<HighlightContext>* highlights, uint32_t size,
+                             TaskGroup& group, std::shared_ptr<void> owner)
+{
+    uint32_t thread_count = highlight_pool_.size();
+    uint32_t chunk_size = std::max((size + thread_count - 1) / thread_count, 8u);
+    for ( uint32_t offset = 0; offset < size; offset += chunk_size ) {
+        auto length = std::min(chunk_size, size - offset);
+        group.add();
+        highlight_pool_.enqueueTask([this, pattern, strs, highlights, offset, length, &group, owner] {
+            for ( auto i = offset; i < offset + length; ++i ) {
+                if ( !highlights[i] ) {
+                    highlights[i] = FuzzyMatch::getHighlights(strs[i].str, strs[i].len, pattern->ctxt.get());
+                }
+            }
+            group.done();
+        });
+    }
+}
+
+// a row matched contiguously is highlighted from its span, the others are left null
+void FuzzyEngine::_highlightFromSpans(const std::string& pattern, const StrType* strs,
+                                      Unique_ptr<HighlightContext>* highlights, uint32_t size)
+{
+    if ( pattern.length() >= 64 ) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(span_mutex_);
+    if ( spans_.empty() || span_pattern_ != pattern ) {
+        return;
+    }
+
+    auto& pool = HighlightPool::getInstance();
+    for ( uint32_t i = 0; i < size; ++i ) {
+        auto iter = spans_.find(strs[i].str);
+        if ( iter == spans_.end()
+             || static_cast<size_t>(iter->second.end - iter->second.beg) != pattern.length() ) {
+            continue;
+        }
+
+        auto p = pool.alloc();
+        if ( p == nullptr ) {
+            return;
+        }
+        p->beg = iter->second.beg;
+        p->end = iter->second.end;
+        p->positions[0].col = p->beg;
+        p->positions[0].len = p->end - p->beg;
+        p->end_index = 1;
+        highlights[i].reset(p);
+    }
+}
+
+HighlightList FuzzyEngine::getHighlights(const StrType* strs, uint32_t size, const std::string& pattern) {
+    HighlightList res;
+    if ( strs == nullptr || size == 0 ) {
         return res;
     }
 
-    PatternContextPtr pattern_ctxt(initPattern(pattern.c_str(), pattern.length()));
-    res.reserve(source_size);
-    auto end = source_begin + source_size;
-    for ( auto iter = source_begin; iter != end; ++iter ) {
-        res.emplace_back(FuzzyMatch::getHighlights(iter->str, iter->len, pattern_ctxt.get()));
+    auto pattern_ptr = _highlightPattern(pattern);
+    res.resize(size);
+
+    // the leading rows that have been prefetched are copied
+    uint32_t count = 0;
+    if ( prefetched_ && prefetched_->pattern == pattern_ptr ) {
+        const auto& page = prefetched_->strs;
+        auto equal = [](const StrType& a, const StrType& b) {
+            return a.str == b.str && a.len == b.len;
+        };
+        uint32_t first = std::find_if(page.begin(), page.end(), [&strs, &equal](const StrType& s) {
+                             return equal(s, strs[0]);
+                         }) - page.begin();
+        while ( first + count < page.size() && count < size && equal(page[first + count], strs[count]) ) {
+            ++count;
+        }
+
+        if ( count > 0 ) {
+            // wait for the prefetch of the page only
+            prefetched_->tasks.wait();
+            auto& pool = HighlightPool::getInstance();
+            for ( uint32_t i = 0; i < count; ++i ) {
+                const auto& p = prefetched_->highlights[first + i];
+                if ( p ) {
+                    res[i].reset(pool.alloc());
+                    memcpy(res[i].get(), p.get(), sizeof(HighlightContext));
+                }
+            }
+        }
+    }
+
+    if ( count < size ) {
+        _highlightFromSpans(pattern, strs + count, res.data() + count, size - count);
+        TaskGroup tasks;
+        _highlight(pattern_ptr, strs + count, res.data() + count, size - count, tasks);
+        tasks.wait();
     }
 
     return res;
 }
 
+void FuzzyEngine::prefetchHighlights(std::vector<StrType>&& strs, const std::string& pattern) {
+    if ( strs.empty() ) {
+        return;
+    }
+
+    auto pattern_ptr = _highlightPattern(pattern);
+    if ( prefetched_ && prefetched_->pattern == pattern_ptr
+         && std::any_of(prefetched_->strs.begin(), prefetched_->strs.end(), [&strs](const StrType& s) {
+                return s.str == strs[0].str && s.len == strs[0].len;
+            }) ) {
+        return;
+    }
+
+    // the previous page is kept alive by its tasks that have not run yet
+    auto page = std::make_shared<HighlightPage>();
+    page->pattern = pattern_ptr;
+    page->strs = std::move(strs);
+    page->highlights.resize(page->strs.size());
+    _highlightFromSpans(pattern, page->strs.data(), page->highlights.data(), page->strs.size());
+    _highlight(pattern_ptr, page->strs.data(), page->highlights.data(), page->strs.size(), page->tasks, page);
+    prefetched_ = std::move(page);
+}
+
+void FuzzyEngine::releaseStrings() {
+    // a prefetch may still be reading them
+    highlight_pool_.join();
+    prefetched_.reset();
+
+    std::lock_guard<std::mutex> lock(span_mutex_);
+    spans_.clear();
+}
+
 void FuzzyEngine::_merge(MatchResult* results,
                          MatchResult* buffer,
                          uint32_t offset_1,
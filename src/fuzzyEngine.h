@@ -5,10 +5,15 @@ _Pragma("once");
 #include <algorithm>
 #include <functional>
 #include <vector>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 #include "constString.h"
 #include "fuzzyMatch.h"
 #include "threadPool.h"
 #include "ringBuffer.h"
+#include "span.h"
+#include "scratchBuffer.h"
 
 namespace leaf
 {
@@ -19,6 +24,8 @@ using StrContainer = RingBuffer<StrType>;
 using WeightContainer = RingBuffer<weight_t>;
 using Result = std::tuple<WeightContainer, StrContainer>;
 using DigestFn = std::function<StrType(const StrType&)>;
+using BonusFn = std::function<weight_t(const StrType&)>;
+using HighlightList = std::vector<Unique_ptr<HighlightContext>>;
 
 struct MatchResult
 {
@@ -26,38 +33,191 @@ struct MatchResult
     uint32_t index;
 };
 
+struct SearchStatistics
+{
+    uint64_t search_count{ 0 };
+    uint64_t minor_faults{ 0 };
+    uint64_t major_faults{ 0 };
+    uint64_t max_faults{ 0 };  // the most page faults of a single search
+};
+
 
 class FuzzyEngine : private FuzzyMatch
 {
 public:
-    explicit FuzzyEngine(uint32_t cpus): cpu_count_(cpus) {}
+    /**
+     * huge_page: back the scratch buffers of the search with transparent huge pages
+     * and pre-fault them.
+     */
+    explicit FuzzyEngine(uint32_t cpus, bool huge_page=false)
+        : cpu_count_(cpus), scratch_pool_(huge_page) {}
 
     Result fuzzyMatch(const StrContainer::const_iterator& source_begin,
                       uint32_t source_size,
                       const std::string& pattern,
                       Preference preference=Preference::Begin,
                       DigestFn get_digest=DigestFn(),
-                      bool sort_results=true);
+                      bool sort_results=true,
+                      SortMethod sort_method=SortMethod::Merge);
 
-    Result merge(const Result& a, const Result& b);
+    /**
+     * source is a list of contiguous ranges, e.g., the blocks of a SegmentedArray,
+     * the index of an element is its position in the concatenation of all spans.
+     * signatures[index] is FuzzyMatch::getSignature() of the element if it is not
+     * nullptr, the elements without the characters of pattern are not matched.
+     */
+    Result fuzzyMatch(const SpanList<StrType>& source,
+                      const std::string& pattern,
+                      Preference preference=Preference::Begin,
+                      DigestFn get_digest=DigestFn(),
+                      bool sort_results=true,
+                      SortMethod sort_method=SortMethod::Merge,
+                      const uint64_t* signatures=nullptr);
 
-    std::vector<Unique_ptr<HighlightContext>>
-        getHighlights(const StrContainer::const_iterator& source_begin,
-                      uint32_t source_size,
+    /**
+     * Writes the top_count best results of source to top, sorted by weight in descending
+     * order, the results with equal weights by index. Returns the number of them, and
+     * match_count is set to the number of all the results. The match spans of the top
+     * results are kept as by fuzzyMatch(), see setSpanCount().
+     * The search stops early and returns 0 once *cancel is true, cancel can be set by
+     * any thread.
+     */
+    uint32_t topMatch(const SpanList<StrType>& source,
                       const std::string& pattern,
-                      DigestFn get_digest=DigestFn());
+                      Preference preference,
+                      MatchResult* top,
+                      uint32_t top_count,
+                      uint32_t& match_count,
+                      const std::atomic<bool>* cancel=nullptr,
+                      const uint64_t* signatures=nullptr);
+
+    Result merge(const Result& a, const Result& b);
+
+    /**
+     * Keeps the match spans of the count top-ranked results of each search, so that
+     * getHighlights() can highlight a row matched contiguously from its span instead
+     * of matching it again. 0 disables it.
+     */
+    void setSpanCount(uint32_t count) noexcept {
+        span_count_ = count;
+    }
+
+    /**
+     * bonus(str) is added to the weight of each element matched, e.g., to rank the
+     * lines read more times higher. It is called by the threads of the search at once.
+     */
+    void setBonus(BonusFn bonus) {
+        bonus_ = std::move(bonus);
+    }
+
+    /**
+     * Sorts results by weight in descending order.
+     * SortMethod::Radix is stable, results with equal weights keep the order of index.
+     */
+    void sort(MatchResult* results, uint32_t results_count, SortMethod sort_method);
+
+    HighlightList getHighlights(const StrContainer::const_iterator& source_begin,
+                                uint32_t source_size,
+                                const std::string& pattern,
+                                DigestFn get_digest=DigestFn());
+
+    /**
+     * The rows are highlighted in parallel, the rows already prefetched by
+     * prefetchHighlights() are not highlighted again.
+     * getHighlights() and prefetchHighlights() should be called in the same thread.
+     */
+    HighlightList getHighlights(const StrType* strs, uint32_t size, const std::string& pattern);
+
+    /**
+     * Highlights strs in the background, e.g., the page below the one displayed.
+     * Does nothing if strs[0] has been prefetched with the same pattern.
+     */
+    void prefetchHighlights(std::vector<StrType>&& strs, const std::string& pattern);
+
+    /**
+     * Forgets the match spans and the prefetched highlights, the strings they refer to
+     * are about to be freed, e.g., evicted by --max-lines.
+     * Should be called in the thread calling getHighlights().
+     */
+    void releaseStrings();
+
+    /**
+     * Page faults are counted for the whole process during fuzzyMatch(),
+     * including the faults of other threads.
+     */
+    const SearchStatistics& getStatistics() const noexcept {
+        return statistics_;
+    }
 private:
+    struct ResultPiece
+    {
+        const weight_t* weights;
+        const StrType*  strs;
+        size_t          size;
+    };
+
+    using PatternContextPtr = std::unique_ptr<PatternContext>;
+
+    struct SearchScope;
+
+    struct HighlightPattern
+    {
+        std::string       pattern;
+        PatternContextPtr ctxt;     // refers to pattern
+    };
+    using HighlightPatternPtr = std::shared_ptr<HighlightPattern>;
+
+    struct HighlightPage
+    {
+        HighlightPatternPtr  pattern;
+        std::vector<StrType> strs;
+        HighlightList        highlights;
+        TaskGroup            tasks;     // highlighting the page
+    };
+
+    static std::vector<ResultPiece> _pieces(const Result& r);
+    uint32_t _match(const SpanList<StrType>& source,
+                    const std::vector<uint32_t>& offsets,
+                    const std::string& pattern,
+                    Preference preference,
+                    const uint64_t* signatures,
+                    MatchResult* results,
+                    MatchSpan* spans,
+                    const std::atomic<bool>* cancel=nullptr);
+    void _recordSpans(const SpanList<StrType>& source,
+                      const std::vector<uint32_t>& offsets,
+                      const MatchResult* results,
+                      uint32_t results_count,
+                      const MatchSpan* spans);
+    void _highlightFromSpans(const std::string& pattern, const StrType* strs,
+                             Unique_ptr<HighlightContext>* highlights, uint32_t size);
+    HighlightPatternPtr _highlightPattern(const std::string& pattern);
+    void _highlight(const HighlightPatternPtr& pattern, const StrType* strs,
+                    Unique_ptr<HighlightContext>* highlights, uint32_t size,
+                    TaskGroup& group, std::shared_ptr<void> owner=nullptr);
+    void _mergeSort(MatchResult* results, uint32_t results_count);
+    void _radixSort(MatchResult* results, uint32_t results_count);
     void _merge(MatchResult* results,
                 MatchResult* buffer,
                 uint32_t offset_1,
                 uint32_t length_1,
                 uint32_t length_2);
 private:
-    using PatternContextPtr = std::unique_ptr<PatternContext>;
     uint32_t          cpu_count_;
     ThreadPool        thread_pool_;
     std::string       pattern_;
     PatternContextPtr pattern_ctxt_;
+    ScratchPool       scratch_pool_;
+    SearchStatistics  statistics_;
+    // a search joins thread_pool_, the UI thread must not wait for it
+    ThreadPool          highlight_pool_;
+    HighlightPatternPtr highlight_pattern_;
+    std::shared_ptr<HighlightPage> prefetched_;
+    uint32_t          span_count_{ 0 };
+    BonusFn           bonus_;
+    std::mutex        span_mutex_;  // guards span_pattern_ and spans_
+    std::string       span_pattern_;
+    std::unordered_map<const char*, MatchSpan> spans_;
 
 };
 
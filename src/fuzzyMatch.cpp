@@ -406,7 +406,8 @@ static ValueElements* evaluate(TextContext* p_text_ctxt,
 int32_t FuzzyMatch::getWeight(const char* p_text,
                               uint16_t text_len,
                               PatternContext* p_pattern_ctxt,
-                              Preference preference)
+                              Preference preference,
+                              MatchSpan* p_span)
 {
     if ( !p_text || !p_pattern_ctxt )
         return MIN_WEIGHT;
@@ -437,8 +438,13 @@ int32_t FuzzyMatch::getWeight(const char* p_text,
             }
             if ( first_char_pos == -1 )
                 return MIN_WEIGHT;
-            else
+            else {
+                if ( p_span ) {
+                    p_span->beg = first_char_pos;
+                    p_span->end = first_char_pos + 1;
+                }
                 return 10000/(first_char_pos + 1) + 10000/text_len;
+            }
         }
         else {
             int16_t first_char_pos = -1;
@@ -447,14 +453,24 @@ int32_t FuzzyMatch::getWeight(const char* p_text,
                     if ( first_char_pos == -1 )
                         first_char_pos = i;
 
-                    if ( isupper(text[i]) || i == 0 || !isalnum(text[i-1]) )
+                    if ( isupper(text[i]) || i == 0 || !isalnum(text[i-1]) ) {
+                        if ( p_span ) {
+                            p_span->beg = i;
+                            p_span->end = i + 1;
+                        }
                         return 2 + 10000/(i + 1) + 10000/text_len;
+                    }
                 }
             }
             if ( first_char_pos == -1 )
                 return MIN_WEIGHT;
-            else
+            else {
+                if ( p_span ) {
+                    p_span->beg = first_char_pos;
+                    p_span->end = first_char_pos + 1;
+                }
                 return 10000/(first_char_pos + 1) + 10000/text_len;
+            }
         }
     }
 
@@ -627,6 +643,11 @@ int32_t FuzzyMatch::getWeight(const char* p_text,
         free(text_mask);
     }
 
+    if ( p_span ) {
+        p_span->beg = beg;
+        p_span->end = end;
+    }
+
     if ( preference == Preference::Begin ) {
         return score + 10000/text_len + 20000 * pattern_len/(beg + end);
     }
@@ -636,6 +657,45 @@ int32_t FuzzyMatch::getWeight(const char* p_text,
 }
 
 
+HighlightPool::~HighlightPool() {
+    for ( auto p : free_list_ ) {
+        free(p);
+    }
+}
+
+HighlightContext* HighlightPool::alloc() {
+    HighlightContext* p = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ( !free_list_.empty() ) {
+            p = free_list_.back();
+            free_list_.pop_back();
+        }
+    }
+
+    if ( p == nullptr ) {
+        return static_cast<HighlightContext*>(calloc(1, sizeof(HighlightContext)));
+    }
+
+    memset(p, 0, sizeof(HighlightContext));
+    return p;
+}
+
+void HighlightPool::release(HighlightContext* p) {
+    if ( p == nullptr ) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ( free_list_.size() < MaxFreeCount ) {
+            free_list_.push_back(p);
+            return;
+        }
+    }
+    free(p);
+}
+
 static HighlightContext* evaluateHighlights(TextContext* p_text_ctxt,
                                             PatternContext* p_pattern_ctxt,
                                             uint16_t k,
@@ -676,7 +736,7 @@ static HighlightContext* evaluateHighlights(TextContext* p_text_ctxt,
     int32_t max_score = MIN_WEIGHT;
 
     if ( !groups[k] ) {
-        groups[k] = static_cast<HighlightContext*>(calloc(1, sizeof(HighlightContext)));
+        groups[k] = HighlightPool::getInstance().alloc();
         if ( !groups[k] ) {
             fprintf(stderr, "Out of memory in evaluateHighlights()!\n");
             return nullptr;
@@ -900,7 +960,7 @@ Unique_ptr<HighlightContext> FuzzyMatch::getHighlights(const char* p_text,
             if ( first_char_pos == -1 )
                 return { nullptr, destroyer };
             else {
-                HighlightContext* p_group = static_cast<HighlightContext*>(malloc(sizeof(HighlightContext)));
+                HighlightContext* p_group = HighlightPool::getInstance().alloc();
                 if ( !p_group ) {
                     fprintf(stderr, "Out of memory in getHighlights()!\n");
                     return { nullptr, destroyer };
@@ -929,7 +989,7 @@ Unique_ptr<HighlightContext> FuzzyMatch::getHighlights(const char* p_text,
             if ( first_char_pos == -1 )
                 return { nullptr, destroyer };
             else {
-                HighlightContext* p_group = static_cast<HighlightContext*>(malloc(sizeof(HighlightContext)));
+                HighlightContext* p_group = HighlightPool::getInstance().alloc();
                 if ( !p_group ) {
                     fprintf(stderr, "Out of memory in getHighlights()!\n");
                     return { nullptr, destroyer };
@@ -1071,7 +1131,7 @@ Unique_ptr<HighlightContext> FuzzyMatch::getHighlights(const char* p_text,
 
     for (uint16_t i = 0; i < pattern_len; ++i ) {
         if ( groups[i] && groups[i] != p_group )
-            free(groups[i]);
+            HighlightPool::getInstance().release(groups[i]);
     }
     free(groups);
 
@@ -1239,4 +1299,40 @@ uint32_t getPathWeight(const char* filename,
 }
 
 
+uint64_t FuzzyMatch::getSignatureBit(uint8_t c)
+{
+    if ( c >= 'a' && c <= 'z' )
+        return 1ULL << (c - 'a');
+    else if ( c >= 'A' && c <= 'Z' )
+        return 1ULL << (c - 'A');
+    else if ( c >= '0' && c <= '9' )
+        return 1ULL << (26 + c - '0');
+    /* tolower() may fold the non-ASCII bytes into each other */
+    else if ( c >= 0x80 )
+        return 1ULL << 36;
+    else
+        return 1ULL << (37 + c % 27);
+}
+
+uint64_t FuzzyMatch::getSignature(const char* text, uint32_t len)
+{
+    static struct SignatureTable
+    {
+        SignatureTable() {
+            for ( uint32_t c = 0; c < 256; ++c ) {
+                bits[c] = getSignatureBit(c);
+            }
+        }
+        uint64_t bits[256];
+    } table;
+
+    uint64_t signature = 0;
+    for ( uint32_t i = 0; i < len; ++i ) {
+        signature |= table.bits[static_cast<uint8_t>(text[i])];
+    }
+
+    return signature;
+}
+
+
 } // end namespace leaf
@@ -2,7 +2,10 @@ _Pragma("once");
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "config.h"
+#include "singleton.h"
 
 namespace leaf
 {
@@ -24,6 +27,13 @@ struct HighlightPos
     uint16_t len;
 };
 
+// the text matched, from the first character to the last one
+struct MatchSpan
+{
+    uint16_t beg;
+    uint16_t end;
+};
+
 struct HighlightContext
 {
     int32_t  score;
@@ -34,12 +44,40 @@ struct HighlightContext
 };
 
 
+/**
+ * A free list of HighlightContext, the contexts of the rows displayed are allocated
+ * and released over and over again while scrolling.
+ * The contexts are allocated by the worker threads and released by the UI thread.
+ */
+class HighlightPool final : public Singleton<HighlightPool>
+{
+    friend Singleton<HighlightPool>;
+public:
+    ~HighlightPool();
+
+    // the context returned is zeroed
+    HighlightContext* alloc();
+    void release(HighlightContext* p);
+
+private:
+    HighlightPool() = default;
+
+private:
+    static constexpr size_t MaxFreeCount = 4096;
+    std::mutex mutex_;
+    std::vector<HighlightContext*> free_list_;
+};
+
 struct Destroyer
 {
     template <typename T>
     void operator()(T* p) {
         free(p);
     }
+
+    void operator()(HighlightContext* p) {
+        HighlightPool::getInstance().release(p);
+    }
 };
 
 template <typename T>
@@ -55,7 +93,8 @@ public:
     int32_t getWeight(const char* text,
                       uint16_t text_len,
                       PatternContext* p_pattern_ctxt,
-                      Preference preference);
+                      Preference preference,
+                      MatchSpan* p_span=nullptr);
 
     Unique_ptr<HighlightContext> getHighlights(const char* text,
                                                uint16_t text_len,
@@ -66,6 +105,16 @@ public:
                            const char* dirname,
                            const char* path, uint32_t path_len);
 
+    /**
+     * A bit for each class of the characters in text, the letters are case-folded.
+     * A text can be matched only if its signature contains the one of the pattern,
+     * i.e., (getSignature(text) & getSignature(pattern)) == getSignature(pattern).
+     */
+    static uint64_t getSignature(const char* text, uint32_t len);
+
+    // the bit of c in a signature
+    static uint64_t getSignatureBit(uint8_t c);
+
 };
 
 } // end namespace leaf
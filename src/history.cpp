@@ -0,0 +1,230 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "history.h"
+#include "utils.h"
+
+namespace leaf
+{
+
+constexpr int64_t History::CompactInterval;
+constexpr int64_t History::MaxAge;
+constexpr char History::Magic[8];
+constexpr uint32_t History::InitialCapacity;
+
+History::~History() {
+    _unmap();
+}
+
+bool History::open(const std::string& file, int64_t now) {
+    file_ = file;
+    now_ = now;
+    if ( !_map() || !_lock() ) {
+        _unmap();
+        return false;
+    }
+
+    if ( now - header_->compacted >= CompactInterval ) {
+        _compact(now, 0);
+    }
+    else {
+        _unlock();
+    }
+    return isOpen();
+}
+
+void History::record(uint64_t hash, int64_t now) {
+    if ( !isOpen() || !_lock() ) {
+        return;
+    }
+
+    if ( (header_->size + 1) * 4 > capacity_ * 3 ) {
+        if ( !_compact(now, capacity_ * 2) || !_lock() ) {
+            return;
+        }
+    }
+
+    // the slots are written by other processes too, the probe is bounded whatever they hold
+    auto key = utils::hashKey(hash);
+    auto mask = capacity_ - 1;
+    auto i = key & mask;
+    for ( uint32_t n = 0; n < capacity_; ++n, i = (i + 1) & mask ) {
+        auto& slot = slots_[i];
+        if ( slot.key == key ) {
+            if ( slot.count < UINT32_MAX ) {
+                ++slot.count;
+            }
+            slot.time = now;
+            break;
+        }
+        else if ( slot.key == 0 ) {
+            slot.count = 1;
+            slot.time = now;
+            slot.key = key;
+            ++header_->size;
+            break;
+        }
+    }
+    _unlock();
+}
+
+uint32_t History::frecency(uint64_t hash) const noexcept {
+    if ( !isOpen() ) {
+        return 0;
+    }
+
+    // the table is at most 3/4 full, an empty slot ends the probe
+    auto key = utils::hashKey(hash);
+    auto mask = capacity_ - 1;
+    auto i = key & mask;
+    for ( uint32_t n = 0; n < capacity_ && slots_[i].key != 0; ++n, i = (i + 1) & mask ) {
+        const auto& slot = slots_[i];
+        if ( slot.key == key ) {
+            auto age = now_ - slot.time;
+            uint32_t factor = age < 3600 ? 8 : age < 24 * 3600 ? 4 : age < 7 * 24 * 3600 ? 2 : 1;
+            return slot.count > UINT32_MAX / factor ? UINT32_MAX : slot.count * factor;
+        }
+    }
+    return 0;
+}
+
+uint32_t History::size() const noexcept {
+    return isOpen() ? header_->size : 0;
+}
+
+// maps file_, which is reset if it is not a history
+bool History::_map() {
+    _unmap();
+    fd_ = ::open(file_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if ( fd_ == -1 ) {
+        return false;
+    }
+
+    // another process may be creating it
+    flock(fd_, LOCK_EX);
+    Header header;
+    struct stat st;
+    if ( fstat(fd_, &st) == -1 ) {
+        _unmap();
+        return false;
+    }
+    if ( pread(fd_, &header, sizeof(header), 0) != sizeof(header)
+         || memcmp(header.magic, Magic, sizeof(Magic)) != 0
+         || header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0
+         || static_cast<size_t>(st.st_size) != _fileSize(header.capacity)
+         || header.size * 4 > header.capacity * 3 ) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, Magic, sizeof(Magic));
+        header.capacity = InitialCapacity;
+        header.compacted = now_;
+        if ( ftruncate(fd_, 0) == -1 || ftruncate(fd_, _fileSize(header.capacity)) == -1
+             || pwrite(fd_, &header, sizeof(header), 0) != sizeof(header) ) {
+            _unmap();
+            return false;
+        }
+    }
+
+    size_ = _fileSize(header.capacity);
+    auto data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    flock(fd_, LOCK_UN);
+    if ( data == MAP_FAILED ) {
+        _unmap();
+        return false;
+    }
+
+    data_ = data;
+    capacity_ = header.capacity;
+    header_ = static_cast<Header*>(data_);
+    slots_ = reinterpret_cast<Slot*>(static_cast<char*>(data_) + sizeof(Header));
+    return true;
+}
+
+void History::_unmap() {
+    if ( data_ != nullptr ) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+    if ( fd_ != -1 ) {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+    capacity_ = 0;
+    header_ = nullptr;
+    slots_ = nullptr;
+}
+
+// locks the file mapped, which is mapped again first if another process has compacted it
+bool History::_lock() {
+    for ( ; ; ) {
+        if ( flock(fd_, LOCK_EX) == -1 ) {
+            return false;
+        }
+
+        struct stat file_st;
+        struct stat fd_st;
+        if ( stat(file_.c_str(), &file_st) == 0 && fstat(fd_, &fd_st) == 0
+             && file_st.st_dev == fd_st.st_dev && file_st.st_ino == fd_st.st_ino ) {
+            return true;
+        }
+
+        if ( !_map() ) {
+            return false;
+        }
+    }
+}
+
+void History::_unlock() {
+    flock(fd_, LOCK_UN);
+}
+
+/**
+ * Called with the file locked, drops the lines not accepted for MaxAge, and writes the
+ * others to a new file of at least min_capacity slots at most half full, which replaces
+ * the file. The new file is mapped unlocked, returns false if it cannot be.
+ */
+bool History::_compact(int64_t now, uint32_t min_capacity) {
+    std::vector<Slot> kept;
+    for ( uint32_t i = 0; i < capacity_; ++i ) {
+        if ( slots_[i].key != 0 && now - slots_[i].time < MaxAge ) {
+            kept.push_back(slots_[i]);
+        }
+    }
+
+    uint32_t capacity = std::max(InitialCapacity, min_capacity);
+    while ( kept.size() * 2 > capacity ) {
+        capacity *= 2;
+    }
+
+    // the processes waiting for the lock find the file replaced and map the new one
+    auto ok = utils::replaceFile(file_, _fileSize(capacity), 0600, [&](char* data) {
+        auto& header = *reinterpret_cast<Header*>(data);
+        memcpy(header.magic, Magic, sizeof(Magic));
+        header.capacity = capacity;
+        header.size = kept.size();
+        header.compacted = now;
+        auto slots = reinterpret_cast<Slot*>(data + sizeof(Header));
+        auto mask = capacity - 1;
+        for ( const auto& slot : kept ) {
+            auto i = slot.key & mask;
+            while ( slots[i].key != 0 ) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    });
+    if ( !ok ) {
+        _unlock();
+        return false;
+    }
+
+    return _map();
+}
+
+} // end namespace leaf
@@ -0,0 +1,102 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace leaf
+{
+
+/**
+ * The lines accepted, with the number of times and the last time each one has been
+ * accepted, kept in an open-addressing table keyed by the 64-bit hash of the line.
+ * The table is a file mapped into memory and shared by the processes using it.
+ * It is at most 3/4 full, and half full after a compaction, so the slots a lookup
+ * probes from the home of the hash are mostly in the same cache line.
+ *
+ * The file is made up of the Header and the slots. It is updated in place under
+ * flock(), and compacted into a new file renamed over it, so that a process still
+ * mapping the old one keeps reading a complete table.
+ */
+class History
+{
+public:
+    static constexpr int64_t CompactInterval = 24 * 3600;  // s
+    static constexpr int64_t MaxAge = 90 * 24 * 3600;      // the lines not accepted since are dropped
+
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    History() = default;
+    ~History();
+
+    /**
+     * Maps file, which is created if it does not exist or is not a history, and compacts
+     * it if it has not been compacted for CompactInterval. now is the time in seconds
+     * the frecency is counted from. Returns false if file cannot be mapped.
+     */
+    bool open(const std::string& file, int64_t now);
+
+    bool isOpen() const noexcept {
+        return slots_ != nullptr;
+    }
+
+    // counts the line of hash accepted at now, the table grows if it is 3/4 full
+    void record(uint64_t hash, int64_t now);
+
+    /**
+     * The times the line of hash has been accepted weighted by how recently, 8 for
+     * each time if it was last accepted in the last hour, 4 in the last day, 2 in the
+     * last week, otherwise 1. Returns 0 if it has never been accepted.
+     * Can be called by several threads at once.
+     */
+    uint32_t frecency(uint64_t hash) const noexcept;
+
+    uint32_t size() const noexcept;
+
+    uint32_t capacity() const noexcept {
+        return capacity_;
+    }
+
+private:
+    struct Header
+    {
+        char     magic[8];
+        uint32_t capacity;      // of the slots, a power of 2
+        uint32_t size;          // the slots used
+        int64_t  compacted;     // the time of the last compaction, s
+        char     reserved[40];  // the slots start at a cache line
+    };
+
+    struct Slot
+    {
+        uint64_t key;       // 0 if the slot is empty
+        uint32_t count;
+        uint32_t time;      // of the last accept, s
+    };
+
+    static constexpr char Magic[8] = { 'L', 'E', 'A', 'F', 'H', 'S', '0', '1' };
+    static constexpr uint32_t InitialCapacity = 1024;
+
+    static size_t _fileSize(uint32_t capacity) noexcept {
+        return sizeof(Header) + sizeof(Slot) * capacity;
+    }
+
+    bool _map();
+    void _unmap();
+    bool _lock();
+    void _unlock();
+    bool _compact(int64_t now, uint32_t min_capacity);
+
+private:
+    std::string file_;
+    int64_t     now_{ 0 };
+    int         fd_{ -1 };
+    void*       data_{ nullptr };
+    size_t      size_{ 0 };
+    uint32_t    capacity_{ 0 };
+    Header*     header_{ nullptr };
+    Slot*       slots_{ nullptr };
+};
+
+} // end namespace leaf
@@ -0,0 +1,341 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstring>
+#include "ignoreRules.h"
+
+namespace leaf
+{
+
+IgnoreRules::IgnoreRules(std::shared_ptr<const IgnoreRules> parent, uint32_t dir_len, std::string prefix)
+    : parent_(std::move(parent)), dir_len_(dir_len), prefix_(std::move(prefix))
+{
+    if ( parent_ ) {
+        stamp_ = parent_->stamp();
+    }
+
+}
+
+bool IgnoreRules::load(int dir_fd, const char* name) {
+    auto fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ) {
+        close(fd);
+        return false;
+    }
+
+    has_files_ = true;
+    stamp_ = (stamp_ * 1000003 + st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec) * 1000003 + st.st_ino;
+
+    std::string data(st.st_size, '\0');
+    size_t len = 0;
+    while ( len < data.length() ) {
+        auto n = read(fd, &data[len], data.length() - len);
+        if ( n <= 0 ) {
+            break;
+        }
+        len += n;
+    }
+    close(fd);
+
+    parse(data.data(), len);
+    return true;
+}
+
+void IgnoreRules::parse(const char* data, uint32_t len) {
+    const char* end = data + len;
+    while ( data < end ) {
+        auto eol = static_cast<const char*>(memchr(data, '\n', end - data));
+        if ( eol == nullptr ) {
+            eol = end;
+        }
+
+        std::string line(data, eol);
+        data = eol + 1;
+
+        if ( !line.empty() && line.back() == '\r' ) {
+            line.pop_back();
+        }
+
+        // the trailing spaces are ignored unless they are escaped
+        auto last = line.find_last_not_of(' ');
+        if ( last == std::string::npos ) {
+            continue;
+        }
+        if ( last + 1 < line.length() && line[last] == '\\' ) {
+            ++last;
+        }
+        line.resize(last + 1);
+
+        if ( line[0] == '#' ) {
+            continue;
+        }
+
+        _compile(std::move(line));
+    }
+}
+
+void IgnoreRules::_compile(std::string&& pattern) {
+    Rule rule;
+    uint32_t start = 0;
+    if ( pattern[0] == '!' ) {
+        rule.negated = true;
+        start = 1;
+    }
+
+    uint32_t end = pattern.length();
+    if ( end > start && pattern[end - 1] == '/' && (end < 2 || pattern[end - 2] != '\\') ) {
+        rule.dir_only = true;
+        --end;
+    }
+
+    if ( start < end && pattern[start] == '/' ) {
+        rule.basename = false;
+        ++start;
+    }
+
+    if ( start >= end ) {
+        return;
+    }
+
+    if ( memchr(pattern.data() + start, '/', end - start) != nullptr ) {
+        rule.basename = false;
+    }
+
+    auto literal = [&rule](char c) {
+        if ( rule.tokens.empty() || rule.tokens.back().type != TokenType::Literal ) {
+            rule.tokens.push_back({ TokenType::Literal, std::string() });
+        }
+        rule.tokens.back().literal.push_back(c);
+    };
+
+    for ( uint32_t i = start; i < end; ++i ) {
+        auto c = pattern[i];
+        if ( c == '\\' ) {
+            if ( i + 1 < end ) {
+                literal(pattern[++i]);
+            }
+        }
+        else if ( c == '*' ) {
+            auto j = i;
+            while ( j < end && pattern[j] == '*' ) {
+                ++j;
+            }
+
+            bool at_begin = i == start || pattern[i - 1] == '/';
+            if ( j - i >= 2 && at_begin && j < end && pattern[j] == '/' ) {
+                rule.tokens.push_back({ TokenType::AnyDirs, std::string() });
+                i = j;      // '/' is consumed too
+            }
+            else if ( j - i >= 2 && at_begin && j == end ) {
+                rule.tokens.push_back({ TokenType::Any, std::string() });
+                i = j - 1;
+            }
+            else {
+                if ( rule.tokens.empty() || rule.tokens.back().type != TokenType::Star ) {
+                    rule.tokens.push_back({ TokenType::Star, std::string() });
+                }
+                i = j - 1;
+            }
+        }
+        else if ( c == '?' ) {
+            rule.tokens.push_back({ TokenType::Question, std::string() });
+        }
+        else if ( c == '[' ) {
+            std::bitset<256> cls;
+            auto j = i + 1;
+            bool negated = false;
+            if ( j < end && (pattern[j] == '!' || pattern[j] == '^') ) {
+                negated = true;
+                ++j;
+            }
+
+            bool closed = false;
+            for ( bool first = true; j < end; first = false ) {
+                auto lo = static_cast<uint8_t>(pattern[j]);
+                if ( lo == ']' && !first ) {
+                    closed = true;
+                    break;
+                }
+                if ( lo == '\\' && j + 1 < end ) {
+                    lo = static_cast<uint8_t>(pattern[++j]);
+                }
+                ++j;
+
+                auto hi = lo;
+                if ( j + 1 < end && pattern[j] == '-' && pattern[j + 1] != ']' ) {
+                    ++j;
+                    if ( pattern[j] == '\\' && j + 1 < end ) {
+                        ++j;
+                    }
+                    hi = static_cast<uint8_t>(pattern[j++]);
+                }
+
+                for ( uint32_t k = lo; k <= hi; ++k ) {
+                    cls.set(k);
+                }
+            }
+
+            if ( !closed ) {
+                // an unmatched '[' is taken literally
+                literal(c);
+                continue;
+            }
+
+            if ( negated ) {
+                cls.flip();
+            }
+            cls.reset('/');
+            rule.tokens.push_back({ TokenType::Class, std::string(), static_cast<uint32_t>(rule.classes.size()) });
+            rule.classes.push_back(cls);
+            i = j;
+        }
+        else {
+            literal(c);
+        }
+    }
+
+    auto& tokens = rule.tokens;
+    if ( tokens.size() == 1 && tokens[0].type == TokenType::Literal ) {
+        rule.kind = RuleKind::Literal;
+        rule.text = std::move(tokens[0].literal);
+    }
+    else if ( rule.basename && tokens.size() == 2
+              && tokens[0].type == TokenType::Star && tokens[1].type == TokenType::Literal ) {
+        rule.kind = RuleKind::Suffix;
+        rule.text = std::move(tokens[1].literal);
+    }
+    else if ( rule.basename && tokens.size() == 2
+              && tokens[0].type == TokenType::Literal && tokens[1].type == TokenType::Star ) {
+        rule.kind = RuleKind::Prefix;
+        rule.text = std::move(tokens[0].literal);
+    }
+
+    if ( rule.kind != RuleKind::Glob ) {
+        tokens.clear();
+    }
+
+    anchored_ = anchored_ || !rule.basename;
+    rules_.push_back(std::move(rule));
+}
+
+bool IgnoreRules::isIgnored(const std::string& dir, const char* name, uint32_t name_len, bool is_dir) const {
+    for ( auto rules = this; rules != nullptr; rules = rules->parent_.get() ) {
+        auto match = rules->_match(dir, name, name_len, is_dir);
+        if ( match != Match::None ) {
+            return match == Match::Ignore;
+        }
+    }
+
+    return false;
+}
+
+IgnoreRules::Match IgnoreRules::_match(const std::string& dir, const char* name, uint32_t name_len, bool is_dir) const {
+    // the path relative to the directory of the rules
+    std::string path;
+    if ( anchored_ ) {
+        path.reserve(prefix_.length() + dir.length() - dir_len_ + name_len);
+        path.append(prefix_).append(dir, dir_len_, std::string::npos).append(name, name_len);
+    }
+
+    for ( auto iter = rules_.rbegin(); iter != rules_.rend(); ++iter ) {
+        const auto& rule = *iter;
+        if ( rule.dir_only && !is_dir ) {
+            continue;
+        }
+
+        bool matched = rule.basename ? _matchRule(rule, name, name_len)
+                                     : _matchRule(rule, path.data(), path.length());
+        if ( matched ) {
+            return rule.negated ? Match::Include : Match::Ignore;
+        }
+    }
+
+    return Match::None;
+}
+
+bool IgnoreRules::_matchRule(const Rule& rule, const char* str, uint32_t len) {
+    const auto& text = rule.text;
+    switch ( rule.kind )
+    {
+    case RuleKind::Literal:
+        return len == text.length() && memcmp(str, text.data(), len) == 0;
+    case RuleKind::Suffix:
+        return len >= text.length() && memcmp(str + len - text.length(), text.data(), text.length()) == 0;
+    case RuleKind::Prefix:
+        return len >= text.length() && memcmp(str, text.data(), text.length()) == 0;
+    default:
+        return _matchTokens(rule, 0, str, 0, len);
+    }
+}
+
+bool IgnoreRules::_matchTokens(const Rule& rule, uint32_t ti, const char* str, uint32_t si, uint32_t len) {
+    const auto& tokens = rule.tokens;
+    for ( ; ti < tokens.size(); ++ti ) {
+        const auto& token = tokens[ti];
+        switch ( token.type )
+        {
+        case TokenType::Literal:
+            if ( len - si < token.literal.length()
+                 || memcmp(str + si, token.literal.data(), token.literal.length()) != 0 ) {
+                return false;
+            }
+            si += token.literal.length();
+            break;
+        case TokenType::Question:
+            if ( si == len || str[si] == '/' ) {
+                return false;
+            }
+            ++si;
+            break;
+        case TokenType::Class:
+            if ( si == len || !rule.classes[token.cls].test(static_cast<uint8_t>(str[si])) ) {
+                return false;
+            }
+            ++si;
+            break;
+        case TokenType::Star:
+            if ( ti + 1 == tokens.size() ) {
+                return memchr(str + si, '/', len - si) == nullptr;
+            }
+            for ( ; ; ++si ) {
+                if ( _matchTokens(rule, ti + 1, str, si, len) ) {
+                    return true;
+                }
+                if ( si == len || str[si] == '/' ) {
+                    return false;
+                }
+            }
+        case TokenType::Any:
+            if ( ti + 1 == tokens.size() ) {
+                return true;
+            }
+            for ( ; si <= len; ++si ) {
+                if ( _matchTokens(rule, ti + 1, str, si, len) ) {
+                    return true;
+                }
+            }
+            return false;
+        case TokenType::AnyDirs:
+            // tries the empty string, then the ends of the directories one by one
+            for ( ; ; ) {
+                if ( _matchTokens(rule, ti + 1, str, si, len) ) {
+                    return true;
+                }
+                auto slash = static_cast<const char*>(memchr(str + si, '/', len - si));
+                if ( slash == nullptr ) {
+                    return false;
+                }
+                si = slash - str + 1;
+            }
+        }
+    }
+
+    return si == len;
+}
+
+} // end namespace leaf
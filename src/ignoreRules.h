@@ -0,0 +1,118 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <bitset>
+#include <memory>
+
+namespace leaf
+{
+
+/**
+ * The patterns of the .gitignore and .ignore files in a directory, compiled once
+ * when the directory is read, see gitignore(5) for the syntax.
+ * The rules of a directory keep a reference to the rules of its parent directory,
+ * so the rules of a subdirectory are the chain up to the root, and the rules of the
+ * deepest directory take precedence.
+ */
+class IgnoreRules
+{
+public:
+    /**
+     * The rules apply to the paths below the directory of dir_len characters, which are
+     * relative to the root of the walk. prefix is prepended to the paths to make them
+     * relative to the directory of the rules, it is not empty only if the directory is
+     * above the root.
+     */
+    IgnoreRules(std::shared_ptr<const IgnoreRules> parent, uint32_t dir_len,
+                std::string prefix=std::string());
+
+    // parses the content of an ignore file, the later patterns take precedence
+    void parse(const char* data, uint32_t len);
+
+    // parses the file name in the directory dir_fd, returns false if it cannot be read
+    bool load(int dir_fd, const char* name);
+
+    bool empty() const noexcept {
+        return rules_.empty();
+    }
+
+    bool hasFiles() const noexcept {
+        return has_files_;
+    }
+
+    /**
+     * Identifies the ignore files loaded by the rules and their parents with their mtimes,
+     * so it changes if any of them is modified, added or removed.
+     */
+    uint64_t stamp() const noexcept {
+        return stamp_;
+    }
+
+    /**
+     * Returns whether the entry name in the directory dir is ignored,
+     * dir is relative to the root of the walk and ends with '/' unless it is the root.
+     */
+    bool isIgnored(const std::string& dir, const char* name, uint32_t name_len, bool is_dir) const;
+
+private:
+    enum class Match
+    {
+        None,
+        Ignore,
+        Include,
+    };
+
+    enum class TokenType : uint8_t
+    {
+        Literal,
+        Question,   // '?'
+        Class,      // '[...]'
+        Star,       // '*', does not match '/'
+        Any,        // the trailing "**", matches everything
+        AnyDirs,    // "**/", matches zero or more directories
+    };
+
+    struct Token
+    {
+        TokenType   type;
+        std::string literal;
+        uint32_t    cls{ 0 };   // the index in Rule::classes
+    };
+
+    enum class RuleKind : uint8_t
+    {
+        Literal,    // e.g., "build"
+        Suffix,     // e.g., "*.o"
+        Prefix,     // e.g., "core.*"
+        Glob,
+    };
+
+    struct Rule
+    {
+        RuleKind kind{ RuleKind::Glob };
+        bool     negated{ false };
+        bool     dir_only{ false };
+        bool     basename{ true };  // the pattern has no '/', matches the name at any depth
+        std::string text;           // the literal of Literal, Suffix and Prefix
+        std::vector<Token> tokens;
+        std::vector<std::bitset<256>> classes;
+    };
+
+    void _compile(std::string&& pattern);
+    Match _match(const std::string& dir, const char* name, uint32_t name_len, bool is_dir) const;
+    static bool _matchRule(const Rule& rule, const char* str, uint32_t len);
+    static bool _matchTokens(const Rule& rule, uint32_t ti, const char* str, uint32_t si, uint32_t len);
+
+private:
+    std::shared_ptr<const IgnoreRules> parent_;
+    uint32_t    dir_len_;
+    std::string prefix_;
+    std::vector<Rule> rules_;
+    bool        anchored_{ false };     // any of rules_ is matched against the path
+    bool        has_files_{ false };
+    uint64_t    stamp_{ 0 };
+};
+
+} // end namespace leaf
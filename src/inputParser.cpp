@@ -0,0 +1,226 @@
+#include "inputParser.h"
+
+namespace leaf
+{
+
+const InputParser::Transition InputParser::transitions_[StateNum][ClassNum] = {
+    // Esc                Control              Intermediate         Param                Final                Text
+    { { Start, Escape },  { Execute, Ground }, { Print, Ground },   { Print, Ground },   { Print, Ground },   { Print, Ground } },   // Ground
+    { { Abort, Ground },  { Abort, Ground },   { Dispatch, Ground },{ Dispatch, Ground },{ Select, Escape },  { Abort, Ground } },   // Escape
+    { { Abort, Ground },  { Abort, Ground },   { Select, Csi },     { Collect, Csi },    { Select, Csi },     { Abort, Ground } },   // Csi
+    { { Abort, Ground },  { Abort, Ground },   { Dispatch, Ground },{ Dispatch, Ground },{ Dispatch, Ground },{ Abort, Ground } },   // Ss3
+    { { Collect, MouseX10 }, { Collect, MouseX10 }, { Collect, MouseX10 }, { Collect, MouseX10 }, { Collect, MouseX10 }, { Collect, MouseX10 } },   // MouseX10
+    { { Collect, Paste }, { Collect, Paste },  { Collect, Paste },  { Collect, Paste },  { Collect, Paste },  { Collect, Paste } },  // Paste
+};
+
+InputParser::ByteClass InputParser::_classify(uint8_t ch) noexcept {
+    if ( ch == 0x1B ) {
+        return Esc;
+    }
+    else if ( ch < 0x20 || ch == 0x7F ) {
+        return Control;
+    }
+    else if ( ch < 0x30 ) {
+        return Intermediate;
+    }
+    else if ( ch < 0x40 ) {
+        return Param;
+    }
+    else if ( ch < 0x7F ) {
+        return Final;
+    }
+    else {
+        return Text;
+    }
+}
+
+void InputParser::feed(const char* data, size_t len) {
+    size_t i = 0;
+    while ( i < len ) {
+        if ( state_ == Paste ) {
+            _parsePaste(data, len, i);
+        }
+        else {
+            _parse(static_cast<uint8_t>(data[i]));
+            ++i;
+        }
+    }
+}
+
+void InputParser::timeout() {
+    auto num = events_.size();
+    switch ( state_ )
+    {
+    case Escape:
+    case Csi:
+    case Ss3:
+        // e.g. a lone ESC, or \033[ typed as Alt-[
+        _dispatch();
+        break;
+    case MouseX10:
+        esc_code_.clear();
+        state_ = Ground;
+        break;
+    case Paste:
+        // the rest of the paste is still coming
+        return;
+    default:
+        break;
+    }
+    _flushChar();
+
+    if ( events_.size() == num && last_key_ != Key::Timeout ) {
+        _emit(Key::Timeout, std::string());
+    }
+}
+
+void InputParser::_parse(uint8_t ch) {
+    if ( state_ == MouseX10 ) {
+        esc_code_.push_back(ch);
+        if ( esc_code_.length() == 6 ) {
+            state_ = Ground;
+            _emit(Key::Unknown, std::move(esc_code_));
+            esc_code_.clear();
+        }
+        return;
+    }
+
+    auto& trans = transitions_[state_][_classify(ch)];
+    switch ( trans.action )
+    {
+    case Print:
+        if ( ch < 0x80 || ch >= 0xC0 ) {
+            _flushChar();
+            char_len_ = ch < 0x80 ? 1 : ch < 0xE0 ? 2 : ch < 0xF0 ? 3 : 4;
+        }
+        else if ( char_.empty() ) {
+            // a stray continuation byte
+            char_len_ = 1;
+        }
+        char_.push_back(ch);
+        if ( char_.length() == char_len_ ) {
+            _flushChar();
+        }
+        break;
+    case Execute:
+        _flushChar();
+        _emit(static_cast<Key>(ch), std::string());
+        break;
+    case Start:
+        _flushChar();
+        esc_code_.push_back(ch);
+        state_ = trans.next;
+        break;
+    case Collect:
+        esc_code_.push_back(ch);
+        state_ = trans.next;
+        break;
+    case Dispatch:
+        esc_code_.push_back(ch);
+        _dispatch();
+        break;
+    case Abort:
+        _dispatch();
+        _parse(ch);
+        break;
+    case Select:
+        _select(ch);
+        break;
+    }
+}
+
+void InputParser::_select(uint8_t ch) {
+    esc_code_.push_back(ch);
+    if ( state_ == Escape ) {
+        if ( ch == '[' ) {
+            state_ = Csi;
+        }
+        else if ( ch == 'O' ) {
+            state_ = Ss3;
+        }
+        else {  // e.g. Alt-a
+            _dispatch();
+        }
+    }
+    else if ( _classify(ch) == Intermediate ) {
+        // rxvt terminates some sequences with $
+        if ( esc_codes_.find(esc_code_) != esc_codes_.end() ) {
+            _dispatch();
+        }
+    }
+    else if ( esc_code_ == "\033[[" ) {
+        // the linux console sends \033[[A for F1
+    }
+    else if ( esc_code_ == "\033[M" ) {
+        state_ = MouseX10;
+    }
+    else if ( esc_code_ == "\033[200~" ) {
+        esc_code_.clear();
+        paste_.clear();
+        state_ = Paste;
+    }
+    else {
+        _dispatch();
+    }
+}
+
+void InputParser::_parsePaste(const char* data, size_t len, size_t& i) {
+    static const std::string paste_end("\033[201~");
+
+    auto old_size = paste_.length();
+    paste_.append(data + i, len - i);
+    auto pos = paste_.find(paste_end, old_size < paste_end.length() ? 0 : old_size - paste_end.length() + 1);
+    if ( pos == std::string::npos ) {
+        i = len;
+        return;
+    }
+
+    i += pos + paste_end.length() - old_size;
+    paste_.resize(pos);
+    state_ = Ground;
+
+    while ( !paste_.empty() && (paste_.back() == '\n' || paste_.back() == '\r') ) {
+        paste_.pop_back();
+    }
+    for ( auto& ch : paste_ ) {
+        if ( _classify(ch) <= Control ) {
+            ch = ' ';
+        }
+    }
+    if ( !paste_.empty() ) {
+        _emit(Key::Paste, std::move(paste_));
+    }
+    paste_.clear();
+}
+
+void InputParser::_dispatch() {
+    state_ = Ground;
+    if ( esc_code_.length() == 1 ) {
+        esc_code_.clear();
+        _emit(Key::ESC, std::string());
+        return;
+    }
+
+    auto iter = esc_codes_.find(esc_code_);
+    auto key = iter != esc_codes_.end() ? iter->second : Key::Unknown;
+    _emit(key, std::move(esc_code_));
+    esc_code_.clear();
+}
+
+void InputParser::_flushChar() {
+    if ( !char_.empty() ) {
+        _emit(Key::Char, std::move(char_));
+        char_.clear();
+    }
+}
+
+void InputParser::_emit(Key key, std::string&& str) {
+    // gives the pending search a chance to run before the key is handled
+    if ( last_key_ == Key::Char && key != Key::Char && key != Key::Timeout ) {
+        events_.emplace_back(Key::Timeout, std::string());
+    }
+    last_key_ = key;
+    events_.emplace_back(key, std::move(str));
+}
+
+} // end namespace leaf
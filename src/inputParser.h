@@ -0,0 +1,114 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <tuple>
+#include <unordered_map>
+#include "consts.h"
+
+namespace leaf
+{
+
+/**
+ * Turns the bytes read from the terminal into keys.
+ * Bytes are fed in whatever chunks read() returns, a key split across two chunks
+ * is completed by the next feed(). timeout() is called when no input arrives for
+ * a while, it completes a lone ESC, which cannot be told apart from the start of an
+ * escape sequence before that.
+ *
+ * The events are:
+ *   Key::Char     a UTF-8 character
+ *   Key::Paste    the text between \033[200~ and \033[201~ (bracketed paste), the
+ *                 line breaks and other control characters are replaced by spaces
+ *   Key::Unknown  an escape sequence not in esc_codes, e.g., mouse tracking or a
+ *                 cursor position report, the sequence is the string
+ *   Key::Timeout  a run of characters is followed by another key, or no input
+ *                 has arrived for a while
+ *   other keys    control characters and the escape sequences in esc_codes
+ */
+class InputParser
+{
+public:
+    using EscCodeMap = std::unordered_map<std::string, Key>;
+    using Event = std::tuple<Key, std::string>;
+
+    explicit InputParser(const EscCodeMap& esc_codes) : esc_codes_(esc_codes) {}
+
+    void feed(const char* data, size_t len);
+    void timeout();
+
+    bool empty() const noexcept {
+        return events_.empty();
+    }
+
+    Event pop() {
+        auto event = std::move(events_.front());
+        events_.pop_front();
+        return event;
+    }
+
+private:
+    enum State : uint8_t
+    {
+        Ground,
+        Escape,     // after ESC
+        Csi,        // after ESC [
+        Ss3,        // after ESC O
+        MouseX10,   // after ESC [ M, 3 raw bytes follow
+        Paste,      // after ESC [ 200 ~
+
+        StateNum
+    };
+
+    enum ByteClass : uint8_t
+    {
+        Esc,            // 0x1B
+        Control,        // other C0 controls and DEL
+        Intermediate,   // 0x20 - 0x2F
+        Param,          // 0x30 - 0x3F
+        Final,          // 0x40 - 0x7E
+        Text,           // 0x80 - 0xFF, UTF-8
+
+        ClassNum
+    };
+
+    enum Action : uint8_t
+    {
+        Print,      // append to the current character
+        Execute,    // emit a control character
+        Start,      // begin an escape sequence
+        Collect,    // append to the escape sequence
+        Dispatch,   // append to the escape sequence and emit it
+        Abort,      // emit the escape sequence so far, then parse the byte in Ground
+        Select,     // the byte after ESC or ESC [ decides the next state
+    };
+
+    struct Transition
+    {
+        Action action;
+        State  next;
+    };
+
+    static const Transition transitions_[StateNum][ClassNum];
+
+    static ByteClass _classify(uint8_t ch) noexcept;
+    void _parse(uint8_t ch);
+    void _parsePaste(const char* data, size_t len, size_t& i);
+    void _select(uint8_t ch);
+    void _dispatch();
+    void _flushChar();
+    void _emit(Key key, std::string&& str);
+
+private:
+    const EscCodeMap& esc_codes_;
+    State state_{ Ground };
+    std::string esc_code_;
+    std::string char_;      // the bytes of an incomplete UTF-8 character
+    uint32_t char_len_{ 0 };
+    std::string paste_;
+    std::deque<Event> events_;
+    Key last_key_{ Key::Timeout };
+};
+
+} // end namespace leaf
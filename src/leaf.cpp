@@ -0,0 +1,175 @@
+#include <new>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+
+#include "leaf.h"
+#include "fuzzyEngine.h"
+#include "utils.h"
+
+using namespace leaf;
+
+struct leaf_corpus
+{
+    explicit leaf_corpus(uint32_t thread_count) : fuzzy_engine(thread_count) {}
+
+    std::vector<StrType>    lines;
+    std::vector<uint64_t>   signatures;     // of lines, so that a search skips the lines it cannot match
+    FuzzyEngine             fuzzy_engine;
+    Preference              preference{ Preference::End };
+    std::vector<MatchResult> top;
+};
+
+struct leaf_cancel
+{
+    std::atomic<bool> cancelled{ false };
+};
+
+uint32_t leaf_version(void) {
+    return LEAF_API_VERSION;
+}
+
+leaf_corpus* leaf_corpus_new(uint32_t thread_count) {
+    if ( thread_count == 0 ) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    // no exception crosses into the caller, e.g., std::bad_alloc or std::system_error
+    try {
+        return new leaf_corpus(thread_count);
+    }
+    catch ( ... ) {
+        return nullptr;
+    }
+}
+
+void leaf_corpus_free(leaf_corpus* corpus) {
+    delete corpus;
+}
+
+void leaf_corpus_set_preference(leaf_corpus* corpus, leaf_preference preference) {
+    corpus->preference = preference == LEAF_PREFER_BEGIN ? Preference::Begin : Preference::End;
+}
+
+int32_t leaf_corpus_append(leaf_corpus* corpus, const char* const* lines, const uint32_t* lens,
+                           uint32_t count) {
+    try {
+        // nothing is appended if the memory cannot be reserved
+        corpus->lines.reserve(corpus->lines.size() + count);
+        corpus->signatures.reserve(corpus->signatures.size() + count);
+    }
+    catch ( ... ) {
+        return -1;
+    }
+
+    for ( uint32_t i = 0; i < count; ++i ) {
+        corpus->lines.push_back(makeConstString(lines[i], lens[i]));
+        corpus->signatures.push_back(FuzzyMatch::getSignature(lines[i], lens[i]));
+    }
+    return 0;
+}
+
+int32_t leaf_corpus_append_text(leaf_corpus* corpus, const char* text, uint64_t len) {
+    auto size = corpus->lines.size();
+    try {
+        utils::forEachLine(text, len, [corpus, text](uint64_t offset, uint64_t line_len) {
+            corpus->lines.push_back(makeConstString(text + offset, line_len));
+            corpus->signatures.push_back(FuzzyMatch::getSignature(text + offset, line_len));
+        });
+    }
+    catch ( ... ) {
+        // the lines appended so far are dropped
+        corpus->lines.resize(size);
+        corpus->signatures.resize(size);
+        return -1;
+    }
+    return 0;
+}
+
+uint32_t leaf_corpus_size(const leaf_corpus* corpus) {
+    return corpus->lines.size();
+}
+
+leaf_cancel* leaf_cancel_new(void) {
+    return new (std::nothrow) leaf_cancel;
+}
+
+void leaf_cancel_free(leaf_cancel* cancel) {
+    delete cancel;
+}
+
+void leaf_cancel_set(leaf_cancel* cancel) {
+    cancel->cancelled = true;
+}
+
+void leaf_cancel_reset(leaf_cancel* cancel) {
+    cancel->cancelled = false;
+}
+
+int32_t leaf_search(leaf_corpus* corpus, const char* pattern, uint32_t pattern_len,
+                    leaf_match* matches, uint32_t top, uint32_t* match_count, leaf_cancel* cancel) {
+    const auto& lines = corpus->lines;
+    uint32_t count = 0;
+    uint32_t total = 0;
+    if ( pattern_len == 0 ) {
+        total = lines.size();
+        count = std::min(top, total);
+        for ( uint32_t i = 0; i < count; ++i ) {
+            matches[i].index = i;
+            matches[i].weight = 0;
+        }
+    }
+    else {
+        try {
+            SpanList<StrType> source{ { lines.data(), lines.size() } };
+            auto& results = corpus->top;
+            results.resize(std::min(static_cast<size_t>(top), lines.size()));
+            count = corpus->fuzzy_engine.topMatch(source, std::string(pattern, pattern_len), corpus->preference,
+                                                  results.data(), results.size(), total,
+                                                  cancel ? &cancel->cancelled : nullptr,
+                                                  corpus->signatures.data());
+        }
+        catch ( ... ) {
+            return -1;
+        }
+        for ( uint32_t i = 0; i < count; ++i ) {
+            matches[i].index = corpus->top[i].index;
+            matches[i].weight = corpus->top[i].weight;
+        }
+    }
+
+    if ( cancel != nullptr && cancel->cancelled ) {
+        return -1;
+    }
+
+    if ( match_count != nullptr ) {
+        *match_count = total;
+    }
+    return count;
+}
+
+uint32_t leaf_highlight(leaf_corpus* corpus, const char* pattern, uint32_t pattern_len,
+                        uint32_t index, leaf_position* positions, uint32_t max_count) {
+    if ( pattern_len == 0 || index >= corpus->lines.size() ) {
+        return 0;
+    }
+
+    HighlightList highlights;
+    try {
+        highlights = corpus->fuzzy_engine.getHighlights(&corpus->lines[index], 1,
+                                                        std::string(pattern, pattern_len));
+    }
+    catch ( ... ) {
+        return 0;
+    }
+    if ( highlights.empty() || !highlights[0] ) {
+        return 0;
+    }
+
+    uint32_t count = std::min(static_cast<uint32_t>(highlights[0]->end_index), max_count);
+    for ( uint32_t i = 0; i < count; ++i ) {
+        positions[i].col = highlights[0]->positions[i].col;
+        positions[i].len = highlights[0]->positions[i].len;
+    }
+    return count;
+}
@@ -0,0 +1,89 @@
+_Pragma("once");
+
+/**
+ * The C API of libleaf, the fuzzy matching engine of yy.
+ * A program linking libleaf.a also links libstdc++ and libpthread.
+ *
+ * A corpus holds lines owned by the caller, and searches them on its own threads.
+ * The functions of a corpus must not be called concurrently, except leaf_cancel_set(),
+ * which stops a running leaf_search() from any thread. In particular one corpus must
+ * not be searched from two threads at once, as its search buffers and engine are
+ * shared by its searches, a corpus per thread searches in parallel.
+ *
+ * No C++ exception leaves the library, a function failing to allocate memory or to
+ * start its threads returns NULL, -1 or 0 as documented below.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LEAF_API_VERSION 1
+
+typedef struct leaf_corpus leaf_corpus;
+typedef struct leaf_cancel leaf_cancel;
+
+typedef enum leaf_preference
+{
+    LEAF_PREFER_BEGIN,
+    LEAF_PREFER_END         /* the default, as yy */
+} leaf_preference;
+
+typedef struct leaf_match
+{
+    uint32_t index;         /* the index of the line in the corpus */
+    int32_t  weight;
+} leaf_match;
+
+typedef struct leaf_position
+{
+    uint16_t col;           /* the bytes matched */
+    uint16_t len;
+} leaf_position;
+
+/* returns LEAF_API_VERSION of the library */
+uint32_t leaf_version(void);
+
+/* thread_count 0 means one thread per cpu, returns NULL on failure */
+leaf_corpus* leaf_corpus_new(uint32_t thread_count);
+void leaf_corpus_free(leaf_corpus* corpus);
+void leaf_corpus_set_preference(leaf_corpus* corpus, leaf_preference preference);
+
+/**
+ * The lines are not copied, they must stay valid and unchanged until the corpus is
+ * freed. leaf_corpus_append_text() splits text into lines ending with '\n', '\r' or
+ * "\r\n", the lines are numbered in the order they are appended.
+ * They return 0, or -1 on failure, in which case none of the lines is appended.
+ */
+int32_t leaf_corpus_append(leaf_corpus* corpus, const char* const* lines, const uint32_t* lens,
+                           uint32_t count);
+int32_t leaf_corpus_append_text(leaf_corpus* corpus, const char* text, uint64_t len);
+uint32_t leaf_corpus_size(const leaf_corpus* corpus);
+
+/* returns NULL on failure */
+leaf_cancel* leaf_cancel_new(void);
+void leaf_cancel_free(leaf_cancel* cancel);
+void leaf_cancel_set(leaf_cancel* cancel);
+void leaf_cancel_reset(leaf_cancel* cancel);
+
+/**
+ * Writes the top best matches of pattern to matches, sorted by weight in descending
+ * order, and the number of all the matches to match_count if it is not NULL.
+ * Returns the number of the matches written, or -1 if cancel has been set or the search
+ * fails, cancel can be NULL. An empty pattern matches the first top lines with weight 0.
+ */
+int32_t leaf_search(leaf_corpus* corpus, const char* pattern, uint32_t pattern_len,
+                    leaf_match* matches, uint32_t top, uint32_t* match_count, leaf_cancel* cancel);
+
+/**
+ * Writes at most max_count positions of the bytes of line index matched by pattern,
+ * returns the number of them, 0 on failure.
+ */
+uint32_t leaf_highlight(leaf_corpus* corpus, const char* pattern, uint32_t pattern_len,
+                        uint32_t index, leaf_position* positions, uint32_t max_count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,189 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "lineIndex.h"
+#include "fuzzyMatch.h"
+#include "utils.h"
+
+namespace leaf
+{
+
+constexpr char LineIndex::Magic[8];
+
+LineIndex::~LineIndex() {
+    if ( index_ != nullptr ) {
+        munmap(index_, index_size_);
+    }
+    if ( data_ != nullptr ) {
+        munmap(const_cast<char*>(data_), data_size_);
+    }
+}
+
+bool LineIndex::build(const std::string& file, const std::string& index_file) {
+    auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat(fd, &st) == -1 ) {
+        close(fd);
+        return false;
+    }
+    if ( !S_ISREG(st.st_mode) ) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    auto real_path = realpath(file.c_str(), nullptr);
+    if ( real_path == nullptr ) {
+        close(fd);
+        return false;
+    }
+    std::string path(real_path);
+    free(real_path);
+
+    uint64_t size = st.st_size;
+    const char* data = nullptr;
+    if ( size > 0 ) {
+        auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( p == MAP_FAILED ) {
+            close(fd);
+            return false;
+        }
+        data = static_cast<const char*>(p);
+        madvise(p, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    uint64_t line_count = 0;
+    utils::forEachLine(data, size, [&line_count](uint64_t, uint64_t) { ++line_count; });
+
+    auto signatures_offset = sizeof(Header) + utils::align8(path.length());
+    auto offsets_offset = signatures_offset + sizeof(uint64_t) * line_count;
+    auto lengths_offset = offsets_offset + sizeof(uint64_t) * line_count;
+    auto index_size = lengths_offset + sizeof(uint32_t) * line_count;
+
+    // the index is never partial
+    auto ok = utils::replaceFile(index_file, index_size, 0644, [&](char* p) {
+        auto& header = *reinterpret_cast<Header*>(p);
+        memcpy(header.magic, Magic, sizeof(Magic));
+        header.file_size = size;
+        header.file_mtime = utils::toNs(st.st_mtim);
+        header.line_count = line_count;
+        header.path_len = path.length();
+        header.reserved = 0;
+        memcpy(p + sizeof(Header), path.data(), path.length());
+
+        auto signatures = reinterpret_cast<uint64_t*>(p + signatures_offset);
+        auto offsets = reinterpret_cast<uint64_t*>(p + offsets_offset);
+        auto lengths = reinterpret_cast<uint32_t*>(p + lengths_offset);
+        uint64_t i = 0;
+        utils::forEachLine(data, size, [&](uint64_t offset, uint64_t len) {
+            len = std::min(len, static_cast<uint64_t>(UINT32_MAX));
+            signatures[i] = FuzzyMatch::getSignature(data + offset, len);
+            offsets[i] = offset;
+            lengths[i] = len;
+            ++i;
+        });
+    });
+
+    if ( data != nullptr ) {
+        auto err = errno;
+        munmap(const_cast<char*>(data), size);
+        errno = err;
+    }
+
+    return ok;
+}
+
+bool LineIndex::load(const std::string& index_file, std::string& error) {
+    auto fd = open(index_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd == -1 ) {
+        error = utils::strFormat("%s: %s", index_file.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat(fd, &st) == -1 ) {
+        error = utils::strFormat("%s: %s", index_file.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    if ( static_cast<size_t>(st.st_size) < sizeof(Header) ) {
+        error = utils::strFormat("%s: not an index", index_file.c_str());
+        close(fd);
+        return false;
+    }
+
+    index_size_ = st.st_size;
+    auto index = mmap(nullptr, index_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( index == MAP_FAILED ) {
+        error = utils::strFormat("%s: %s", index_file.c_str(), strerror(errno));
+        return false;
+    }
+    index_ = index;
+
+    auto p = static_cast<const char*>(index_);
+    const auto& header = *reinterpret_cast<const Header*>(p);
+    auto signatures_offset = sizeof(Header) + utils::align8(header.path_len);
+    auto offsets_offset = signatures_offset + sizeof(uint64_t) * header.line_count;
+    auto lengths_offset = offsets_offset + sizeof(uint64_t) * header.line_count;
+    if ( memcmp(header.magic, Magic, sizeof(Magic)) != 0
+         || header.line_count > index_size_
+         || lengths_offset + sizeof(uint32_t) * header.line_count != index_size_ ) {
+        error = utils::strFormat("%s: not an index", index_file.c_str());
+        return false;
+    }
+
+    std::string path(p + sizeof(Header), header.path_len);
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd == -1 ) {
+        error = utils::strFormat("%s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    if ( fstat(fd, &st) == -1 || static_cast<uint64_t>(st.st_size) != header.file_size
+         || utils::toNs(st.st_mtim) != header.file_mtime ) {
+        error = utils::strFormat("%s has changed since %s was built", path.c_str(), index_file.c_str());
+        close(fd);
+        return false;
+    }
+
+    data_size_ = st.st_size;
+    if ( data_size_ > 0 ) {
+        auto data = mmap(nullptr, data_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( data == MAP_FAILED ) {
+            error = utils::strFormat("%s: %s", path.c_str(), strerror(errno));
+            close(fd);
+            return false;
+        }
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+
+    signatures_ = reinterpret_cast<const uint64_t*>(p + signatures_offset);
+    offsets_ = reinterpret_cast<const uint64_t*>(p + offsets_offset);
+    lengths_ = reinterpret_cast<const uint32_t*>(p + lengths_offset);
+
+    // the lines are trusted once they are in the file
+    for ( uint64_t i = 0; i < header.line_count; ++i ) {
+        if ( offsets_[i] > data_size_ || lengths_[i] > data_size_ - offsets_[i] ) {
+            error = utils::strFormat("%s: not an index", index_file.c_str());
+            return false;
+        }
+    }
+
+    line_count_ = header.line_count;
+    return true;
+}
+
+} // end namespace leaf
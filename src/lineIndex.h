@@ -0,0 +1,80 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace leaf
+{
+
+/**
+ * The index of the lines of a text file, written to a sidecar file by build() and
+ * mapped into memory by load(), so that the lines of a large file can be searched
+ * right after launch, without scanning the file for the line breaks.
+ * A line ends with '\n', '\r' or "\r\n", as the lines read from stdin.
+ *
+ * The index file is made up of the Header, the real path of the text file, the
+ * signatures, the offsets and the lengths of the lines. It records the size and the
+ * mtime of the text file, the index is rejected if the file has changed since.
+ */
+class LineIndex
+{
+public:
+    LineIndex(const LineIndex&) = delete;
+    LineIndex& operator=(const LineIndex&) = delete;
+
+    LineIndex() = default;
+    ~LineIndex();
+
+    // returns false and sets errno on failure
+    static bool build(const std::string& file, const std::string& index_file);
+
+    // maps index_file and the file indexed, error is set on failure
+    bool load(const std::string& index_file, std::string& error);
+
+    const char* data() const noexcept {
+        return data_;
+    }
+
+    uint64_t size() const noexcept {
+        return line_count_;
+    }
+
+    // FuzzyMatch::getSignature() of each line
+    const uint64_t* signatures() const noexcept {
+        return signatures_;
+    }
+
+    const uint64_t* offsets() const noexcept {
+        return offsets_;
+    }
+
+    const uint32_t* lengths() const noexcept {
+        return lengths_;
+    }
+
+private:
+    struct Header
+    {
+        char     magic[8];
+        uint64_t file_size;
+        int64_t  file_mtime;    // ns
+        uint64_t line_count;
+        uint32_t path_len;
+        uint32_t reserved;
+    };
+
+    static constexpr char Magic[8] = { 'L', 'E', 'A', 'F', 'I', 'D', 'X', '1' };
+
+private:
+    void*           index_{ nullptr };
+    size_t          index_size_{ 0 };
+    const char*     data_{ nullptr };
+    size_t          data_size_{ 0 };
+    uint64_t        line_count_{ 0 };
+    const uint64_t* signatures_{ nullptr };
+    const uint64_t* offsets_{ nullptr };
+    const uint32_t* lengths_{ nullptr };
+};
+
+} // end namespace leaf
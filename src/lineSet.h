@@ -0,0 +1,166 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "utils.h"
+
+namespace leaf
+{
+
+/**
+ * A set of the 64-bit hashes of lines, counting the times each hash is inserted,
+ * two lines with the same hash are taken as the same line.
+ * The set is split into shards by the high bits of the hash, each shard is an
+ * open-addressing table with linear probing guarded by its own mutex, so that
+ * count() from the threads of a search rarely waits for insert(), and a shard
+ * grows without stopping the others.
+ */
+class LineSet
+{
+public:
+    static constexpr uint32_t ShardBits = 6;
+
+    // returns true if hash is new, otherwise counts it once more
+    bool insert(uint64_t hash) {
+        uint32_t id = 0;
+        return insert(hash, id) == 1;
+    }
+
+    /**
+     * Inserts hash with id if it is new, otherwise counts it once more and sets id to
+     * the id hash has been inserted with, e.g., the line kept of the lines with hash.
+     * Returns the count of hash.
+     */
+    uint32_t insert(uint64_t hash, uint32_t& id) {
+        hash = utils::hashKey(hash);
+        auto& shard = shards_[hash >> (64 - ShardBits)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if ( (shard.size + 1) * 4 > shard.slots.size() * 3 ) {
+            _grow(shard);
+        }
+
+        auto mask = shard.slots.size() - 1;
+        for ( auto i = hash & mask; ; i = (i + 1) & mask ) {
+            auto& slot = shard.slots[i];
+            if ( slot.key == hash ) {
+                id = slot.id;
+                return ++slot.count;
+            }
+            else if ( slot.key == 0 ) {
+                slot.key = hash;
+                slot.count = 1;
+                slot.id = id;
+                ++shard.size;
+                return 1;
+            }
+        }
+    }
+
+    /**
+     * Loads the slot hash would be inserted into into the cache, so that inserting a
+     * batch of hashes prefetched first waits for the memory once instead of per hash.
+     * Only the thread calling insert() resizes the tables, so it can call prefetch().
+     */
+    void prefetch(uint64_t hash) const noexcept {
+        hash = utils::hashKey(hash);
+        const auto& slots = shards_[hash >> (64 - ShardBits)].slots;
+        if ( !slots.empty() ) {
+            __builtin_prefetch(&slots[hash & (slots.size() - 1)], 1);
+        }
+    }
+
+    // forgets hash whatever its count is
+    void erase(uint64_t hash) {
+        hash = utils::hashKey(hash);
+        auto& shard = shards_[hash >> (64 - ShardBits)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if ( shard.size == 0 ) {
+            return;
+        }
+
+        auto mask = shard.slots.size() - 1;
+        auto i = hash & mask;
+        while ( shard.slots[i].key != hash ) {
+            if ( shard.slots[i].key == 0 ) {
+                return;
+            }
+            i = (i + 1) & mask;
+        }
+
+        // the slots after the hole that would not be found across it are moved back
+        for ( auto j = (i + 1) & mask; shard.slots[j].key != 0; j = (j + 1) & mask ) {
+            auto home = shard.slots[j].key & mask;
+            if ( ((j - home) & mask) >= ((j - i) & mask) ) {
+                shard.slots[i] = shard.slots[j];
+                i = j;
+            }
+        }
+        shard.slots[i].key = 0;
+        --shard.size;
+    }
+
+    // the times hash has been inserted, 0 if it is not in the set
+    uint32_t count(uint64_t hash) {
+        hash = utils::hashKey(hash);
+        auto& shard = shards_[hash >> (64 - ShardBits)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if ( shard.size == 0 ) {
+            return 0;
+        }
+
+        auto mask = shard.slots.size() - 1;
+        for ( auto i = hash & mask; shard.slots[i].key != 0; i = (i + 1) & mask ) {
+            if ( shard.slots[i].key == hash ) {
+                return shard.slots[i].count;
+            }
+        }
+        return 0;
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for ( auto& shard : shards_ ) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.size;
+        }
+        return total;
+    }
+
+private:
+    struct Slot
+    {
+        uint64_t key;   // 0 if the slot is empty
+        uint32_t count;
+        uint32_t id;
+    };
+
+    struct Shard
+    {
+        std::mutex        mutex;
+        std::vector<Slot> slots;
+        size_t            size{ 0 };
+    };
+
+    static void _grow(Shard& shard) {
+        std::vector<Slot> slots(shard.slots.empty() ? 64 : shard.slots.size() * 2, Slot{ 0, 0, 0 });
+        auto mask = slots.size() - 1;
+        for ( const auto& slot : shard.slots ) {
+            if ( slot.key != 0 ) {
+                auto i = slot.key & mask;
+                while ( slots[i].key != 0 ) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = slot;
+            }
+        }
+        shard.slots.swap(slots);
+    }
+
+private:
+    Shard shards_[1 << ShardBits];
+
+};
+
+} // end namespace leaf
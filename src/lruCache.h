@@ -0,0 +1,88 @@
+_Pragma("once");
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace leaf
+{
+
+/**
+ * A fixed-capacity map that evicts the least recently used entry.
+ * The node of an evicted entry is reused, so a full cache does not allocate.
+ */
+template <typename Key, typename Value>
+class LruCache
+{
+    using Entry = std::pair<Key, Value>;
+public:
+    explicit LruCache(size_t capacity=0) : capacity_(capacity) {}
+
+    size_t size() const noexcept {
+        return index_.size();
+    }
+
+    size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+    void clear() {
+        entries_.clear();
+        index_.clear();
+    }
+
+    // also clears the cache
+    void reset(size_t capacity) {
+        clear();
+        capacity_ = capacity;
+    }
+
+    bool contains(const Key& key) const {
+        return index_.find(key) != index_.end();
+    }
+
+    /**
+     * Returns nullptr if key is not in the cache, otherwise the entry becomes the most
+     * recently used one. The pointer is valid until the entry is evicted.
+     */
+    Value* get(const Key& key) {
+        auto iter = index_.find(key);
+        if ( iter == index_.end() ) {
+            return nullptr;
+        }
+
+        entries_.splice(entries_.begin(), entries_, iter->second);
+        return &iter->second->second;
+    }
+
+    Value& put(const Key& key, Value&& value) {
+        auto iter = index_.find(key);
+        if ( iter != index_.end() ) {
+            entries_.splice(entries_.begin(), entries_, iter->second);
+            iter->second->second = std::move(value);
+            return iter->second->second;
+        }
+
+        if ( capacity_ > 0 && index_.size() >= capacity_ ) {
+            // reuse the least recently used node
+            entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+            index_.erase(entries_.front().first);
+            entries_.front().first = key;
+            entries_.front().second = std::move(value);
+        }
+        else {
+            entries_.emplace_front(key, std::move(value));
+        }
+        index_.emplace(key, entries_.begin());
+
+        return entries_.front().second;
+    }
+
+private:
+    size_t capacity_;
+    std::list<Entry> entries_;  // the most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index_;
+};
+
+} // end namespace leaf
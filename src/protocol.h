@@ -0,0 +1,40 @@
+_Pragma("once");
+
+#include <cstdint>
+#include "fuzzyMatch.h"
+
+namespace leaf
+{
+
+/**
+ * The frames exchanged over the socket of --serve, in the byte order of the host.
+ * A client sends a QueryHeader followed by the pattern, and may send the next query
+ * without waiting. The server answers each query in order with a ReplyHeader followed
+ * by ReplyHeader::line_count lines, each of them is a ReplyLine followed by the text
+ * of the line and ReplyLine::position_count HighlightPos, the bytes matched.
+ */
+struct QueryHeader
+{
+    uint32_t pattern_len;   // at most MaxPatternLen
+    uint32_t top;           // the number of lines wanted
+};
+
+struct ReplyHeader
+{
+    uint32_t line_count;    // min(top, match_count)
+    uint32_t match_count;
+    uint32_t total;         // the number of lines searched
+};
+
+struct ReplyLine
+{
+    int32_t  weight;        // 0 if the pattern is empty
+    uint32_t len;
+    uint16_t position_count;
+    uint16_t reserved;
+};
+
+// a longer pattern closes the connection
+constexpr uint32_t MaxPatternLen = 4096;
+
+} // end namespace leaf
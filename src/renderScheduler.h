@@ -0,0 +1,189 @@
+_Pragma("once");
+
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <array>
+#include <vector>
+#include "tty.h"
+#include "eventLoop.h"
+
+namespace leaf
+{
+
+enum class Region
+{
+    Prompt,
+    Cmdline,
+    LineInfo,
+    Result,
+
+    MaxNum
+};
+
+/**
+ * Draws the screen at most once per frame interval.
+ * A region task redraws a region from the latest state, so a pending one is replaced
+ * by a newer one and intermediate states are never drawn. Other tasks, e.g., scrolling,
+ * are run in order and never dropped.
+ * Tasks can be added by any thread, and all of them run in the event loop thread,
+ * region tasks after the other tasks, and everything drawn in a frame is written
+ * to the terminal at once. Deferred tasks run after the frame has been written.
+ */
+class RenderScheduler
+{
+public:
+    using Task = std::function<void()>;
+
+    RenderScheduler(const RenderScheduler&) = delete;
+    RenderScheduler& operator=(const RenderScheduler&) = delete;
+
+    // fps == 0 means no limit
+    RenderScheduler(EventLoop& loop, uint32_t fps)
+        : loop_(loop),
+          interval_(fps == 0 ? std::chrono::microseconds(0)
+                             : std::chrono::microseconds(1000000 / fps)),
+          last_frame_(std::chrono::steady_clock::now() - interval_) {
+        frame_timer_ = loop_.addTimer([this] { _frame(); });
+    }
+
+    void post(Task&& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if ( !running_ ) {
+                return;
+            }
+            tasks_.push_back(std::move(task));
+            if ( requested_ ) {
+                return;
+            }
+            requested_ = true;
+        }
+        loop_.post([this] { _schedule(); });
+    }
+
+    /**
+     * The task runs after the next frame has been written to the terminal, so after
+     * the region tasks marked before it, e.g., to free the data the rows they replace
+     * refer to.
+     */
+    void defer(Task&& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if ( !running_ ) {
+                return;
+            }
+            deferred_.push_back(std::move(task));
+            if ( requested_ ) {
+                return;
+            }
+            requested_ = true;
+        }
+        loop_.post([this] { _schedule(); });
+    }
+
+    void mark(Region region, Task&& task) {
+        Task old_task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if ( !running_ ) {
+                return;
+            }
+            // the replaced task is destroyed outside the lock
+            old_task = std::move(regions_[static_cast<uint32_t>(region)]);
+            regions_[static_cast<uint32_t>(region)] = std::move(task);
+            if ( requested_ ) {
+                return;
+            }
+            requested_ = true;
+        }
+        loop_.post([this] { _schedule(); });
+    }
+
+    // the pending tasks are dropped
+    void stop() {
+        std::vector<Task> tasks;
+        std::vector<Task> deferred;
+        std::array<Task, static_cast<uint32_t>(Region::MaxNum)> regions;
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        tasks.swap(tasks_);
+        deferred.swap(deferred_);
+        regions.swap(regions_);
+    }
+
+private:
+    // in the loop thread, the frame is drawn when the frame interval has elapsed
+    void _schedule() {
+        if ( scheduled_ ) {
+            return;
+        }
+
+        auto delay = std::chrono::duration_cast<std::chrono::microseconds>(
+            last_frame_ + interval_ - std::chrono::steady_clock::now());
+        if ( delay.count() <= 0 ) {
+            _frame();
+        }
+        else {
+            scheduled_ = true;
+            loop_.startTimer(frame_timer_, delay);
+        }
+    }
+
+    void _frame() {
+        scheduled_ = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if ( !running_ ) {
+                return;
+            }
+            tasks_.swap(tasks_in_frame_);
+            deferred_.swap(deferred_in_frame_);
+            regions_.swap(regions_in_frame_);
+            requested_ = false;
+        }
+
+        last_frame_ = std::chrono::steady_clock::now();
+        auto& tty = Tty::getInstance();
+        tty.beginFrame();
+        for ( auto& task : tasks_in_frame_ ) {
+            task();
+        }
+        for ( auto& task : regions_in_frame_ ) {
+            if ( task ) {
+                task();
+            }
+        }
+        tty.endFrame();
+
+        for ( auto& task : deferred_in_frame_ ) {
+            task();
+        }
+        deferred_in_frame_.clear();
+        tasks_in_frame_.clear();
+        for ( auto& task : regions_in_frame_ ) {
+            task = nullptr;
+        }
+    }
+
+private:
+    EventLoop& loop_;
+    std::chrono::microseconds interval_;
+    std::chrono::steady_clock::time_point last_frame_;
+    EventLoop::TimerId frame_timer_;
+    bool scheduled_{ false };   // the frame timer is armed
+
+    bool running_{ true };
+    bool requested_{ false };   // a frame has been requested since the last frame
+    std::mutex mutex_;
+    std::vector<Task> tasks_;
+    std::vector<Task> deferred_;
+    std::array<Task, static_cast<uint32_t>(Region::MaxNum)> regions_;
+
+    // only accessed in the loop thread, the capacity is reused
+    std::vector<Task> tasks_in_frame_;
+    std::vector<Task> deferred_in_frame_;
+    std::array<Task, static_cast<uint32_t>(Region::MaxNum)> regions_in_frame_;
+};
+
+} // end namespace leaf
@@ -7,8 +7,10 @@ _Pragma("once");
 #include <cassert>
 #include <cstring>
 #include <utility>
+#include <algorithm>
 #include <type_traits>
 #include <initializer_list>
+#include "span.h"
 
 #ifdef TEST_RINGBUFFER
 #include <iostream>
@@ -254,6 +256,8 @@ public:
         buffer_ = new T[new_capacity];
         if ( tail_ >= head_ ) {
             memcpy(buffer_, tmp + head_, sizeof(T) * (tail_ - head_));
+            tail_ -= head_;
+            head_ = 0;
         }
         else {
             auto n = capacity_ - head_;
@@ -606,6 +610,51 @@ public:
         }
     }
 
+    /**
+     * Returns the elements in [first, last) as at most two contiguous spans,
+     * the second one exists only if the range wraps around the end of the buffer.
+     */
+    static SpanList<T> spans(const const_iterator& first, const const_iterator& last) {
+        SpanList<T> res;
+        if ( first == last ) {
+            return res;
+        }
+
+        if ( last > first ) {
+            res.push_back({ first.data(), last - first });
+        }
+        else {
+            res.push_back({ first.data(), first.capacity() - first.current() });
+            if ( last.current() > 0 ) {
+                res.push_back({ last.buffer(), last.current() });
+            }
+        }
+
+        return res;
+    }
+
+    SpanList<T> spans() const {
+        return spans(cbegin(), cend());
+    }
+
+    /**
+     * Appends n elements starting at data, which must not point into this container.
+     */
+    void append(const T* data, size_type n) {
+        if ( n == 0 ) {
+            return;
+        }
+        if ( size() + n >= capacity_ ) {
+            reserve(size() + n + 1);
+        }
+        auto len = std::min(n, capacity_ - tail_);
+        memcpy(buffer_ + tail_, data, sizeof(T) * len);
+        if ( len < n ) {
+            memcpy(buffer_, data + len, sizeof(T) * (n - len));
+        }
+        tail_ = (tail_ + n) & (capacity_ - 1);
+    }
+
     /**
      * Removes the first count elements of the container.
      */
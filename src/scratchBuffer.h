@@ -0,0 +1,192 @@
+_Pragma("once");
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <new>
+
+namespace leaf
+{
+
+/**
+ * A reusable memory region for the temporary arrays of a search.
+ * The memory is mapped directly, so that it can be returned to the system when
+ * it is shrunk, and the pages stay mapped between searches.
+ */
+class ScratchBuffer
+{
+public:
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+    ScratchBuffer(ScratchBuffer&&) = delete;
+    ScratchBuffer& operator=(ScratchBuffer&&) = delete;
+
+    ScratchBuffer() = default;
+
+    ~ScratchBuffer() {
+        release();
+    }
+
+    // huge_page: back the buffer with transparent huge pages and pre-fault it
+    void setHugePage(bool huge_page) noexcept {
+        huge_page_ = huge_page;
+    }
+
+    // returns a buffer of at least size bytes, the content is undefined
+    void* acquire(size_t size) {
+        if ( size > peak_ ) {
+            peak_ = size;
+        }
+
+        if ( size <= capacity_ ) {
+            return data_;
+        }
+
+        release();
+
+        auto new_capacity = _roundup(size + (size >> 2));
+        auto data = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ( data == MAP_FAILED ) {
+            throw std::bad_alloc();
+        }
+
+        data_ = static_cast<char*>(data);
+        capacity_ = new_capacity;
+
+        if ( huge_page_ ) {
+#ifdef MADV_HUGEPAGE
+            madvise(data_, capacity_, MADV_HUGEPAGE);
+#endif
+            // pre-fault
+            auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            for ( size_t i = 0; i < capacity_; i += page_size ) {
+                data_[i] = 0;
+            }
+        }
+
+        return data_;
+    }
+
+    /**
+     * Returns the memory beyond the largest size acquired since last call to the
+     * system if the buffer is more than twice as large as needed.
+     */
+    void shrink() {
+        auto size = _roundup(peak_);
+        peak_ = 0;
+        if ( size == 0 ) {
+            release();
+        }
+        else if ( (size << 1) < capacity_ ) {
+            munmap(data_ + size, capacity_ - size);
+            capacity_ = size;
+        }
+    }
+
+    void release() {
+        if ( data_ != nullptr ) {
+            munmap(data_, capacity_);
+            data_ = nullptr;
+            capacity_ = 0;
+        }
+    }
+
+    size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+private:
+    size_t _roundup(size_t size) const noexcept {
+        size_t align = huge_page_ ? (2 << 20) : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return (size + align - 1) / align * align;
+    }
+
+private:
+    char*  data_{ nullptr };
+    size_t capacity_{ 0 };
+    size_t peak_{ 0 };
+    bool   huge_page_{ false };
+};
+
+/**
+ * Scratch buffers kept by FuzzyEngine across searches.
+ * Every slot is trimmed to the size recently used once every `window` searches,
+ * and all slots are released if the system is short of memory.
+ */
+class ScratchPool
+{
+public:
+    enum Slot
+    {
+        Results,
+        MergeBuffer,
+        RadixKeys,
+        RadixBuffer,
+        Spans,
+
+        SlotCount
+    };
+
+    explicit ScratchPool(bool huge_page=false) {
+        for ( auto& buffer : buffers_ ) {
+            buffer.setHugePage(huge_page);
+        }
+    }
+
+    template <typename T>
+    T* get(Slot slot, size_t count) {
+        return static_cast<T*>(buffers_[slot].acquire(count * sizeof(T)));
+    }
+
+    // should be called after each search
+    void recycle() {
+        if ( ++search_count_ < window ) {
+            return;
+        }
+        search_count_ = 0;
+
+        size_t total = 0;
+        for ( auto& buffer : buffers_ ) {
+            buffer.shrink();
+            total += buffer.capacity();
+        }
+
+        if ( total > 0 && _availableMemory() < total ) {
+            for ( auto& buffer : buffers_ ) {
+                buffer.release();
+            }
+        }
+    }
+
+private:
+    // returns MemAvailable in bytes, or the maximum value if it is unknown
+    static size_t _availableMemory() {
+        size_t available = static_cast<size_t>(-1);
+        FILE* fp = fopen("/proc/meminfo", "r");
+        if ( fp == nullptr ) {
+            return available;
+        }
+
+        char line[128];
+        while ( fgets(line, sizeof(line), fp) != nullptr ) {
+            unsigned long long kb = 0;
+            if ( sscanf(line, "MemAvailable: %llu kB", &kb) == 1 ) {
+                available = static_cast<size_t>(kb) << 10;
+                break;
+            }
+        }
+        fclose(fp);
+
+        return available;
+    }
+
+private:
+    static constexpr uint32_t window = 32;
+    ScratchBuffer buffers_[SlotCount];
+    uint32_t search_count_{ 0 };
+};
+
+} // end namespace leaf
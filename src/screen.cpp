@@ -0,0 +1,291 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include "screen.h"
+
+namespace leaf
+{
+
+// returns the number of columns a code point occupies in the terminal
+static uint32_t charWidth(uint32_t cp) {
+    // combining characters, zero width space/joiners and variation selectors
+    if ( (cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x200B && cp <= 0x200F)
+         || (cp >= 0xFE00 && cp <= 0xFE0F) ) {
+        return 0;
+    }
+
+    if ( (cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0x303E)
+         || (cp >= 0x3041 && cp <= 0x33FF) || (cp >= 0x3400 && cp <= 0x4DBF)
+         || (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0xA000 && cp <= 0xA4CF)
+         || (cp >= 0xAC00 && cp <= 0xD7A3) || (cp >= 0xF900 && cp <= 0xFAFF)
+         || (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF00 && cp <= 0xFF60)
+         || (cp >= 0xFFE0 && cp <= 0xFFE6) || (cp >= 0x1F300 && cp <= 0x1F64F)
+         || (cp >= 0x1F900 && cp <= 0x1F9FF) || (cp >= 0x20000 && cp <= 0x3FFFD) ) {
+        return 2;
+    }
+
+    return 1;
+}
+
+static Screen::Cell makeCell(const char* bytes, uint8_t len, uint8_t width, uint16_t style) {
+    Screen::Cell cell;
+    memcpy(cell.bytes, bytes, len);
+    cell.len = len;
+    cell.width = width;
+    cell.style = style;
+    return cell;
+}
+
+bool Screen::Cell::operator==(const Cell& other) const noexcept {
+    return len == other.len && width == other.width && style == other.style
+        && memcmp(bytes, other.bytes, len) == 0;
+}
+
+Screen::Screen() {
+    styles_.emplace_back();
+    style_ids_.emplace("", 0);
+}
+
+void Screen::resize(uint32_t lines, uint32_t cols) {
+    lines_ = lines;
+    cols_ = cols;
+    auto blank = makeCell(" ", 1, 1, untouched);
+    back_.assign(static_cast<size_t>(lines) * cols, blank);
+    front_.assign(static_cast<size_t>(lines) * cols, blank);
+    cursor_known_ = false;
+}
+
+void Screen::invalidate() {
+    for ( auto& cell : front_ ) {
+        cell.style = untouched;
+    }
+    cursor_known_ = false;
+}
+
+uint16_t Screen::_internStyle(const std::string& sgr) {
+    auto iter = style_ids_.find(sgr);
+    if ( iter != style_ids_.end() ) {
+        return iter->second;
+    }
+
+    if ( styles_.size() >= untouched ) {
+        return 0;
+    }
+
+    uint16_t id = styles_.size();
+    styles_.push_back(sgr);
+    style_ids_.emplace(sgr, id);
+    return id;
+}
+
+uint32_t Screen::put(uint32_t line, uint32_t col, const char* str, size_t len,
+                     const std::string& color) {
+    if ( line < 1 || line > lines_ || col < 1 ) {
+        return col;
+    }
+
+    // SGR sequences since the last reset, color is copied only if str has SGR sequences
+    std::string sgr;
+    bool in_color = !color.empty() && color != "\033[0m";
+    uint16_t style = in_color ? _internStyle(color) : 0;
+    size_t i = 0;
+    while ( i < len && col <= cols_ ) {
+        auto c = static_cast<uint8_t>(str[i]);
+        if ( c == '\033' ) {
+            if ( i + 1 < len && str[i + 1] == '[' ) {
+                auto j = i + 2;
+                while ( j < len && (str[j] < 0x40 || str[j] > 0x7E) ) {
+                    ++j;
+                }
+                if ( j < len && str[j] == 'm' ) {
+                    if ( j == i + 2 || (j == i + 3 && str[i + 2] == '0') ) {
+                        sgr.clear();
+                        in_color = false;
+                        style = 0;
+                    }
+                    else {
+                        if ( in_color ) {
+                            sgr = color;
+                            in_color = false;
+                        }
+                        sgr.append(str + i, j - i + 1);
+                        style = _internStyle(sgr);
+                    }
+                }
+                i = j + 1;
+            }
+            else {
+                // other escape sequences are not supported
+                i += 2;
+            }
+            continue;
+        }
+
+        if ( c < 0x20 || c == 0x7F ) {
+            ++i;
+            continue;
+        }
+
+        uint8_t n = 1;
+        uint32_t cp = c;
+        if ( c >= 0xF0 ) {
+            n = 4;
+            cp = c & 0x07;
+        }
+        else if ( c >= 0xE0 ) {
+            n = 3;
+            cp = c & 0x0F;
+        }
+        else if ( c >= 0xC0 ) {
+            n = 2;
+            cp = c & 0x1F;
+        }
+        n = std::min(static_cast<size_t>(n), len - i);
+        for ( uint8_t k = 1; k < n; ++k ) {
+            cp = (cp << 6) | (str[i + k] & 0x3F);
+        }
+
+        auto width = charWidth(cp);
+        if ( width == 0 ) {
+            // append to the character on the left
+            if ( col > 1 ) {
+                auto& left = _back(line, col - 1);
+                if ( left.len > 0 && left.style != untouched && left.len + n <= sizeof(left.bytes) ) {
+                    memcpy(left.bytes + left.len, str + i, n);
+                    left.len += n;
+                }
+            }
+            i += n;
+            continue;
+        }
+
+        auto& cell = _back(line, col);
+        // the left half of a wide character is overwritten
+        if ( cell.len == 0 && col > 1 ) {
+            auto& left = _back(line, col - 1);
+            left = makeCell(" ", 1, 1, left.style);
+        }
+
+        if ( width == 2 && col == cols_ ) {
+            cell = makeCell(" ", 1, 1, style);
+            ++col;
+            break;
+        }
+
+        // the right half of a wide character is overwritten
+        auto right = col + width;
+        if ( right <= cols_ && _back(line, right).len == 0 ) {
+            auto& next = _back(line, right);
+            next = makeCell(" ", 1, 1, next.style);
+        }
+
+        cell = makeCell(str + i, n, width, style);
+        if ( width == 2 ) {
+            _back(line, col + 1) = makeCell("", 0, 0, style);
+        }
+
+        col += width;
+        i += n;
+    }
+
+    return col;
+}
+
+void Screen::_setStyle(std::string& out, uint16_t style) {
+    if ( style == cursor_style_ ) {
+        return;
+    }
+
+    if ( cursor_style_ != 0 ) {
+        out.append("\033[0m");
+    }
+    if ( style != 0 ) {
+        out.append(styles_[style]);
+    }
+    cursor_style_ = style;
+}
+
+void Screen::_moveCursor(std::string& out, uint32_t line, uint32_t col) {
+    char buffer[32];
+    if ( cursor_known_ && cursor_line_ == line && col >= cursor_col_ ) {
+        auto gap = col - cursor_col_;
+        if ( gap == 0 ) {
+            return;
+        }
+
+        // rewriting a few cells on the way is shorter than a cursor movement
+        if ( gap <= 4 ) {
+            bool reprint = true;
+            for ( auto k = cursor_col_; k < col; ++k ) {
+                auto& cell = _back(line, k);
+                if ( cell.len != 1 || cell.style != cursor_style_ || cell != _front(line, k) ) {
+                    reprint = false;
+                    break;
+                }
+            }
+
+            if ( reprint ) {
+                for ( auto k = cursor_col_; k < col; ++k ) {
+                    out.push_back(_back(line, k).bytes[0]);
+                }
+                cursor_col_ = col;
+                return;
+            }
+        }
+
+        auto n = snprintf(buffer, sizeof(buffer), "\033[%uC", gap);
+        out.append(buffer, n);
+        cursor_col_ = col;
+        return;
+    }
+
+    auto n = snprintf(buffer, sizeof(buffer), "\033[%u;%uH", line, col);
+    out.append(buffer, n);
+    cursor_known_ = true;
+    cursor_line_ = line;
+    cursor_col_ = col;
+}
+
+void Screen::render(std::string& out, uint32_t cursor_line, uint32_t cursor_col) {
+    if ( !active() ) {
+        return;
+    }
+
+    for ( uint32_t line = 1; line <= lines_; ++line ) {
+        for ( uint32_t col = 1; col <= cols_; ++col ) {
+            auto& back = _back(line, col);
+            if ( back.style == untouched || back.len == 0 ) {
+                continue;
+            }
+
+            auto& front = _front(line, col);
+            bool wide = back.width == 2 && col < cols_;
+            if ( back == front && (!wide || _back(line, col + 1) == _front(line, col + 1)) ) {
+                continue;
+            }
+
+            _moveCursor(out, line, col);
+            _setStyle(out, back.style);
+            out.append(back.bytes, back.len);
+            front = back;
+            if ( wide ) {
+                _front(line, col + 1) = _back(line, col + 1);
+            }
+
+            // the width of a non-ASCII character may be different in the terminal
+            if ( back.len == 1 ) {
+                ++cursor_col_;
+            }
+            else {
+                cursor_known_ = false;
+            }
+        }
+    }
+
+    _setStyle(out, 0);
+    if ( cursor_line >= 1 && cursor_col >= 1 ) {
+        _moveCursor(out, cursor_line, cursor_col);
+    }
+}
+
+} // end namespace leaf
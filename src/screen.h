@@ -0,0 +1,110 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace leaf
+{
+
+/**
+ * A grid of cells with a front buffer, what the terminal is showing, and a back
+ * buffer, what should be shown. Strings are written into the back buffer, and
+ * render() emits only the cells that differ from the front buffer.
+ * Lines and columns are 1-based, the same as the terminal.
+ */
+class Screen
+{
+public:
+    struct Cell
+    {
+        char     bytes[8];  // UTF-8 bytes of the character, followed by combining characters
+        uint8_t  len;       // 0 if the cell is covered by the wide character on its left
+        uint8_t  width;
+        uint16_t style;     // index of styles_, or untouched
+
+        bool operator==(const Cell& other) const noexcept;
+        bool operator!=(const Cell& other) const noexcept {
+            return !(*this == other);
+        }
+    };
+
+    static constexpr uint16_t untouched = 0xFFFF;
+
+    Screen();
+
+    bool active() const noexcept {
+        return cols_ > 0;
+    }
+
+    uint32_t lines() const noexcept {
+        return lines_;
+    }
+
+    uint32_t cols() const noexcept {
+        return cols_;
+    }
+
+    /**
+     * Discards both buffers, nothing is rendered until it is written again.
+     */
+    void resize(uint32_t lines, uint32_t cols);
+
+    /**
+     * The terminal has been erased or scrolled, so every touched cell is rendered
+     * by the next render().
+     */
+    void invalidate();
+
+    /**
+     * Writes str at (line, col) in the style color, str can contain SGR escape
+     * sequences. Characters beyond the last column are dropped.
+     * Returns the column after the last character written.
+     */
+    uint32_t put(uint32_t line, uint32_t col, const char* str, size_t len,
+                 const std::string& color=std::string());
+
+    /**
+     * Appends the escape sequences and characters that bring the terminal from the
+     * front buffer to the back buffer to out, then moves the cursor to
+     * (cursor_line, cursor_col).
+     */
+    void render(std::string& out, uint32_t cursor_line, uint32_t cursor_col);
+
+    /**
+     * The terminal cursor has been moved by someone else.
+     */
+    void forgetCursor() noexcept {
+        cursor_known_ = false;
+    }
+
+private:
+    uint16_t _internStyle(const std::string& sgr);
+    void _moveCursor(std::string& out, uint32_t line, uint32_t col);
+    void _setStyle(std::string& out, uint16_t style);
+
+    Cell& _back(uint32_t line, uint32_t col) {
+        return back_[(line - 1) * cols_ + (col - 1)];
+    }
+
+    Cell& _front(uint32_t line, uint32_t col) {
+        return front_[(line - 1) * cols_ + (col - 1)];
+    }
+
+private:
+    uint32_t lines_{ 0 };
+    uint32_t cols_{ 0 };
+    std::vector<Cell> back_;
+    std::vector<Cell> front_;
+    std::vector<std::string> styles_;   // styles_[0] is the default style
+    std::unordered_map<std::string, uint16_t> style_ids_;
+
+    // the position and the style of the terminal cursor
+    bool     cursor_known_{ false };
+    uint32_t cursor_line_{ 0 };
+    uint32_t cursor_col_{ 0 };
+    uint16_t cursor_style_{ 0 };
+};
+
+} // end namespace leaf
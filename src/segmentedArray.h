@@ -0,0 +1,338 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <type_traits>
+#include "span.h"
+
+namespace leaf
+{
+
+template <typename T, typename Container>
+class SegmentedArrayIterator final
+{
+public:
+    using self = SegmentedArrayIterator<T, Container>;
+    using reference = std::conditional_t<std::is_const<Container>::value, const T&, T&>;
+    using pointer = std::conditional_t<std::is_const<Container>::value, const T*, T*>;
+    using size_type = size_t;
+
+    SegmentedArrayIterator() = default;
+
+    explicit SegmentedArrayIterator(Container* array, size_type cur)
+        : array_(array), current_(cur) {}
+
+    bool operator==(const self& x) const noexcept {
+        return current_ == x.current_;
+    }
+
+    bool operator!=(const self& x) const noexcept {
+        return current_ != x.current_;
+    }
+
+    bool operator==(std::nullptr_t) const noexcept {
+        return array_ == nullptr;
+    }
+
+    bool operator!=(std::nullptr_t) const noexcept {
+        return array_ != nullptr;
+    }
+
+    bool operator<(const self& x) const noexcept {
+        return current_ < x.current_;
+    }
+
+    size_type operator-(const self& x) const noexcept {
+        return current_ - x.current_;
+    }
+
+    reference operator*() const noexcept {
+        return (*array_)[current_];
+    }
+
+    pointer operator->() const noexcept {
+        return &(*array_)[current_];
+    }
+
+    self& operator++() noexcept {
+        ++current_;
+        return *this;
+    }
+
+    self operator++(int) noexcept {
+        self tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    self operator+(size_type n) const noexcept {
+        return self(array_, current_ + n);
+    }
+
+    self operator-(size_type n) const noexcept {
+        return self(array_, current_ - n);
+    }
+
+    size_type current() const noexcept {
+        return current_;
+    }
+
+private:
+    Container* array_{ nullptr };
+    size_type current_{ 0 };
+};
+
+/**
+ * An array made up of fixed-size blocks of 2^BlockBits elements.
+ * Growing the array only allocates a new block, existing elements are never
+ * copied or moved, so their addresses are stable.
+ *
+ * There is one writer and any number of readers. The writer appends elements and
+ * makes them visible by publish(); readers see the elements through a Snapshot,
+ * which pins the directory of blocks and the size at the time it was taken.
+ * The directory is copied when a block is added or elements are popped, so the
+ * directory and the blocks a Snapshot holds are never modified, and they are freed
+ * when the last Snapshot holding them is gone.
+ *
+ * The writer can pop the oldest elements, e.g., to keep a sliding window of a stream,
+ * the elements are indexed from the first one not popped.
+ */
+template <typename T, uint32_t BlockBits=16>
+class SegmentedArray
+{
+public:
+    using size_type = size_t;
+
+    static constexpr size_type block_size = static_cast<size_type>(1) << BlockBits;
+    static constexpr size_type block_mask = block_size - 1;
+
+private:
+    using Block = std::shared_ptr<T>;
+    struct Directory
+    {
+        size_type          first{ 0 };          // the elements before first have been popped
+        size_type          first_block{ 0 };    // blocks[0] is the block first_block of the array
+        std::vector<Block> blocks;
+
+        const T& at(size_type n) const noexcept {
+            return blocks[(n >> BlockBits) - first_block].get()[n & block_mask];
+        }
+    };
+    using DirectoryPtr = std::shared_ptr<const Directory>;
+
+public:
+    class Snapshot
+    {
+    public:
+        using const_iterator = SegmentedArrayIterator<T, const Snapshot>;
+        using const_reference = const T&;
+
+        Snapshot() = default;
+
+        // end is the number of elements pushed, including the popped ones
+        Snapshot(DirectoryPtr directory, size_type end, uint64_t epoch)
+            : directory_(std::move(directory)),
+              first_(std::min(directory_->first, end)),
+              size_(end - first_),
+              epoch_(epoch) {}
+
+        size_type size() const noexcept {
+            return size_;
+        }
+
+        // the number of elements popped before the snapshot was taken
+        size_type first() const noexcept {
+            return first_;
+        }
+
+        bool empty() const noexcept {
+            return size_ == 0;
+        }
+
+        // the number of publish() calls before the snapshot was taken
+        uint64_t epoch() const noexcept {
+            return epoch_;
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator cbegin() const noexcept {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(this, size_);
+        }
+
+        const_iterator cend() const noexcept {
+            return const_iterator(this, size_);
+        }
+
+        const_reference operator[](size_type n) const noexcept {
+            return directory_->at(first_ + n);
+        }
+
+        /**
+         * Returns the elements in [first, last) as contiguous spans, one per block.
+         */
+        SpanList<T> spans(size_type first, size_type last) const {
+            SpanList<T> res;
+            if ( first >= last ) {
+                return res;
+            }
+
+            first += first_;
+            last += first_;
+            res.reserve(((last - 1) >> BlockBits) - (first >> BlockBits) + 1);
+            while ( first < last ) {
+                auto len = std::min(block_size - (first & block_mask), last - first);
+                res.push_back({ &directory_->at(first), len });
+                first += len;
+            }
+
+            return res;
+        }
+
+    private:
+        DirectoryPtr directory_;
+        size_type    first_{ 0 };
+        size_type    size_{ 0 };
+        uint64_t     epoch_{ 0 };
+    };
+
+    SegmentedArray() : directory_(std::make_shared<Directory>()), published_(directory_) {
+        static_assert(std::is_trivial<T>::value && std::is_standard_layout<T>::value,
+                      "Must be POD!");
+    }
+
+    SegmentedArray(const SegmentedArray&) = delete;
+    SegmentedArray& operator=(const SegmentedArray&) = delete;
+    SegmentedArray(SegmentedArray&&) = delete;
+    SegmentedArray& operator=(SegmentedArray&&) = delete;
+
+    /**
+     * Returns the number of published elements, can be called by any thread.
+     */
+    size_type size() const noexcept {
+        return published_size_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    /**
+     * Returns a snapshot of the published elements, can be called by any thread.
+     */
+    Snapshot snapshot() const {
+        // the directory is published before the end, so it covers the end,
+        // a newer directory may have popped the elements up to the end
+        auto end = published_end_.load(std::memory_order_acquire);
+        auto epoch = epoch_.load(std::memory_order_acquire);
+        return Snapshot(std::atomic_load(&published_), end, epoch);
+    }
+
+    /**
+     * Appends an element, it is invisible to readers until publish() is called.
+     * Should be called by the writer only.
+     */
+    void push_back(const T& data) {
+        if ( end_ == ((directory_->first_block + directory_->blocks.size()) << BlockBits) ) {
+            auto directory = std::make_shared<Directory>(*directory_);
+            directory->blocks.emplace_back(new T[block_size], std::default_delete<T[]>());
+            directory_ = std::move(directory);
+        }
+        directory_->blocks.back().get()[end_ & block_mask] = data;
+        ++end_;
+    }
+
+    /**
+     * Removes the first count elements, they are visible to readers until publish()
+     * is called. The blocks left empty are freed when no Snapshot holds them.
+     * Should be called by the writer only.
+     */
+    void pop_front(size_type count) {
+        count = std::min(count, end_ - directory_->first);
+        if ( count == 0 ) {
+            return;
+        }
+
+        auto directory = std::make_shared<Directory>(*directory_);
+        directory->first += count;
+        auto popped = std::min((directory->first >> BlockBits) - directory->first_block,
+                               directory->blocks.size());
+        directory->blocks.erase(directory->blocks.begin(), directory->blocks.begin() + popped);
+        directory->first_block += popped;
+        directory_ = std::move(directory);
+    }
+
+    /**
+     * The number of elements of the writer, including the ones not published yet.
+     * Should be called by the writer only.
+     */
+    size_type writerSize() const noexcept {
+        return end_ - directory_->first;
+    }
+
+    /**
+     * The element n of the writer, including the ones not published yet.
+     * Should be called by the writer only.
+     */
+    const T& writerAt(size_type n) const noexcept {
+        return directory_->at(directory_->first + n);
+    }
+
+    /**
+     * The element n of the writer, to be updated in place. A reader sees the update of
+     * a published element only if both access it atomically.
+     * Should be called by the writer only.
+     */
+    T& writerAt(size_type n) noexcept {
+        return const_cast<T&>(directory_->at(directory_->first + n));
+    }
+
+    /**
+     * Makes the elements appended so far visible to readers.
+     * Should be called by the writer only.
+     */
+    void publish() {
+        if ( std::atomic_load(&published_) != directory_ ) {
+            std::atomic_store(&published_, DirectoryPtr(directory_));
+        }
+        published_size_.store(end_ - directory_->first, std::memory_order_release);
+        published_end_.store(end_, std::memory_order_release);
+        epoch_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Removes all elements and publishes the empty array, the blocks are freed
+     * when no Snapshot holds them. Should be called by the writer only.
+     */
+    void clear() {
+        directory_ = std::make_shared<Directory>();
+        end_ = 0;
+        publish();
+    }
+
+    size_type blockCount() const noexcept {
+        return directory_->blocks.size();
+    }
+
+private:
+    std::shared_ptr<Directory> directory_;  // the writer's directory
+    DirectoryPtr               published_;  // accessed by std::atomic_load/atomic_store
+    size_type                  end_{ 0 };   // the writer's number of elements pushed
+    std::atomic<size_type>     published_size_{ 0 };    // excluding the popped elements
+    std::atomic<size_type>     published_end_{ 0 };
+    std::atomic<uint64_t>      epoch_{ 0 };
+
+};
+
+} // end namespace leaf
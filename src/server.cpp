@@ -0,0 +1,307 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include "server.h"
+#include "configManager.h"
+#include "error.h"
+#include "utils.h"
+
+namespace leaf
+{
+
+constexpr uint32_t Server::ReadLen;
+constexpr uint32_t Server::SpanCount;
+
+Server::Server(const std::string& socket_path, uint32_t thread_count)
+    : socket_path_(socket_path),
+    thread_count_(thread_count),
+    fuzzy_engine_(thread_count, ConfigManager::getInstance().getConfigValue<ConfigType::HugePage>()),
+    preference_(ConfigManager::getInstance().getConfigValue<ConfigType::SortPreference>())
+{
+    // the top lines are highlighted without being matched again
+    fuzzy_engine_.setSpanCount(SpanCount);
+}
+
+Server::~Server() {
+    file_walker_.reset();
+    for ( const auto& input : inputs_ ) {
+        close(input.first);
+    }
+    if ( listen_fd_ != -1 ) {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+    }
+}
+
+void Server::start() {
+    sigset_t sig_set;
+    sigemptyset(&sig_set);
+    sigaddset(&sig_set, SIGINT);
+    sigaddset(&sig_set, SIGQUIT);
+    sigaddset(&sig_set, SIGTERM);
+    loop_.addSignals(sig_set, [this](int) { loop_.stop(); });
+
+    _listen();
+    _loadData();
+    loop_.run();
+}
+
+void Server::_listen() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ( socket_path_.length() >= sizeof(addr.sun_path) ) {
+        Error::getInstance().appendError(utils::strFormat("%s: the path of the socket is too long",
+                                                          socket_path_.c_str()));
+        std::exit(EXIT_FAILURE);
+    }
+    memcpy(addr.sun_path, socket_path_.c_str(), socket_path_.length());
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ( fd == -1 ) {
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+
+    // a socket left by a server that has gone is replaced, the one of a running server is not
+    struct stat st;
+    if ( lstat(socket_path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) ) {
+        if ( connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0 ) {
+            Error::getInstance().appendError(utils::strFormat("%s: another server is listening",
+                                                              socket_path_.c_str()));
+            std::exit(EXIT_FAILURE);
+        }
+        close(fd);
+        unlink(socket_path_.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if ( fd == -1 ) {
+            Error::getInstance().appendError(ErrorMessage);
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if ( bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1
+         || listen(fd, SOMAXCONN) == -1 ) {
+        Error::getInstance().appendError(utils::strFormat("%s: %s", socket_path_.c_str(), strerror(errno)));
+        std::exit(EXIT_FAILURE);
+    }
+    listen_fd_ = fd;
+}
+
+void Server::_loadData() {
+    const auto& index_file = ConfigManager::getInstance().getConfigValue<ConfigType::Index>();
+    if ( !index_file.empty() ) {
+        std::string error;
+        line_index_.reset(new LineIndex);
+        if ( !line_index_->load(index_file, error) ) {
+            Error::getInstance().appendError(std::move(error));
+            std::exit(EXIT_FAILURE);
+        }
+
+        auto data = line_index_->data();
+        auto offsets = line_index_->offsets();
+        auto lengths = line_index_->lengths();
+        for ( uint64_t i = 0; i < line_index_->size(); ++i ) {
+            content_.push_back(makeConstString(data + offsets[i], lengths[i]));
+        }
+        _serve();
+        return;
+    }
+
+    if ( isatty(STDIN_FILENO) ) {
+        // the files under the current directory
+        file_walker_.reset(new FileWalker(thread_count_,
+            [this](std::unique_ptr<char[]>&& data, uint32_t len) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                _addLines(data.get(), len);
+                buffers_.emplace_back(std::move(data));
+            },
+            [this] {
+                loop_.post([this] { _serve(); });
+            }));
+        auto& config = ConfigManager::getInstance();
+        auto no_ignore = config.getConfigValue<ConfigType::NoIgnore>();
+        file_walker_->setIgnoreFiles(!no_ignore);
+        if ( !config.getConfigValue<ConfigType::NoCache>() ) {
+            file_walker_->setCacheFile(FileCache::defaultPath(".", no_ignore ? ".all" : ".files"));
+        }
+        file_walker_->start();
+        return;
+    }
+
+    _readStdin();
+    _serve();
+}
+
+// the whole input is read into a single buffer, so that no line straddles two buffers
+void Server::_readStdin() {
+    uint64_t capacity = ReadLen;
+    uint64_t size = 0;
+    std::unique_ptr<char[]> data(new char[capacity]);
+    for ( ; ; ) {
+        if ( size == capacity ) {
+            capacity *= 2;
+            std::unique_ptr<char[]> new_data(new char[capacity]);
+            memcpy(new_data.get(), data.get(), size);
+            data = std::move(new_data);
+        }
+
+        auto len = read(STDIN_FILENO, data.get() + size, capacity - size);
+        if ( len < 0 ) {
+            if ( errno == EINTR || errno == EAGAIN ) {
+                continue;
+            }
+            Error::getInstance().appendError(ErrorMessage);
+            std::exit(EXIT_FAILURE);
+        }
+        else if ( len == 0 ) {
+            break;
+        }
+        size += len;
+    }
+
+    _addLines(data.get(), size);
+    buffers_.emplace_back(std::move(data));
+}
+
+// the signatures are computed once, so that a query skips the lines it cannot match
+void Server::_addLines(const char* data, uint64_t len) {
+    utils::forEachLine(data, len, [this, data](uint64_t offset, uint64_t line_len) {
+        content_.push_back(makeConstString(data + offset, line_len));
+        signatures_.push_back(FuzzyMatch::getSignature(data + offset, line_len));
+    });
+}
+
+// in the loop thread, all the lines have been read
+void Server::_serve() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        content_.publish();
+    }
+    loop_.addReader(listen_fd_, [this] { _accept(); });
+}
+
+void Server::_accept() {
+    auto fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if ( fd == -1 ) {
+        return;
+    }
+
+    // a client that does not read its replies is dropped instead of blocking the others
+    struct timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    inputs_[fd];
+    loop_.addReader(fd, [this, fd] { _receive(fd); });
+}
+
+void Server::_receive(int fd) {
+    char buffer[16 * 1024];
+    auto len = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if ( len < 0 && (errno == EINTR || errno == EAGAIN) ) {
+        return;
+    }
+    else if ( len <= 0 ) {
+        _close(fd);
+        return;
+    }
+
+    auto& input = inputs_[fd];
+    input.append(buffer, len);
+    size_t pos = 0;
+    QueryHeader query;
+    while ( input.length() - pos >= sizeof(query) ) {
+        memcpy(&query, input.data() + pos, sizeof(query));
+        if ( query.pattern_len > MaxPatternLen ) {
+            _close(fd);
+            return;
+        }
+        if ( input.length() - pos - sizeof(query) < query.pattern_len ) {
+            break;
+        }
+
+        std::string pattern(input, pos + sizeof(query), query.pattern_len);
+        pos += sizeof(query) + query.pattern_len;
+        if ( !_answer(fd, pattern, query.top) ) {
+            _close(fd);
+            return;
+        }
+    }
+    input.erase(0, pos);
+}
+
+bool Server::_answer(int fd, const std::string& pattern, uint32_t top) {
+    auto corpus = content_.snapshot();
+    ReplyHeader header;
+    header.total = corpus.size();
+
+    std::vector<StrType> strs;
+    std::vector<weight_t> weights;
+    HighlightList highlights;
+    if ( pattern.empty() ) {
+        header.match_count = corpus.size();
+        header.line_count = std::min(top, header.match_count);
+        for ( const auto& span : corpus.spans(0, header.line_count) ) {
+            strs.insert(strs.end(), span.data, span.data + span.size);
+        }
+        weights.resize(header.line_count, 0);
+    }
+    else {
+        // only the top lines are sorted and copied
+        auto signatures = line_index_ ? line_index_->signatures() : signatures_.data();
+        top_.resize(std::min(static_cast<size_t>(top), corpus.size()));
+        header.line_count = fuzzy_engine_.topMatch(corpus.spans(0, corpus.size()), pattern, preference_,
+                                                   top_.data(), top_.size(), header.match_count,
+                                                   nullptr, signatures);
+        strs.reserve(header.line_count);
+        weights.reserve(header.line_count);
+        for ( uint32_t i = 0; i < header.line_count; ++i ) {
+            strs.push_back(corpus[top_[i].index]);
+            weights.push_back(top_[i].weight);
+        }
+        highlights = fuzzy_engine_.getHighlights(strs.data(), strs.size(), pattern);
+    }
+
+    std::string reply;
+    reply.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for ( uint32_t i = 0; i < header.line_count; ++i ) {
+        ReplyLine line;
+        line.weight = weights[i];
+        line.len = strs[i].len;
+        line.position_count = i < highlights.size() && highlights[i] ? highlights[i]->end_index : 0;
+        line.reserved = 0;
+        reply.append(reinterpret_cast<const char*>(&line), sizeof(line));
+        reply.append(strs[i].str, strs[i].len);
+        if ( line.position_count > 0 ) {
+            reply.append(reinterpret_cast<const char*>(highlights[i]->positions),
+                         sizeof(HighlightPos) * line.position_count);
+        }
+    }
+
+    size_t sent = 0;
+    while ( sent < reply.length() ) {
+        auto len = send(fd, reply.data() + sent, reply.length() - sent, MSG_NOSIGNAL);
+        if ( len < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            return false;
+        }
+        sent += len;
+    }
+
+    return true;
+}
+
+void Server::_close(int fd) {
+    loop_.removeReader(fd);
+    inputs_.erase(fd);
+    close(fd);
+}
+
+} // end namespace leaf
@@ -0,0 +1,70 @@
+_Pragma("once");
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "eventLoop.h"
+#include "fileWalker.h"
+#include "lineIndex.h"
+#include "fuzzyEngine.h"
+#include "segmentedArray.h"
+#include "protocol.h"
+
+namespace leaf
+{
+
+/**
+ * Reads the lines once, as yy does, and keeps them in memory together with the
+ * FuzzyEngine and its threads, then answers the queries of the clients connected to
+ * a Unix domain socket, see protocol.h.
+ * The socket is listened on before the lines are read, the queries sent meanwhile
+ * are answered once all the lines have been read.
+ */
+class Server
+{
+public:
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    Server(const std::string& socket_path, uint32_t thread_count);
+    ~Server();
+
+    // serves until SIGINT, SIGQUIT or SIGTERM
+    void start();
+
+private:
+    static constexpr uint32_t ReadLen = 1 << 20;
+    static constexpr uint32_t SpanCount = 1024;
+
+    void _listen();
+    void _loadData();
+    void _readStdin();
+    void _addLines(const char* data, uint64_t len);
+    void _serve();
+    void _accept();
+    void _receive(int fd);
+    bool _answer(int fd, const std::string& pattern, uint32_t top);
+    void _close(int fd);
+
+private:
+    std::string socket_path_;
+    uint32_t    thread_count_;
+    int         listen_fd_{ -1 };
+    EventLoop   loop_;
+    SegmentedArray<StrType> content_;
+    std::vector<uint64_t>   signatures_;    // of content_, unless it is built from line_index_
+    std::vector<std::unique_ptr<char[]>> buffers_;  // the lines of content_ point into them
+    std::mutex  mutex_;                     // guards content_ while the files are listed
+    std::unique_ptr<LineIndex>  line_index_;
+    std::unique_ptr<FileWalker> file_walker_;
+    std::unordered_map<int, std::string> inputs_;  // the incomplete queries of each client
+    FuzzyEngine fuzzy_engine_;
+    Preference  preference_;
+    std::vector<MatchResult> top_;          // the top lines of a query, reused by the next
+};
+
+} // end namespace leaf
@@ -0,0 +1,30 @@
+_Pragma("once");
+
+#include <cstddef>
+#include <vector>
+
+namespace leaf
+{
+
+/**
+ * A contiguous range of elements, [data, data + size).
+ */
+template <typename T>
+struct Span
+{
+    T*     data;
+    size_t size;
+
+    T* begin() const noexcept {
+        return data;
+    }
+
+    T* end() const noexcept {
+        return data + size;
+    }
+};
+
+template <typename T>
+using SpanList = std::vector<Span<const T>>;
+
+} // end namespace leaf
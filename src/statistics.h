@@ -0,0 +1,34 @@
+_Pragma("once");
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include "singleton.h"
+
+namespace leaf
+{
+
+/**
+ * Messages printed to stderr on exit, after the terminal is restored.
+ */
+class Statistics final : public Singleton<Statistics>
+{
+    friend Singleton<Statistics>;
+public:
+    void append(std::string&& msg) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        msgs_.emplace_back(std::move(msg));
+    }
+
+    ~Statistics() {
+        for ( const auto& msg : msgs_ ) {
+            fprintf(stderr, "%s\r\n", msg.c_str());
+        }
+    }
+private:
+    std::mutex mutex_;
+    std::vector<std::string> msgs_;
+};
+
+} // end namespace leaf
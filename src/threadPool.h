@@ -4,6 +4,8 @@ _Pragma("once");
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "queue.h"
 
 namespace leaf
@@ -98,4 +100,39 @@ private:
 
 };
 
+/**
+ * Counts the tasks of a group enqueued to a ThreadPool, so that the group can be
+ * waited for without waiting for the other tasks of the pool.
+ */
+class TaskGroup
+{
+public:
+    // called before the task is enqueued
+    void add() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++unfinished_tasks_;
+    }
+
+    // called by the task when it has run
+    void done() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ( --unfinished_tasks_ == 0 ) {
+            task_cond_.notify_all();
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while ( unfinished_tasks_ > 0 ) {
+            task_cond_.wait(lock);
+        }
+    }
+
+private:
+    uint32_t unfinished_tasks_{ 0 };
+    std::mutex mutex_;
+    std::condition_variable task_cond_;
+
+};
+
 } // end namespace leaf
@@ -3,6 +3,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <cstdarg>
+#include <cerrno>
 #include <regex>
 #include <chrono>
 #include "tty.h"
@@ -83,6 +87,7 @@ Tty::Tty(): color_names_ {
 }
 
 Tty::~Tty() {
+    flush();
     restoreOrigTerminal();
     fclose(stdin_);
     fclose(stdout_);
@@ -102,6 +107,7 @@ void Tty::_init() {
         std::exit(EXIT_FAILURE);
     }
     term_stdout_ = fileno(stdout_);
+    out_.reserve(1 << 16);
 
     if ( tcgetattr(term_stdin_, &orig_term_) == -1 ) {
         Error::getInstance().appendError(ErrorMessage);
@@ -425,140 +431,88 @@ void Tty::setNewTerminal() {
     }
 }
 
-enum class KeyType
-{
-    Empty,
-    Char,
-    Control,
-    EscCode
-};
-
 std::tuple<Key, std::string> Tty::getchar() {
-    static char left_char = -1;
-    static char last_char = -1;
-    static KeyType last_type = KeyType::Empty;
+    while ( running_.load(std::memory_order_relaxed) ) {
+        std::tuple<Key, std::string> key;
+        if ( nextKey(key) ) {
+            return key;
+        }
 
-    std::string esc_code;
-    if ( left_char == '\033' ) {
-        esc_code.push_back(left_char);
+        if ( _readInput(InputTimeout) == 0 ) {
+            input_parser_.timeout();
+        }
     }
-    else if ( std::iscntrl(left_char) ) {
-        auto key = left_char;
-        left_char = -1;
-        last_type = KeyType::Control;
-        return std::make_tuple(static_cast<Key>(key), std::string());
+
+    return std::make_tuple(Key::Exit, std::string());
+
+}
+
+bool Tty::nextKey(std::tuple<Key, std::string>& key) {
+    if ( !keys_.empty() ) {
+        key = std::move(keys_.front());
+        keys_.pop_front();
+        return true;
     }
 
-    bool has_esc = left_char == '\033';
-    while ( running_.load(std::memory_order_relaxed) ) {
-        char ch;
-        auto n = read(term_stdin_, &ch, 1);
-        if ( n > 0 ) {
-            bool is_same = ch == last_char;
-            bool valid = last_char != -1;
-            last_char = ch;
-            left_char = -1;
-            if ( !has_esc ) {
-                if ( std::iscntrl(ch) ) {
-                    if ( last_type == KeyType::Char || ( valid && !is_same ) ) {
-                        last_type = KeyType::Empty;
-                        left_char = ch;
-                        return std::make_tuple(Key::Timeout, std::string(1, ch));
-                    }
-
-                    if ( ch == '\033' ) {
-                        has_esc = true;
-                        esc_code.push_back(ch);
-                    }
-                    else {
-                        last_type = KeyType::Control;
-                        return std::make_tuple(static_cast<Key>(ch), std::string());
-                    }
-                }
-                else {
-                    last_type = KeyType::Char;
-                    return std::make_tuple(Key::Char, std::string(1, ch));
-                }
-            }
-            else {
-                if ( std::iscntrl(ch) ) {
-                    left_char = ch;
-                    if ( esc_code.length() == 1 ) { // e.g. \033\033
-                        last_type = KeyType::Control;
-                        return std::make_tuple(Key::ESC, std::string());
-                    }
-                    else { // e.g. \033[A\033[B
-                        last_type = KeyType::EscCode;
-                        auto iter = esc_codes_.find(esc_code);
-                        if ( iter != esc_codes_.end() ) {
-                            return std::make_tuple(iter->second, std::move(esc_code));
-                        }
-                        else {
-                            auto k = Key::Unknown;
-                            auto xy = _mouseTracking(esc_code, k);
-                            if ( k != Key::Unknown ) {
-                                return std::make_tuple(k, std::move(xy));
-                            }
-                            else {
-                                _getCursorPos(esc_code);
-                                return std::make_tuple(Key::Unknown, std::string());
-                            }
-                        }
-                    }
-                }
-                else {
-                    esc_code.push_back(ch);
-                    auto k = Key::Unknown;
-                    auto xy = _mouseTracking(esc_code, k);
-                    if ( k != Key::Unknown ) {
-                        return std::make_tuple(k, std::move(xy));
-                    }
-                    if ( _getCursorPos(esc_code) ) {
-                        return std::make_tuple(Key::Unknown, std::string());
-                    }
-                }
-            }
+    return _takeKey(key);
+}
+
+bool Tty::_takeKey(std::tuple<Key, std::string>& key) {
+    while ( !input_parser_.empty() ) {
+        key = input_parser_.pop();
+        if ( std::get<0>(key) != Key::Unknown ) {
+            return true;
         }
-        else if ( n == 0 ) { // time out
-            last_char = -1;
-            left_char = -1;
-            if ( !esc_code.empty() ) {
-                if ( esc_code.length() == 1 ) {
-                    last_type = KeyType::Control;
-                    return std::make_tuple(Key::ESC, std::string());
-                }
-                else { // e.g. \033[A
-                    last_type = KeyType::EscCode;
-                    auto iter = esc_codes_.find(esc_code);
-                    if ( iter != esc_codes_.end() ) {
-                        return std::make_tuple(iter->second, std::move(esc_code));
-                    }
-                    else {
-                        auto k = Key::Unknown;
-                        auto xy = _mouseTracking(esc_code, k);
-                        if ( k != Key::Unknown ) {
-                            return std::make_tuple(k, std::move(xy));
-                        }
-                        else {
-                            _getCursorPos(esc_code);
-                            return std::make_tuple(Key::Unknown, std::string());
-                        }
-                    }
-                }
-            }
-            else if ( last_type != KeyType::Empty ) {
-                last_type = KeyType::Empty;
-                return std::make_tuple(Key::Timeout, std::string());
-            }
+
+        auto& esc_code = std::get<1>(key);
+        auto k = Key::Unknown;
+        auto xy = _mouseTracking(esc_code, k);
+        if ( k != Key::Unknown ) {
+            key = std::make_tuple(k, std::move(xy));
+            return true;
+        }
+
+        if ( !_getCursorPos(esc_code) ) {
+            key = std::make_tuple(Key::Unknown, std::string());
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// all the input available is read at once, e.g., a paste
+// returns 0 if no input arrives in timeout ms, timeout == 0 means the input is readable
+ssize_t Tty::_readInput(int timeout) {
+    if ( timeout != 0 ) {
+        struct pollfd fds = { term_stdin_, POLLIN, 0 };
+        int ret = 0;
+        while ( (ret = poll(&fds, 1, timeout)) == -1 && errno == EINTR ) {
         }
-        else { // n < 0
+
+        if ( ret == -1 ) {
             Error::getInstance().appendError(ErrorMessage);
             std::exit(EXIT_FAILURE);
         }
+        else if ( ret == 0 ) {
+            return 0;
+        }
     }
 
-    return std::make_tuple(Key::Exit, std::string());
+    ssize_t n = 0;
+    while ( (n = read(term_stdin_, input_buffer_, sizeof(input_buffer_))) == -1 && errno == EINTR ) {
+    }
 
+    if ( n < 0 ) {
+        if ( errno == EAGAIN ) {
+            return 0;
+        }
+        Error::getInstance().appendError(ErrorMessage);
+        std::exit(EXIT_FAILURE);
+    }
+
+    input_parser_.feed(input_buffer_, n);
+    return n;
 }
 
 // https://invisible-island.net/xterm/ctlseqs/ctlseqs.html#h2-Mouse-Tracking
@@ -667,12 +621,136 @@ bool Tty::_getCursorPos(const std::string& esc_code) {
     if ( cursor_pos_ == true && std::regex_match(esc_code, sm, std::regex("\033\\[(\\d+);(\\d+)R")) ) {
         cursor_line_ = stoi(sm.str(1));
         cursor_col_ = stoi(sm.str(2));
-        std::lock_guard<std::mutex> lock(mutex_);
         cursor_pos_ = false;
-        cursor_cond_.notify_one();
         return true;
     }
     return false;
 }
 
+void Tty::initScreen(uint32_t lines, uint32_t cols) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    screen_.resize(lines, cols);
+    last_line_ = saved_line_ = 0;
+    last_col_ = saved_col_ = 0;
+    // the size of the terminal is unknown
+    screen_active_.store(screen_.active() && lines > 0, std::memory_order_relaxed);
+}
+
+void Tty::_putString(uint32_t line, uint32_t col, const char* str, const std::string& color, bool save) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    last_line_ = line;
+    last_col_ = screen_.put(line, col, str, strlen(str), color);
+    if ( save ) {
+        saved_line_ = last_line_;
+        saved_col_ = last_col_;
+    }
+}
+
+void Tty::addSegments(uint32_t line, uint32_t col, const Segment* segments, size_t n) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if ( screen_active_.load(std::memory_order_relaxed) ) {
+        static const std::string default_color;
+        for ( size_t i = 0; i < n; ++i ) {
+            const auto& seg = segments[i];
+            col = screen_.put(line, col, seg.str, seg.len,
+                              seg.color == nullptr ? default_color : *seg.color);
+        }
+        last_line_ = line;
+        last_col_ = col;
+        return;
+    }
+
+    char buffer[32];
+    auto len = snprintf(buffer, sizeof(buffer), "\033[%u;%uH", line, col);
+    out_.append(buffer, len);
+    for ( size_t i = 0; i < n; ++i ) {
+        const auto& seg = segments[i];
+        if ( seg.color != nullptr ) {
+            out_.append(*seg.color);
+            out_.append(seg.str, seg.len);
+            out_.append("\033[0m");
+        }
+        else {
+            out_.append(seg.str, seg.len);
+        }
+    }
+}
+
+void Tty::_renderScreen() {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if ( frame_depth_ > 0 ) {
+        return;
+    }
+
+    screen_.render(out_, saved_line_, saved_col_);
+    _flush();
+}
+
+void Tty::_print(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    auto n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if ( n < 0 ) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if ( static_cast<size_t>(n) < sizeof(buffer) ) {
+        out_.append(buffer, n);
+    }
+    else {
+        auto size = out_.size();
+        out_.resize(size + n + 1);
+        va_start(args, format);
+        vsnprintf(&out_[size], n + 1, format, args);
+        va_end(args);
+        out_.resize(size + n);
+    }
+}
+
+// output_mutex_ must be held
+void Tty::_flush() {
+    if ( out_.empty() ) {
+        return;
+    }
+
+    static const char begin_sync[] = "\033[?2026h";
+    static const char end_sync[] = "\033[?2026l";
+    struct iovec iov[3];
+    int iovcnt = 0;
+    if ( sync_update_ ) {
+        iov[iovcnt++] = { const_cast<char*>(begin_sync), sizeof(begin_sync) - 1 };
+    }
+    iov[iovcnt++] = { &out_[0], out_.size() };
+    if ( sync_update_ ) {
+        iov[iovcnt++] = { const_cast<char*>(end_sync), sizeof(end_sync) - 1 };
+    }
+
+    auto p_iov = iov;
+    while ( iovcnt > 0 ) {
+        auto n = writev(term_stdout_, p_iov, iovcnt);
+        if ( n < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            break;
+        }
+
+        // partial write
+        while ( iovcnt > 0 && static_cast<size_t>(n) >= p_iov->iov_len ) {
+            n -= p_iov->iov_len;
+            ++p_iov;
+            --iovcnt;
+        }
+        if ( iovcnt > 0 ) {
+            p_iov->iov_base = static_cast<char*>(p_iov->iov_base) + n;
+            p_iov->iov_len -= n;
+        }
+    }
+
+    out_.clear();
+}
+
 } // end namespace leaf
@@ -9,8 +9,10 @@ _Pragma("once");
 #include <atomic>
 #include <unordered_map>
 #include <mutex>
-#include <condition_variable>
+#include <deque>
 #include "singleton.h"
+#include "screen.h"
+#include "inputParser.h"
 #include "consts.h"
 
 
@@ -25,34 +27,59 @@ public:
 
     std::tuple<Key, std::string> getchar();
 
+    // for the event loop, readInput() is called when inputFd() is readable,
+    // and inputTimeout() when no input has arrived for InputTimeout ms,
+    // then the keys are taken by nextKey() until it returns false
+    static constexpr uint32_t InputTimeout = 100;
+
+    int inputFd() const noexcept {
+        return term_stdin_;
+    }
+
+    void readInput() {
+        _readInput(0);
+    }
+
+    void inputTimeout() {
+        input_parser_.timeout();
+    }
+
+    bool nextKey(std::tuple<Key, std::string>& key);
+
+    // the keys already read but not taken yet
+    bool hasPendingInput() const noexcept {
+        return !keys_.empty() || !input_parser_.empty();
+    }
+
     // Moves the cursor n (default 1) cells in the given direction.
     // If the cursor is already at the edge of the screen, this has no effect.
     void moveCursor(CursorDirection dirction, uint32_t n=1) {
+        _forgetCursor();
         switch ( dirction )
         {
         case CursorDirection::Up:
-            fprintf(stdout_, "\033[%uA", n);
+            _print("\033[%uA", n);
             break;
         case CursorDirection::Down:
-            fprintf(stdout_, "\033[%uB", n);
+            _print("\033[%uB", n);
             break;
         case CursorDirection::Right:
-            fprintf(stdout_, "\033[%uC", n);
+            _print("\033[%uC", n);
             break;
         case CursorDirection::Left:
-            fprintf(stdout_, "\033[%uD", n);
+            _print("\033[%uD", n);
             break;
         case CursorDirection::NextLine:
             // Moves cursor to beginning of the line n (default 1) lines down
-            fprintf(stdout_, "\033[%uE", n);
+            _print("\033[%uE", n);
             break;
         case CursorDirection::PrevLine:
             // Moves cursor to beginning of the line n (default 1) lines up
-            fprintf(stdout_, "\033[%uF", n);
+            _print("\033[%uF", n);
             break;
         case CursorDirection::HorizontalAbsolute:
             // Moves the cursor to column n (default 1)
-            fprintf(stdout_, "\033[%uG", n);
+            _print("\033[%uG", n);
             break;
         }
     }
@@ -60,32 +87,34 @@ public:
     // Moves the cursor to line n, column m.
     // The values are 1-based, and default to 1 (top left corner) if omitted.
     void moveCursorTo(uint32_t line=1, uint32_t column=1) {
-        fprintf(stdout_, "\033[%u;%uH", line, column);
+        _forgetCursor();
+        _print("\033[%u;%uH", line, column);
     }
 
     void clear(EraseMode e) {
+        _invalidateScreen();
         switch ( e )
         {
         case EraseMode::ToScreenEnd:
-            fprintf(stdout_, "\033[0J");
+            _print("\033[0J");
             break;
         case EraseMode::ToScreenBegin:
-            fprintf(stdout_, "\033[1J");
+            _print("\033[1J");
             break;
         case EraseMode::EntireScreen:
-            fprintf(stdout_, "\033[2J");
+            _print("\033[2J");
             break;
         case EraseMode::EntireScreenAndScroll:
-            fprintf(stdout_, "\033[3J");
+            _print("\033[3J");
             break;
         case EraseMode::ToLineEnd:
-            fprintf(stdout_, "\033[0K");
+            _print("\033[0K");
             break;
         case EraseMode::ToLineBegin:
-            fprintf(stdout_, "\033[1K");
+            _print("\033[1K");
             break;
         case EraseMode::EntireLine:
-            fprintf(stdout_, "\033[2K");
+            _print("\033[2K");
             break;
         }
     }
@@ -93,34 +122,75 @@ public:
     // Scroll whole page up by n (default 1) lines.
     // New lines are added at the bottom.
     void scrollUp(uint32_t n=1) {
-        fprintf(stdout_, "\033[%uS", n);
+        _invalidateScreen();
+        _print("\033[%uS", n);
     }
 
     // Scroll whole page down by n (default 1) lines.
     // New lines are added at the top.
     void scrollDown(uint32_t n=1) {
-        fprintf(stdout_, "\033[%uT", n);
+        _invalidateScreen();
+        _print("\033[%uT", n);
     }
 
+    /**
+     * Once the screen is initialized, strings written at a position go to the
+     * back buffer of the screen, and restoreCursorPosition() renders the
+     * changed cells and moves the cursor to the saved position.
+     */
+    void initScreen(uint32_t lines, uint32_t cols);
+
     void saveCursorPosition() {
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            saved_line_ = last_line_;
+            saved_col_ = last_col_;
+            return;
+        }
         //fprintf(stdout_, "\033[s");
-        fprintf(stdout_, "\0337");
+        _print("\0337");
     }
 
     void saveCursorPosition(uint32_t line, uint32_t col) {
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            saved_line_ = line;
+            saved_col_ = col;
+            return;
+        }
         //fprintf(stdout_, "\033[%u;%uH\033[s", line, col);
-        fprintf(stdout_, "\033[%u;%uH\0337", line, col);
+        _print("\033[%u;%uH\0337", line, col);
     }
 
     void restoreCursorPosition() {
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            _renderScreen();
+            return;
+        }
         //fprintf(stdout_, "\033[u");
-        fprintf(stdout_, "\0338");
-        fflush(stdout_);
+        _print("\0338");
+        flush();
+    }
+
+    /**
+     * Between beginFrame() and endFrame(), restoreCursorPosition() only updates
+     * the back buffer of the screen, endFrame() renders the frame.
+     */
+    void beginFrame() {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        ++frame_depth_;
+    }
+
+    void endFrame() {
+        {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            --frame_depth_;
+        }
+        _renderScreen();
     }
 
     void showCursor() {
-        fprintf(stdout_, "\033[?25h");
-        fflush(stdout_);
+        _print("\033[?25h");
     }
 
     void showCursor_s() {
@@ -128,15 +198,15 @@ public:
     }
 
     void hideCursor() {
-        fprintf(stdout_, "\033[?25l");
+        _print("\033[?25l");
     }
 
     void enableAlternativeBuffer() {
-        fprintf(stdout_, "\033[?1049h");
+        _print("\033[?1049h");
     }
 
     void disableAlternativeBuffer() {
-        fprintf(stdout_, "\033[?1049l");
+        _print("\033[?1049l");
     }
 
     void disableAlternativeBuffer_s() {
@@ -144,19 +214,32 @@ public:
     }
 
     void enableMouse() {
-        fprintf(stdout_, "\033[?1000;1006h");
+        _print("\033[?1000;1006h");
     }
 
     void disableMouse() {
-        fprintf(stdout_, "\033[?1000;1006l");
+        _print("\033[?1000;1006l");
     }
 
     void disableMouse_s() {
         write(term_stdout_, "\033[?1000;1006l", strlen("\033[?1000;1006l"));
     }
 
+    // a paste is enclosed in \033[200~ and \033[201~
+    void enableBracketedPaste() {
+        _print("\033[?2004h");
+    }
+
+    void disableBracketedPaste() {
+        _print("\033[?2004l");
+    }
+
+    void disableBracketedPaste_s() {
+        write(term_stdout_, "\033[?2004l", strlen("\033[?2004l"));
+    }
+
     void enableAutoWrap() {
-        fprintf(stdout_, "\033[?7h");
+        _print("\033[?7h");
     }
 
     void enableAutoWrap_s() {
@@ -164,18 +247,18 @@ public:
     }
 
     void disableAutoWrap() {
-        fprintf(stdout_, "\033[?7l");
+        _print("\033[?7l");
     }
 
     // color is 0 - 255 or #000000 - #FFFFFF
     void setForegroundColor(const std::string& color) {
         if ( color[0] == '#' ) {
-            fprintf(stdout_, "\033]10;%s\a", color.c_str());
+            _print("\033]10;%s\a", color.c_str());
         }
         else {
             auto index = stoi(color);
             if ( index >= 0 && index < 256 ) {
-                fprintf(stdout_, "\033]10;%s\a", color_names_[index]);
+                _print("\033]10;%s\a", color_names_[index]);
             }
             else {
             }
@@ -185,12 +268,12 @@ public:
     // color is 0 - 255 or #000000 - #FFFFFF
     void setBackgroundColor(const std::string& color) {
         if ( color[0] == '#' ) {
-            fprintf(stdout_, "\033]11;%s\a", color.c_str());
+            _print("\033]11;%s\a", color.c_str());
         }
         else {
             auto index = stoi(color);
             if ( index >= 0 && index < 256 ) {
-                fprintf(stdout_, "\033]11;%s\a", color_names_[index]);
+                _print("\033]11;%s\a", color_names_[index]);
             }
             else {
             }
@@ -198,15 +281,23 @@ public:
     }
 
     void resetForegroundColor() {
-        fprintf(stdout_, "\033]110\a");
+        _print("\033]110\a");
     }
 
     void resetBackgroundColor() {
-        fprintf(stdout_, "\033]111\a");
+        _print("\033]111\a");
     }
 
+    // writes the buffered output to the terminal
     void flush() {
-        fflush(stdout_);
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        _flush();
+    }
+
+    // wraps each flush in synchronized update escape sequences,
+    // so that the terminal renders the frame at once
+    void setSyncUpdate(bool sync_update) {
+        sync_update_ = sync_update;
     }
 
     int getCursorPosition(uint32_t& line, uint32_t& col) {
@@ -236,6 +327,7 @@ public:
         return 0;
     }
 
+    // the keys read while waiting for the report are kept for nextKey()
     int getCursorPosition2(uint32_t& line, uint32_t& col) {
         cursor_pos_ = true;
         if ( write(term_stdout_, "\033[6n", 4) != 4 ) {
@@ -243,9 +335,15 @@ public:
             return -1;
         }
 
-        std::unique_lock<std::mutex> lock(mutex_);
-        while ( cursor_pos_ == true ) {
-            cursor_cond_.wait(lock);
+        while ( cursor_pos_ ) {
+            std::tuple<Key, std::string> key;
+            if ( _takeKey(key) ) {
+                keys_.push_back(std::move(key));
+            }
+            else if ( input_parser_.empty() && _readInput(1000) <= 0 ) {
+                cursor_pos_ = false;
+                return -1;
+            }
         }
 
         line = cursor_line_;
@@ -257,11 +355,11 @@ public:
     int getWindowSize(uint32_t& lines, uint32_t& cols) {
         struct winsize ws;
         if (ioctl(term_stdout_, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
-            saveCursorPosition();
-            moveCursorTo(1024, 1024);
-            fflush(stdout_);
+            _print("\0337\033[1024;1024H");
+            flush();
             int ret = getCursorPosition(lines, cols);
-            restoreCursorPosition();
+            _print("\0338");
+            flush();
             return ret;
         }
         else {
@@ -274,11 +372,11 @@ public:
     int getWindowSize2(uint32_t& lines, uint32_t& cols) {
         struct winsize ws;
         if (ioctl(term_stdout_, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
-            saveCursorPosition();
-            moveCursorTo(1024, 1024);
-            fflush(stdout_);
+            _print("\0337\033[1024;1024H");
+            flush();
             int ret = getCursorPosition2(lines, cols);
-            restoreCursorPosition();
+            _print("\0338");
+            flush();
             return ret;
         }
         else {
@@ -308,37 +406,65 @@ public:
 
     template <typename T>
     void addString(T&& str) {
-        fprintf(stdout_, "%s", String::c_str(std::forward<T>(str)));
+        _forgetCursor();
+        _print("%s", String::c_str(std::forward<T>(str)));
     }
 
     template <typename T, typename C>
     void addString(T&& str, C&& color) {
         static_assert(std::is_same<std::decay_t<C>, std::string>::value, "color must be std::string!");
-        fprintf(stdout_, "%s%s\033[0m", color.c_str(), String::c_str(std::forward<T>(str)));
+        _forgetCursor();
+        _print("%s%s\033[0m", color.c_str(), String::c_str(std::forward<T>(str)));
     }
 
     template <typename T>
     void addString(uint32_t line, uint32_t col, T&& str) {
-        fprintf(stdout_, "\033[%u;%uH%s", line, col, String::c_str(std::forward<T>(str)));
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            _putString(line, col, String::c_str(std::forward<T>(str)), std::string(), false);
+            return;
+        }
+        _print("\033[%u;%uH%s", line, col, String::c_str(std::forward<T>(str)));
     }
 
     template <typename T, typename C>
     void addString(uint32_t line, uint32_t col, T&& str, C&& color) {
         static_assert(std::is_same<std::decay_t<C>, std::string>::value, "color must be std::string!");
-        fprintf(stdout_, "\033[%u;%uH%s%s\033[0m", line, col, color.c_str(), String::c_str(std::forward<T>(str)));
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            _putString(line, col, String::c_str(std::forward<T>(str)), color, false);
+            return;
+        }
+        _print("\033[%u;%uH%s%s\033[0m", line, col, color.c_str(), String::c_str(std::forward<T>(str)));
     }
 
+    struct Segment
+    {
+        const char*        str;
+        size_t             len;
+        const std::string* color;   // nullptr means the default color
+    };
+
+    // writes the segments one after another from (line, col)
+    void addSegments(uint32_t line, uint32_t col, const Segment* segments, size_t n);
+
     template <typename T>
     void addStringAndSave(uint32_t line, uint32_t col, T&& str) {
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            _putString(line, col, String::c_str(std::forward<T>(str)), std::string(), true);
+            return;
+        }
         //fprintf(stdout_, "\033[%u;%uH%s\033[s", line, col, String::c_str(std::forward<T>(str)));
-        fprintf(stdout_, "\033[%u;%uH%s\0337", line, col, String::c_str(std::forward<T>(str)));
+        _print("\033[%u;%uH%s\0337", line, col, String::c_str(std::forward<T>(str)));
     }
 
     template <typename T, typename C>
     void addStringAndSave(uint32_t line, uint32_t col, T&& str, C&& color) {
         static_assert(std::is_same<std::decay_t<C>, std::string>::value, "color must be std::string!");
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            _putString(line, col, String::c_str(std::forward<T>(str)), color, true);
+            return;
+        }
         //fprintf(stdout_, "\033[%u;%uH%s%s\033[0m\033[s", line, col, color.c_str(), String::c_str(std::forward<T>(str)));
-        fprintf(stdout_, "\033[%u;%uH%s%s\033[0m\0337", line, col, color.c_str(), String::c_str(std::forward<T>(str)));
+        _print("\033[%u;%uH%s%s\033[0m\0337", line, col, color.c_str(), String::c_str(std::forward<T>(str)));
     }
 
     void exit() {
@@ -353,6 +479,27 @@ private:
     void _init();
     std::string _mouseTracking(const std::string& esc_code, Key& key) const;
     bool _getCursorPos(const std::string& esc_code);
+    ssize_t _readInput(int timeout);
+    bool _takeKey(std::tuple<Key, std::string>& key);
+    void _print(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void _flush();
+    void _putString(uint32_t line, uint32_t col, const char* str, const std::string& color, bool save);
+    void _renderScreen();
+
+    void _forgetCursor() {
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            screen_.forgetCursor();
+        }
+    }
+
+    // the terminal has been erased or scrolled
+    void _invalidateScreen() {
+        if ( screen_active_.load(std::memory_order_relaxed) ) {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            screen_.invalidate();
+        }
+    }
 private:
     int term_stdin_{ STDIN_FILENO };
     int term_stdout_{ STDOUT_FILENO };
@@ -361,15 +508,27 @@ private:
     const char* color_names_[256];
     struct termios orig_term_;
     struct termios new_term_;
-    using EscCodeMap = std::unordered_map<std::string, Key>;
+    using EscCodeMap = InputParser::EscCodeMap;
     EscCodeMap esc_codes_;
+    InputParser input_parser_{ esc_codes_ };
+    char input_buffer_[4096];
     std::atomic<bool> running_{ true };
+    std::deque<std::tuple<Key, std::string>> keys_;
     bool cursor_pos_{ false };
-    mutable std::mutex mutex_;
-    std::condition_variable cursor_cond_;
     uint32_t cursor_line_{ 0 };
     uint32_t cursor_col_{ 0 };
 
+    bool sync_update_{ false };
+    std::mutex output_mutex_;   // guards out_ and screen_
+    std::string out_;           // the output not flushed yet
+    uint32_t frame_depth_{ 0 };
+    std::atomic<bool> screen_active_{ false };
+    Screen screen_;
+    uint32_t last_line_{ 0 };   // the cursor position after the last string written
+    uint32_t last_col_{ 0 };
+    uint32_t saved_line_{ 0 };
+    uint32_t saved_col_{ 0 };
+
 };
 
 } // end namespace leaf
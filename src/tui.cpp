@@ -8,6 +8,13 @@ Window::Window(const Point& tl, const Point& br, const Colorscheme& cs)
     : cs_(cs)
 {
     _init(tl, br);
+    _fitView();
+
+    auto& cursor_line_color = cs_.getColor(HighlightGroup::CursorLine);
+    for ( uint32_t i = 0; i < cursorline_colors_.size(); ++i ) {
+        cursorline_colors_[i] = cursor_line_color + cs_.getColor(static_cast<HighlightGroup>(i));
+    }
+    cursorline_colors_[static_cast<uint32_t>(HighlightGroup::Normal)] = cursor_line_color;
 }
 
 void Window::_init(const Point& tl, const Point& br) {
@@ -23,18 +30,48 @@ void Window::_init(const Point& tl, const Point& br) {
     if ( is_reverse_ ) {
         core_top_left_.line += core_height_ - 1;
     }
+    blank_.assign(core_width_, ' ');
+}
+
+/**
+ * Keeps the cursor line in view after the window is resized.
+ * The cached rows are dropped only if they no longer fit the width.
+ */
+void Window::_fitView() {
+    // a few pages, so that scrolling back does not generate the rows again
+    auto capacity = std::max(4 * core_height_, 64u);
+    if ( core_width_ != rows_width_ || rows_.capacity() < capacity ) {
+        rows_.reset(capacity);
+        rows_width_ = core_width_;
+    }
+
+    if ( core_height_ == 0 ) {
+        return;
+    }
+
+    if ( cursor_line_ >= first_line_ + core_height_ ) {
+        first_line_ = cursor_line_ + 1 - core_height_;
+    }
+    else if ( size_ > core_height_ ) {
+        first_line_ = std::min(first_line_, size_ - core_height_);
+    }
+    else {
+        first_line_ = 0;
+    }
+    last_line_ = std::min(first_line_ + core_height_, size_);
 }
 
-void Window::setBuffer(Generator&& generator) {
-    generator_ = std::move(generator);
-    buffer_ = generator_();
+void Window::setBuffer(uint32_t size, RowSource&& source) {
+    size_ = size;
+    source_ = std::move(source);
+    rows_.clear();
 
     uint32_t orig_cursorline_y = core_top_left_.line + cursor_line_ - first_line_;
     if ( is_reverse_ ) {
         orig_cursorline_y = core_top_left_.line - (cursor_line_ - first_line_);
     }
     first_line_ = 0;
-    last_line_ = std::min(core_height_, static_cast<decltype(core_height_)>(buffer_.size()));
+    last_line_ = std::min(core_height_, size_);
     cursor_line_ = 0;
 
     _render(orig_cursorline_y);
@@ -49,6 +86,36 @@ void Window::setBuffer() {
     _render(orig_cursorline_y);
 }
 
+// the rows cached are still valid if no row is removed, only the rows that come into view are rendered
+void Window::appendBuffer(uint32_t size, RowSource&& source, uint32_t removed) {
+    size_ = size;
+    source_ = std::move(source);
+
+    uint32_t orig_cursorline_y = core_top_left_.line + cursor_line_ - first_line_;
+    if ( is_reverse_ ) {
+        orig_cursorline_y = core_top_left_.line - (cursor_line_ - first_line_);
+    }
+
+    if ( removed > 0 ) {
+        // the rows cached refer to the rows removed
+        rows_.clear();
+        first_line_ -= std::min(first_line_, removed);
+        cursor_line_ -= std::min(cursor_line_, removed);
+        last_line_ = std::min(first_line_ + core_height_, size_);
+        if ( cursor_line_ >= last_line_ ) {
+            cursor_line_ = last_line_ > 0 ? last_line_ - 1 : 0;
+        }
+        _render(orig_cursorline_y);
+        return;
+    }
+
+    auto last_line = std::min(first_line_ + core_height_, size_);
+    if ( last_line != last_line_ ) {
+        last_line_ = last_line;
+        _render(orig_cursorline_y);
+    }
+}
+
 void Window::_scrollUp() {
     if ( cursor_line_ > first_line_ ) {
         _updateCursorline(cursor_line_ - 1);
@@ -73,12 +140,7 @@ void Window::_scrollDown() {
         return;
     }
 
-    if ( buffer_.size() == last_line_ ) {
-        auto buffer = generator_();
-        buffer_.insert(buffer_.end(), buffer.begin(), buffer.end());
-    }
-
-    if ( buffer_.size() > last_line_ ) {
+    if ( size_ > last_line_ ) {
         uint32_t orig_cursorline_y = core_top_left_.line + cursor_line_ - first_line_;
         if ( is_reverse_ ) {
             orig_cursorline_y = core_top_left_.line - (cursor_line_ - first_line_);
@@ -106,7 +168,7 @@ void Window::_pageUp() {
     }
     else {
         first_line_ = 0;
-        last_line_ = std::min(core_height_, static_cast<decltype(core_height_)>(buffer_.size()));
+        last_line_ = std::min(core_height_, size_);
     }
 
     cursor_line_ = last_line_ - 1;
@@ -115,12 +177,7 @@ void Window::_pageUp() {
 
 
 void Window::_pageDown() {
-    if ( buffer_.size() < last_line_ + core_height_ ) {
-        auto buffer = generator_();
-        buffer_.insert(buffer_.end(), buffer.begin(), buffer.end());
-    }
-
-    if ( last_line_ == buffer_.size() ) { // no next page
+    if ( last_line_ == size_ ) { // no next page
         _updateCursorline(last_line_ - 1);
         return;
     }
@@ -130,16 +187,79 @@ void Window::_pageDown() {
         orig_cursorline_y = core_top_left_.line - (cursor_line_ - first_line_);
     }
     first_line_ = last_line_ - 1;
-    last_line_ = std::min(first_line_ + core_height_, static_cast<decltype(core_height_)>(buffer_.size()));
+    last_line_ = std::min(first_line_ + core_height_, size_);
 
     cursor_line_ = first_line_;
     _render(orig_cursorline_y);
 }
 
+void Window::jumpTo(uint32_t index) {
+    if ( size_ == 0 ) {
+        return;
+    }
+
+    index = std::min(index, size_ - 1);
+    if ( index >= first_line_ && index < last_line_ ) {
+        _updateCursorline(index);
+        return;
+    }
+
+    uint32_t orig_cursorline_y = core_top_left_.line + cursor_line_ - first_line_;
+    if ( is_reverse_ ) {
+        orig_cursorline_y = core_top_left_.line - (cursor_line_ - first_line_);
+    }
+    // the row is at the top of the window, unless it is on the last page
+    first_line_ = std::min(index, size_ - std::min(core_height_, size_));
+    last_line_ = std::min(first_line_ + core_height_, size_);
+
+    cursor_line_ = index;
+    _render(orig_cursorline_y);
+}
+
+// generates the rows in [first, last) that are not in the cache
+void Window::_fetchRows(uint32_t first, uint32_t last) {
+    auto i = first;
+    while ( i < last ) {
+        if ( rows_.contains(i) ) {
+            ++i;
+            continue;
+        }
+
+        auto j = i + 1;
+        while ( j < last && !rows_.contains(j) ) {
+            ++j;
+        }
+
+        auto rows = source_(i, j);
+        for ( auto& row : rows ) {
+            rows_.put(i++, std::move(row));
+        }
+        // the source has fewer rows than expected
+        if ( i < j ) {
+            break;
+        }
+    }
+}
+
+const AttributedLine& Window::_row(uint32_t index) {
+    auto row = rows_.get(index);
+    if ( row == nullptr ) {
+        _fetchRows(index, std::min(index + core_height_, size_));
+        row = rows_.get(index);
+    }
+
+    if ( row == nullptr ) {
+        static const AttributedLine empty(ConstString{ "", 0 }, 0, 0);
+        return empty;
+    }
+    return *row;
+}
+
 
 void Window::_render(uint32_t orig_cursorline_y) {
     auto& tty = Tty::getInstance();
     tty.hideCursor();
+    _fetchRows(first_line_, last_line_);
     if ( is_reverse_ ) {
         uint32_t new_cursorline_y = core_top_left_.line - (cursor_line_ - first_line_);
         uint32_t j = core_top_left_.line;
@@ -148,13 +268,12 @@ void Window::_render(uint32_t orig_cursorline_y) {
             if ( new_cursorline_y == orig_cursorline_y && new_cursorline_y == j ) {
                 continue;
             }
-            int32_t space_len = core_width_ - indent_ - buffer_[i].raw_str.len;
-            space_len = std::max(space_len, 0);
-            tty.addString(j, core_top_left_.col, std::string(indent_, ' ') + buffer_[i].str + std::string(space_len, ' '));
+            _renderLine(j, _row(i), false);
         }
 
         for ( ; j > core_top_left_.line - core_height_; --j ) {
-            tty.addString(j, core_top_left_.col, std::string(core_width_, ' '));
+            Tty::Segment blank{ blank_.data(), blank_.length(), nullptr };
+            tty.addSegments(j, core_top_left_.col, &blank, 1);
         }
     }
     else {
@@ -165,13 +284,12 @@ void Window::_render(uint32_t orig_cursorline_y) {
             if ( new_cursorline_y == orig_cursorline_y && new_cursorline_y == j ) {
                 continue;
             }
-            int32_t space_len = core_width_ - indent_ - buffer_[i].raw_str.len;
-            space_len = std::max(space_len, 0);
-            tty.addString(j, core_top_left_.col, std::string(indent_, ' ') + buffer_[i].str + std::string(space_len, ' '));
+            _renderLine(j, _row(i), false);
         }
 
         for ( ; j < core_top_left_.line + core_height_; ++j ) {
-            tty.addString(j, core_top_left_.col, std::string(core_width_, ' '));
+            Tty::Segment blank{ blank_.data(), blank_.length(), nullptr };
+            tty.addSegments(j, core_top_left_.col, &blank, 1);
         }
     }
 
@@ -179,64 +297,79 @@ void Window::_render(uint32_t orig_cursorline_y) {
         _renderCursorline(cursor_line_);
     }
 
-    tty.restoreCursorPosition();
+    // the cursor is shown in the same frame
     tty.showCursor();
+    tty.restoreCursorPosition();
 }
 
-void Window::_renderCursorline(uint32_t cursor_line) {
-    auto& tty = Tty::getInstance();
-    Point point = _getCursorlinePosition(cursor_line);
-    auto str_len = buffer_[cursor_line].raw_str.len;
-    int32_t space_len = core_width_ - indent_ - str_len;
-    if ( space_len > 0 ) {
-        tty.addString(point.line, point.col + str_len, std::string(space_len, ' '));
+void Window::_renderLine(uint32_t line_y, const AttributedLine& line, bool is_cursorline) {
+    std::array<Tty::Segment, 2 * AttributedLine::max_span_num + 5> segments;
+    uint32_t n = 0;
+    auto& normal_color = is_cursorline ? cursorline_colors_[static_cast<uint32_t>(HighlightGroup::Normal)]
+                                       : cs_.getColor(HighlightGroup::Normal);
+    auto str = line.raw_str.str;
+    auto begin = line.first;
+    auto end = line.last;
+
+    segments[n++] = { blank_.data(), indent_, nullptr };
+    if ( line.left_ellipsis ) {
+        segments[n++] = { "..", 2, &normal_color };
+        begin += 2;
+    }
+    if ( line.right_ellipsis ) {
+        end -= 2;
     }
 
-    const std::string reset_color("\033[0m");
+    for ( uint32_t i = 0; i < line.span_num; ++i ) {
+        auto& span = line.spans[i];
+        uint32_t span_begin = std::max(static_cast<uint32_t>(span.col), begin);
+        uint32_t span_end = std::min(static_cast<uint32_t>(span.col + span.len), end);
+        if ( span_begin >= span_end ) {
+            continue;
+        }
 
-    // no color
-    if ( !utils::endswith(buffer_[cursor_line].str, reset_color) ) {
-        tty.addString(point.line, point.col,
-                      buffer_[cursor_line].str,
-                      cs_.getColor(HighlightGroup::CursorLine));
+        if ( begin < span_begin ) {
+            segments[n++] = { str + begin, span_begin - begin, &normal_color };
+        }
+        segments[n++] = { str + span_begin, span_end - span_begin,
+                          is_cursorline ? &cursorline_colors_[span.group]
+                                        : &cs_.getColor(static_cast<HighlightGroup>(span.group)) };
+        begin = span_end;
     }
-    else {
-        auto& normal_color = cs_.getColor(HighlightGroup::Normal);
-        auto& cursor_line_color = cs_.getColor(HighlightGroup::CursorLine);
-        auto cursor_line_str = buffer_[cursor_line].str;
-        auto pos = cursor_line_str.rfind(reset_color);
-        if ( pos != std::string::npos ) {
-            auto max_pos = pos;
-            pos -= reset_color.length();
-            auto normal_len = normal_color.length();
-            while ( pos < max_pos
-                    && (pos = cursor_line_str.rfind(normal_color, pos)) != std::string::npos ) {
-                cursor_line_str.replace(pos, normal_len, cursor_line_color);
-                pos -= normal_len;
-            }
 
-            tty.addString(point.line, point.col, cursor_line_str);
-        }
+    if ( begin < end ) {
+        segments[n++] = { str + begin, end - begin, &normal_color };
+    }
+    if ( line.right_ellipsis ) {
+        segments[n++] = { "..", 2, &normal_color };
     }
 
-    _drawIndicator(point.line);
+    int32_t space_len = core_width_ - indent_ - (line.last - line.first);
+    if ( space_len > 0 ) {
+        segments[n++] = { blank_.data(), static_cast<size_t>(space_len), nullptr };
+    }
+
+    Tty::getInstance().addSegments(line_y, core_top_left_.col, segments.data(), n);
 }
 
+void Window::_renderCursorline(uint32_t cursor_line) {
+    Point point = _getCursorlinePosition(cursor_line);
+    _renderLine(point.line, _row(cursor_line), true);
+    _drawIndicator(point.line);
+}
 
 void Window::_updateCursorline(uint32_t new_cursorline) {
-    if ( new_cursorline == cursor_line_ || new_cursorline >= buffer_.size() ) {
+    if ( new_cursorline == cursor_line_ || new_cursorline >= size_ ) {
         return;
     }
 
-    auto& tty = Tty::getInstance();
     Point point = _getCursorlinePosition(cursor_line_);
-    _clearIndicator(point.line);
-    tty.addString(point.line, point.col, buffer_[cursor_line_].str);
+    _renderLine(point.line, _row(cursor_line_), false);
 
     _renderCursorline(new_cursorline);
     cursor_line_ = new_cursorline;
 
-    tty.restoreCursorPosition();
+    Tty::getInstance().restoreCursorPosition();
 }
 
 void MainWindow::updateLineInfo(uint32_t result_size, uint32_t total_size) {
@@ -491,6 +624,7 @@ Tui::Tui()
 void Tui::init(bool resume) {
     uint32_t win_height = 0;
     uint32_t win_width = 0;
+    tty_.setSyncUpdate(cfg_.getConfigValue<ConfigType::SyncUpdate>());
     if ( !resume ) {
         tty_.getWindowSize(win_height, win_width);
     }
@@ -531,6 +665,7 @@ void Tui::init(bool resume) {
         cleanup_.setFullScreen();
         tty_.enableAlternativeBuffer();
         tty_.enableMouse();
+        tty_.enableBracketedPaste();
         tty_.disableAutoWrap();
         tty_.flush();
     }
@@ -546,6 +681,7 @@ void Tui::init(bool resume) {
 
         height = std::max(height, min_height);
         tty_.enableMouse();
+        tty_.enableBracketedPaste();
         tty_.disableAutoWrap();
         if ( win_height - line < height ) {
             auto delta_height = height - (win_height - line);
@@ -561,14 +697,11 @@ void Tui::init(bool resume) {
 
         top_left.line = line;
         top_left.col = col;
+        origin_ = top_left;
+        height_ = height;
     }
 
-    setMargin(top_left, bottom_right, height);
-    win_width = bottom_right.col - top_left.col + 1;
-    auto& border = ConfigManager::getInstance().getConfigValue<ConfigType::Border>();
-    if ( border.find("T") != std::string::npos || border.find("B") != std::string::npos ) {
-        bottom_right.col -= win_width % ConfigManager::getInstance().getBorderCharWidth();
-    }
+    _layout(win_height, win_width, top_left, bottom_right, height);
 
     if ( !resume ) {
         setMainWindow(top_left, bottom_right, cs_);
@@ -580,6 +713,49 @@ void Tui::init(bool resume) {
     }
 }
 
+void Tui::_layout(uint32_t win_height, uint32_t win_width, Point& tl, Point& br, uint32_t height) {
+    tty_.initScreen(win_height, win_width);
+    setMargin(tl, br, height);
+    auto width = br.col - tl.col + 1;
+    auto& border = ConfigManager::getInstance().getConfigValue<ConfigType::Border>();
+    if ( border.find("T") != std::string::npos || border.find("B") != std::string::npos ) {
+        br.col -= width % ConfigManager::getInstance().getBorderCharWidth();
+    }
+}
+
+/**
+ * Only the geometry is computed again, the rows of the main window are truncated
+ * again when they are rendered, and only if the width has changed.
+ */
+void Tui::resize() {
+    uint32_t win_height = 0;
+    uint32_t win_width = 0;
+    tty_.getWindowSize2(win_height, win_width);
+    if ( win_height == 0 || win_width == 0 ) {
+        return;
+    }
+
+    Point top_left(1, 1);
+    Point bottom_right(win_height, win_width);
+    auto height = win_height;
+    if ( height_ == 0 ) {
+        tty_.clear(EraseMode::EntireScreen);
+    }
+    else {
+        // the window keeps its place unless it no longer fits
+        height = std::min(height_, win_height);
+        top_left.line = std::min(origin_.line, win_height - height + 1);
+        top_left.col = std::min(origin_.col, win_width);
+        bottom_right.line = top_left.line + height - 1;
+        tty_.moveCursorTo(top_left.line, 1);
+        tty_.clear(EraseMode::ToScreenEnd);
+    }
+
+    _layout(win_height, win_width, top_left, bottom_right, height);
+    p_main_win_->reset(top_left, bottom_right);
+    cleanup_.saveCoreHeight(p_main_win_->getCoreHeight());
+}
+
 void Tui::setMargin(Point& tl, Point& br, uint32_t height) {
     auto& margin = ConfigManager::getInstance().getConfigValue<ConfigType::Margin>();
     uint32_t min_height = 5;
@@ -634,6 +810,7 @@ void Cleanup::doWork(bool once) {
     auto& tty = Tty::getInstance();
     tty.enableAutoWrap();
     tty.disableMouse();
+    tty.disableBracketedPaste();
     tty.showCursor();
     if ( is_full_screen_ ) {
         tty.clear(EraseMode::EntireScreen);
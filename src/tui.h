@@ -5,11 +5,14 @@ _Pragma("once");
 #include <string>
 #include <vector>
 #include <functional>
+#include <array>
+#include <algorithm>
 #include "constString.h"
 #include "color.h"
 #include "tty.h"
 #include "configManager.h"
 #include "singleton.h"
+#include "lruCache.h"
 
 namespace leaf
 {
@@ -23,16 +26,47 @@ public:
     uint32_t col;
 };
 
-struct HighlightString
+// [col, col + len) of the line is highlighted by group
+struct HighlightSpan
 {
-    template <typename T>
-    HighlightString(T&& s, const ConstString& const_str): str(s), raw_str(const_str) {}
+    uint16_t col;
+    uint16_t len;
+    uint8_t  group;
+};
+
+/**
+ * A line in the window. [first, last) of raw_str is displayed, with ".." in place of
+ * the first/last two characters if the line is truncated on that side.
+ * The characters not covered by spans are displayed in HighlightGroup::Normal.
+ */
+struct AttributedLine
+{
+    static constexpr uint32_t max_span_num = 64;
+
+    AttributedLine(const ConstString& const_str, uint32_t f, uint32_t l)
+        : raw_str(const_str), first(f), last(l) {}
 
-    std::string str;
-    ConstString raw_str;
+    void addSpan(uint16_t col, uint16_t len, HighlightGroup group) {
+        if ( span_num < max_span_num ) {
+            spans[span_num++] = { col, len, static_cast<uint8_t>(group) };
+        }
+    }
+
+    ConstString   raw_str;
+    uint32_t      first;
+    uint32_t      last;
+    bool          left_ellipsis{ false };
+    bool          right_ellipsis{ false };
+    uint8_t       span_num{ 0 };
+    HighlightSpan spans[max_span_num];
 };
 
-using Generator = std::function<std::vector<HighlightString>()>;
+/**
+ * Returns the rows [first, last) of a list, last is not beyond the size of the list.
+ * The window asks only for the rows it displays, so a row can be asked for again
+ * after it has been evicted from the row cache.
+ */
+using RowSource = std::function<std::vector<AttributedLine>(uint32_t first, uint32_t last)>;
 
 class Window
 {
@@ -88,11 +122,19 @@ public:
         }
     }
 
-    void setBuffer(Generator&& generator);
+    void setBuffer(uint32_t size, RowSource&& source);
     void setBuffer();
+    // the first rows of source are the rows of the buffer but the first removed ones,
+    // the view is kept on the same rows if they are still there
+    void appendBuffer(uint32_t size, RowSource&& source, uint32_t removed=0);
 
-    const std::vector<HighlightString>& getBuffer() const noexcept {
-        return buffer_;
+    // moves the cursor line to the row index, the rows in between are never generated
+    void jumpTo(uint32_t index);
+
+    void jumpToPercent(uint32_t percent) {
+        if ( size_ > 0 ) {
+            jumpTo(static_cast<uint64_t>(size_ - 1) * std::min(percent, 100u) / 100);
+        }
     }
 
     void scrollUp() {
@@ -161,13 +203,22 @@ public:
         }
     }
 
-    void printAcceptedStrings() const noexcept {
-        if ( !buffer_.empty() ) {
-            printf("%s\n", std::string(buffer_[cursor_line_].raw_str.str,
-                                       buffer_[cursor_line_].raw_str.len).c_str());
+    void printAcceptedStrings() {
+        if ( size_ > 0 ) {
+            auto& row = _row(cursor_line_);
+            printf("%s\n", std::string(row.raw_str.str, row.raw_str.len).c_str());
         }
     }
 
+    // the line printed by printAcceptedStrings(), returns false if there is none
+    bool getAcceptedString(ConstString& str) {
+        if ( size_ == 0 ) {
+            return false;
+        }
+        str = _row(cursor_line_).raw_str;
+        return true;
+    }
+
     void singleClick(const Point& yx) {
         if ( is_reverse_ ) {
             _updateCursorline(first_line_ + core_top_left_.line - yx.line);
@@ -189,11 +240,14 @@ protected:
         }
     }
 
+    void _fitView();
+    void _fetchRows(uint32_t first, uint32_t last);
+    const AttributedLine& _row(uint32_t index);
+    void _renderLine(uint32_t line_y, const AttributedLine& line, bool is_cursorline);
     void _renderCursorline(uint32_t cursor_line);
     void _updateCursorline(uint32_t new_cursorline);
 
     virtual void _drawIndicator(uint32_t cursor_line_y) {}
-    virtual void _clearIndicator(uint32_t cursor_line_y) {}
 protected:
     Point    top_left_;
     Point    bottom_right_;
@@ -202,8 +256,10 @@ protected:
     uint32_t width_;
     uint32_t core_height_;
     uint32_t core_width_;
-    std::vector<HighlightString> buffer_;
-    Generator generator_;
+    uint32_t  size_{ 0 };   // the number of rows of the list
+    RowSource source_;
+    LruCache<uint32_t, AttributedLine> rows_;   // the recently displayed rows
+    uint32_t  rows_width_{ 0 }; // the width the rows in rows_ are truncated to
     bool     is_reverse_{ ConfigManager::getInstance().getConfigValue<ConfigType::Reverse>() };
     uint32_t cursor_line_{ 0 }; // index of string under cursor line
     uint32_t first_line_{ 0 };  // index of string at the top of window
@@ -211,6 +267,9 @@ protected:
     uint32_t border_mask_{ 0 };
     uint32_t indent_{ ConfigManager::getInstance().getConfigValue<ConfigType::Indentation>() };
     const Colorscheme& cs_;
+    std::string blank_; // core_width_ spaces
+    // the colors of the highlight groups on the cursor line
+    std::array<std::string, static_cast<uint32_t>(HighlightGroup::MaxGroupNum)> cursorline_colors_;
 };
 
 class MainWindow : public Window
@@ -220,9 +279,11 @@ public:
         _setCmdline();
     }
 
+    // e.g., the terminal is resized
     void reset(const Point& tl, const Point& br) {
         _init(tl, br);
         _setCmdline();
+        _fitView();
     }
 
     void display() const {
@@ -253,6 +314,7 @@ public:
                                          flag_col,
                                          flag[(idx++) & 3],
                                          cs_.getColor(HighlightGroup::Flag));
+            Tty::getInstance().restoreCursorPosition();
         }
         else {
             Tty::getInstance().addString(line_info_.line,
@@ -292,11 +354,6 @@ private:
         Tty::getInstance().addString(cursor_line_y, core_top_left_.col, indicator_,
                                      cs_.getColor(HighlightGroup::Indicator));
     }
-
-    void _clearIndicator(uint32_t cursor_line_y) override {
-        Tty::getInstance().addString(cursor_line_y, core_top_left_.col, std::string(indent_, ' '),
-                                     cs_.getColor(HighlightGroup::Normal));
-    }
 private:
     std::string prompt_{ "> " };
     std::string indicator_{ "➤" };
@@ -361,6 +418,8 @@ public:
     ~Tui();
 
     void init(bool resume);
+    // lays the windows out again for the new size of the terminal
+    void resize();
 
     void setMargin(Point& tl, Point& br, uint32_t height);
 
@@ -394,10 +453,10 @@ public:
     }
 
     template <typename T>
-    void setBuffer(Generator&& generator) {
+    void setBuffer(uint32_t size, RowSource&& source) {
         auto& w = getWindow(WindowType<T>());
         if ( w ) {
-            w->setBuffer(std::move(generator));
+            w->setBuffer(size, std::move(source));
         }
     }
 
@@ -409,6 +468,14 @@ public:
         }
     }
 
+    template <typename T>
+    void appendBuffer(uint32_t size, RowSource&& source, uint32_t removed=0) {
+        auto& w = getWindow(WindowType<T>());
+        if ( w ) {
+            w->appendBuffer(size, std::move(source), removed);
+        }
+    }
+
     template <typename T>
     void scrollUp() {
         auto& w = getWindow(WindowType<T>());
@@ -441,6 +508,22 @@ public:
         }
     }
 
+    template <typename T>
+    void jumpTo(uint32_t index) {
+        auto& w = getWindow(WindowType<T>());
+        if ( w ) {
+            w->jumpTo(index);
+        }
+    }
+
+    template <typename T>
+    void jumpToPercent(uint32_t percent) {
+        auto& w = getWindow(WindowType<T>());
+        if ( w ) {
+            w->jumpToPercent(percent);
+        }
+    }
+
     void singleClick(const Point& yx) {
         if ( p_main_win_->inCoreWindow(yx) ) {
             p_main_win_->singleClick(yx);
@@ -513,6 +596,14 @@ public:
         accept_ = true;
     }
 
+    // returns false if the user has not accepted a line
+    bool getAcceptedString(ConstString& str) {
+        return accept_ && p_main_win_->getAcceptedString(str);
+    }
+
+private:
+    void _layout(uint32_t win_height, uint32_t win_width, Point& tl, Point& br, uint32_t height);
+
 private:
     Tty& tty_;
     const ConfigManager& cfg_;
@@ -521,6 +612,8 @@ private:
     std::unique_ptr<MainWindow> p_main_win_;
     std::unique_ptr<PreviewWindow> p_preview_win_;
     bool accept_{ false };
+    Point    origin_{ 1, 1 };  // the top left of the window if it is not full screen
+    uint32_t height_{ 0 };    // the height of the window if it is not full screen
 
 };
 
@@ -1,3 +1,8 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
 #include "utils.h"
 
 namespace utils
@@ -6,4 +11,83 @@ namespace utils
     bool is_utf8_boundary(uint8_t c) {
         return c < 128 || (c & (1 << 6));
     }
+
+    // the high and the low 64 bits of the 128-bit product folded together
+    static inline uint64_t mix(uint64_t a, uint64_t b) {
+        auto r = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+    }
+
+    uint64_t hash64(const char* data, size_t len) {
+        const uint64_t k0 = 0xa0761d6478bd642full;
+        const uint64_t k1 = 0xe7037ed1a0b428dbull;
+        const uint64_t k2 = 0x8ebc6af09c88c6e3ull;
+
+        uint64_t h = k0;
+        size_t i = 0;
+        for ( ; i + 16 <= len; i += 16 ) {
+            uint64_t a, b;
+            memcpy(&a, data + i, 8);
+            memcpy(&b, data + i + 8, 8);
+            h = mix(a ^ k1, b ^ h);
+        }
+
+        // the last 0 to 15 bytes, zero padded, len tells the padding from the data
+        uint64_t a = 0, b = 0;
+        auto rest = len - i;
+        if ( rest > 8 ) {
+            memcpy(&a, data + i, 8);
+            memcpy(&b, data + i + 8, rest - 8);
+        }
+        else {
+            memcpy(&a, data + i, rest);
+        }
+
+        return mix(k2 ^ len, mix(a ^ k1, b ^ h));
+    }
+
+    bool replaceFile(const std::string& file, size_t size, mode_t mode,
+                     const std::function<void(char* data)>& fill) {
+        auto tmp_file = file + strFormat<32>(".%d", getpid());
+        auto fd = open(tmp_file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+        if ( fd == -1 ) {
+            return false;
+        }
+
+        // the blocks are allocated first, a full disk fails here instead of by SIGBUS
+        void* data = MAP_FAILED;
+        if ( size == 0 ) {
+            fill(nullptr);
+        }
+        else {
+            auto err = posix_fallocate(fd, 0, size);
+            if ( err == 0 ) {
+                data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            else {
+                errno = err;
+            }
+
+            if ( data == MAP_FAILED ) {
+                err = errno;
+                close(fd);
+                unlink(tmp_file.c_str());
+                errno = err;
+                return false;
+            }
+
+            fill(static_cast<char*>(data));
+            munmap(data, size);
+        }
+        close(fd);
+
+        if ( rename(tmp_file.c_str(), file.c_str()) == -1 ) {
+            auto err = errno;
+            unlink(tmp_file.c_str());
+            errno = err;
+            return false;
+        }
+
+        return true;
+    }
 }
@@ -2,7 +2,10 @@ _Pragma("once");
 
 #include <cstdio>
 #include <cstdint>
+#include <ctime>
 #include <string>
+#include <functional>
+#include <sys/types.h>
 
 namespace utils
 {
@@ -24,4 +27,49 @@ namespace utils
     }
 
     bool is_utf8_boundary(uint8_t c);
+
+    inline int64_t toNs(const struct timespec& ts) {
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // n rounded up to a multiple of 8, the sections of the files mapped are 8-byte aligned
+    inline size_t align8(size_t n) {
+        return (n + 7) & ~static_cast<size_t>(7);
+    }
+
+    /**
+     * Replaces file atomically by a file of size bytes filled by fill(data) in a mapping
+     * of it, data is zeroed. The file is written to file.<pid> and renamed, so that a
+     * process opening file never sees a partial one. Returns false and sets errno on failure.
+     */
+    bool replaceFile(const std::string& file, size_t size, mode_t mode,
+                     const std::function<void(char* data)>& fill);
+
+    // a fast non-cryptographic hash of the len bytes of data, 16 bytes are mixed at a time
+    uint64_t hash64(const char* data, size_t len);
+
+    // hash as the key of an open-addressing table, 0 marks an empty slot so it is not a key
+    inline uint64_t hashKey(uint64_t hash) {
+        return hash == 0 ? 1 : hash;
+    }
+
+    // calls f(offset, len) for each line of data, a line ends with '\n', '\r' or "\r\n"
+    template <typename F>
+    void forEachLine(const char* data, uint64_t size, F&& f) {
+        uint64_t start = 0;
+        for ( uint64_t i = 0; i < size; ++i ) {
+            auto c = data[i];
+            if ( c == '\n' || c == '\r' ) {
+                f(start, i - start);
+                if ( c == '\r' && i + 1 < size && data[i + 1] == '\n' ) {
+                    ++i;
+                }
+                start = i + 1;
+            }
+        }
+
+        if ( start < size ) {
+            f(start, size - start);
+        }
+    }
 }
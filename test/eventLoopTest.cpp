@@ -0,0 +1,64 @@
+#include "eventLoop.h"
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace leaf;
+using namespace std;
+
+
+int main(int argc, const char *argv[])
+{
+    EventLoop loop;
+
+    int fd[2];
+    if ( pipe(fd) != 0 ) {
+        return 1;
+    }
+
+    // the reader is removed at the end of file
+    loop.addReader(fd[0], [&loop, &fd] {
+        char buffer[64];
+        auto n = read(fd[0], buffer, sizeof(buffer));
+        if ( n > 0 ) {
+            cout << "read: " << string(buffer, n) << endl;
+        }
+        else {
+            cout << "end of file" << endl;
+            loop.removeReader(fd[0]);
+        }
+    });
+
+    int ticks = 0;
+    EventLoop::TimerId ticker = 0;
+    ticker = loop.addTimer([&] {
+        cout << "tick " << ++ticks << endl;
+        if ( ticks == 3 ) {
+            loop.stopTimer(ticker);
+            write(fd[1], "hello", 5);
+            close(fd[1]);
+        }
+    });
+    loop.startTimer(ticker, chrono::milliseconds(10), chrono::milliseconds(10));
+
+    auto once = loop.addTimer([&loop, &fd] {
+        cout << "timeout, reader registered: " << boolalpha << loop.hasReader(fd[0]) << endl;
+        // posted by another thread
+        thread t([&loop] {
+            loop.post([] { cout << "posted 1" << endl; });
+            loop.post([&loop] {
+                cout << "posted 2" << endl;
+                loop.stop();
+            });
+        });
+        t.join();
+    });
+    loop.startTimer(once, chrono::milliseconds(100));
+
+    loop.run();
+    cout << "stopped" << endl;
+
+    close(fd[0]);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "fileCache.h"
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace leaf;
+using namespace std;
+
+
+void print(const FileCache& cache, uint32_t index, const string& indent) {
+    const auto& dir = cache.dir(index);
+    cout << indent << "[" << string(cache.names(dir.path_offset), dir.path_len) << "] mtime: " << dir.mtime
+         << ", files: " << string(cache.names(dir.files_offset), dir.files_len).length()
+         << " bytes" << endl;
+
+    auto children = cache.children(dir);
+    for ( uint32_t i = 0; i < dir.child_count; ++i ) {
+        if ( children[i] == FileCache::NoDir ) {
+            cout << indent << "    (not cached)" << endl;
+        }
+        else {
+            print(cache, children[i], indent + "    ");
+        }
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    string file = "/tmp/fileCacheTest." + to_string(getpid());
+    string root = "/some/root";
+
+    // the order of the entries does not matter, "unreadable/" has no entry
+    vector<FileCache::Entry> entries = {
+        { "a/b/", 3, 0, false, "two.h\n", "" },
+        { "", 1, 7, true, "top.txt\n", "a\nunreadable\n" },
+        { "a/", 2, 7, false, "one.cpp\nthree.cpp\n", "b\n" },
+    };
+    cout << "save: " << boolalpha << FileCache::save(file, root, 1, std::move(entries)) << endl;
+
+    {
+        FileCache cache;
+        cout << "load with another stamp: " << cache.load(file, root, 0) << endl;
+    }
+    {
+        FileCache cache;
+        cout << "load with another root: " << cache.load(file, "/other", 1) << endl;
+    }
+
+    FileCache cache;
+    cout << "load: " << cache.load(file, root, 1) << ", " << cache.size() << " dirs" << endl;
+    print(cache, 0, "");
+
+    unlink(file.c_str());
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "fileWalker.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
+using namespace leaf;
+using namespace std;
+
+
+void touch(const string& path) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if ( fp ) {
+        fclose(fp);
+    }
+}
+
+vector<string> walk(const string& root, uint32_t thread_count, bool ignore_files=true,
+                    const string& cache_file=string()) {
+    mutex mtx;
+    condition_variable cond;
+    bool done = false;
+    string data;
+
+    FileWalker walker(thread_count,
+                      [&](unique_ptr<char[]>&& buffer, uint32_t len) {
+                          lock_guard<mutex> lock(mtx);
+                          data.append(buffer.get(), len);
+                      },
+                      [&] {
+                          lock_guard<mutex> lock(mtx);
+                          done = true;
+                          cond.notify_one();
+                      });
+    walker.setIgnoreFiles(ignore_files);
+    walker.setCacheFile(cache_file);
+    walker.start(root);
+    {
+        unique_lock<mutex> lock(mtx);
+        cond.wait(lock, [&] { return done; });
+    }
+
+    vector<string> paths;
+    size_t start = 0;
+    for ( auto pos = data.find('\n'); pos != string::npos; pos = data.find('\n', start) ) {
+        paths.emplace_back(data, start, pos - start);
+        start = pos + 1;
+    }
+    sort(paths.begin(), paths.end());
+
+    return paths;
+}
+
+int main(int argc, const char *argv[])
+{
+    char tmpl[] = "/tmp/fileWalkerTest.XXXXXX";
+    string root = mkdtemp(tmpl);
+
+    // the hidden files and directories are skipped, so are the symbolic links
+    mkdir((root + "/a").c_str(), 0755);
+    mkdir((root + "/a/b").c_str(), 0755);
+    mkdir((root + "/.git").c_str(), 0755);
+    mkdir((root + "/empty").c_str(), 0755);
+    touch(root + "/top.txt");
+    touch(root + "/.hidden");
+    touch(root + "/a/one.cpp");
+    touch(root + "/a/b/two.h");
+    touch(root + "/.git/config");
+    symlink("top.txt", (root + "/link").c_str());
+    for ( int i = 0; i < 1000; ++i ) {
+        touch(root + "/a/b/file" + to_string(i));
+    }
+
+    for ( uint32_t thread_count : { 1u, 4u } ) {
+        auto paths = walk(root, thread_count);
+        cout << thread_count << " threads: " << paths.size() << " files:";
+        for ( const auto& path : paths ) {
+            if ( path.find("file") == string::npos ) {
+                cout << " " << path;
+            }
+        }
+        cout << endl;
+    }
+
+    auto missing = walk(root + "/missing", 2);
+    cout << "missing root: " << missing.size() << " files" << endl;
+
+    // a/b is never opened, the negated pattern of a/.ignore takes precedence
+    FILE* fp = fopen((root + "/.gitignore").c_str(), "w");
+    fputs("b/\n*.cpp\n*.txt\n", fp);
+    fclose(fp);
+    fp = fopen((root + "/a/.ignore").c_str(), "w");
+    fputs("!one.cpp\n", fp);
+    fclose(fp);
+    for ( bool ignore_files : { true, false } ) {
+        auto paths = walk(root, 4, ignore_files);
+        cout << (ignore_files ? "ignore files: " : "no ignore files: ") << paths.size() << " files:";
+        for ( const auto& path : paths ) {
+            if ( path.find("file") == string::npos ) {
+                cout << " " << path;
+            }
+        }
+        cout << endl;
+    }
+
+    // the directories changed since the last walk are read again
+    string cache_file = root + ".cache";
+    for ( int i = 0; i < 3; ++i ) {
+        if ( i == 2 ) {
+            touch(root + "/a/b/new.h");
+            unlink((root + "/a/b/file0").c_str());
+        }
+        auto paths = walk(root, 2, false, cache_file);
+        cout << "cache " << i << ": " << paths.size() << " files:";
+        for ( const auto& path : paths ) {
+            if ( path.find("file") == string::npos ) {
+                cout << " " << path;
+            }
+        }
+        cout << endl;
+    }
+    unlink(cache_file.c_str());
+
+    string cmd = "rm -rf " + root;
+    return system(cmd.c_str());
+}
@@ -0,0 +1,88 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+
+// reads the screen of yy for ms, answering the queries of the cursor position
+void drain(int master, int ms) {
+    struct pollfd pfd{ master, POLLIN, 0 };
+    char buffer[4096];
+    while ( poll(&pfd, 1, ms) > 0 ) {
+        auto n = read(master, buffer, sizeof(buffer));
+        if ( n <= 0 ) {
+            break;
+        }
+        if ( memmem(buffer, n, "\033[6n", 4) != nullptr ) {
+            write(master, "\033[1;1R", 6);
+        }
+    }
+}
+
+void rewrite(const string& file, const string& data) {
+    ofstream out(file, ios::trunc);
+    out << data;
+}
+
+/**
+ * Runs yy --follow on input holding "a.log\npartial", rewrites input to "fresh.log\n",
+ * then types pattern and Enter, returns the line accepted.
+ */
+string follow(const string& dir, const string& input, const string& pattern) {
+    string output = input + ".out";
+    rewrite(input, "a.log\npartial");
+
+    struct winsize ws{ 30, 60, 0, 0 };
+    int master = -1;
+    auto pid = forkpty(&master, nullptr, nullptr, &ws);
+    if ( pid == 0 ) {
+        dup2(open(input.c_str(), O_RDONLY), STDIN_FILENO);
+        dup2(open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600), STDOUT_FILENO);
+        execl((dir + "yy").c_str(), "yy", "--follow", "--no-history", nullptr);
+        _exit(127);
+    }
+
+    drain(master, 500);
+    rewrite(input, "fresh.log\n");
+    drain(master, 500);
+    write(master, pattern.data(), pattern.length());
+    drain(master, 500);
+    write(master, "\r", 1);
+    drain(master, 500);
+
+    int status = 0;
+    if ( waitpid(pid, &status, WNOHANG) == 0 ) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    close(master);
+
+    ifstream in(output);
+    string accepted;
+    getline(in, accepted);
+    unlink(output.c_str());
+    return accepted;
+}
+
+int main(int argc, const char *argv[])
+{
+    string dir(argv[0]);
+    dir = dir.substr(0, dir.rfind('/') + 1);
+    string input = "/tmp/followTest." + to_string(getpid());
+
+    // truncated while the partial line is pending, it is a line of its own,
+    // which is not continued by the new data
+    cout << "accepted: [" << follow(dir, input, "partial") << "]" << endl;
+    cout << "accepted: [" << follow(dir, input, "fresh") << "]" << endl;
+
+    unlink(input.c_str());
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "history.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+
+using namespace leaf;
+using namespace std;
+
+
+int main(int argc, const char *argv[])
+{
+    string file = "/tmp/historyTest." + to_string(getpid());
+    const int64_t now = 1700000000;
+    const int64_t day = 24 * 3600;
+
+    {
+        History history;
+        cout << "open: " << boolalpha << history.open(file, now) << ", size: " << history.size() << endl;
+        history.record(1, now - 60);
+        history.record(1, now - 30);
+        history.record(2, now - 2 * day);
+        history.record(3, now - 30 * day);
+        cout << "frecency: " << history.frecency(1) << " " << history.frecency(2) << " "
+             << history.frecency(3) << " " << history.frecency(4) << endl;
+    }
+
+    // the file is shared, another History sees the lines recorded by the first
+    History a;
+    History b;
+    a.open(file, now);
+    b.open(file, now);
+    b.record(2, now);
+    b.record(5, now - 40 * day);
+    cout << "size: " << a.size() << ", frecency of 2 seen by a: " << a.frecency(2) << endl;
+
+    // the table grows by a compaction, which replaces the file
+    struct stat before;
+    stat(file.c_str(), &before);
+    for ( uint64_t key = 100; key < 1000; ++key ) {
+        a.record(key, now);
+    }
+    struct stat after;
+    stat(file.c_str(), &after);
+    cout << "capacity: " << a.capacity() << ", size: " << a.size()
+         << ", replaced: " << (before.st_ino != after.st_ino) << endl;
+
+    // b maps the new file before recording
+    b.record(3, now);
+    a.open(file, now);
+    cout << "frecency of 3 seen by a: " << a.frecency(3) << ", frecency of 999: " << a.frecency(999) << endl;
+
+    // compacted once a day, the lines not accepted for 90 days are dropped
+    History c;
+    c.open(file, now + 60 * day);
+    cout << "size after 60 days: " << c.size() << ", frecency of 5: " << c.frecency(5) << endl;
+
+    // not a history, it is reset
+    truncate(file.c_str(), 100);
+    History d;
+    cout << "open: " << d.open(file, now) << ", size: " << d.size() << ", capacity: " << d.capacity() << endl;
+
+    unlink(file.c_str());
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "ignoreRules.h"
+#include <iostream>
+#include <string>
+#include <memory>
+
+using namespace leaf;
+using namespace std;
+
+
+void check(const IgnoreRules& rules, const string& path, bool is_dir=false) {
+    auto pos = path.rfind('/');
+    auto dir = pos == string::npos ? string() : path.substr(0, pos + 1);
+    auto name = path.substr(dir.length());
+    cout << "    " << path << (is_dir ? "/" : "") << ": "
+         << (rules.isIgnored(dir, name.c_str(), name.length(), is_dir) ? "ignored" : "kept") << endl;
+}
+
+int main(int argc, const char *argv[])
+{
+    auto root = make_shared<IgnoreRules>(nullptr, 0);
+    string gitignore =
+        "# comment\n"
+        "\n"
+        "*.o\n"
+        "core.*\n"
+        "build/\n"
+        "/todo.txt\n"
+        "doc/*.html\n"
+        "**/logs/*.log\n"
+        "tmp/**\n"
+        "a/**/z.txt\n"
+        "file[0-9].txt\n"
+        "?.md\n"
+        "!keep.o\n"
+        "\\#hash\n"
+        "trailing\\ \n";
+    root->parse(gitignore.data(), gitignore.length());
+
+    cout << "root:" << endl;
+    for ( auto path : { "main.o", "src/main.o", "keep.o", "core.1", "todo.txt", "src/todo.txt",
+                        "doc/index.html", "doc/api/index.html", "logs/x.log", "src/logs/y.log",
+                        "tmp/a", "tmp/a/b", "a/z.txt", "a/b/c/z.txt", "file1.txt", "fileX.txt",
+                        "x.md", "xy.md", "#hash", "trailing ", "trailing" } ) {
+        check(*root, path);
+    }
+    // build/ matches the directories only
+    check(*root, "build", true);
+    check(*root, "src/build", true);
+    check(*root, "build");
+
+    // the rules of src/ take precedence over the inherited ones
+    auto sub = make_shared<IgnoreRules>(root, 4);
+    string ignore = "!*.o\n/gen\n";
+    sub->parse(ignore.data(), ignore.length());
+    cout << "src:" << endl;
+    check(*sub, "src/main.o");
+    check(*sub, "src/core.1");
+    check(*sub, "src/gen", true);
+    check(*sub, "src/lib/gen", true);
+
+    // the rules of a directory above the root, which is "repo/" below it
+    auto parent = make_shared<IgnoreRules>(nullptr, 0, "repo/");
+    string above = "/repo/out\n";
+    parent->parse(above.data(), above.length());
+    cout << "above:" << endl;
+    check(*parent, "out", true);
+    check(*parent, "src/out", true);
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "inputParser.h"
+#include <iostream>
+#include <string>
+
+using namespace leaf;
+using namespace std;
+
+
+void print(InputParser& parser) {
+    while ( !parser.empty() ) {
+        auto event = parser.pop();
+        auto key = get<0>(event);
+        if ( key == Key::Char ) {
+            cout << "Char";
+        }
+        else if ( key == Key::Paste ) {
+            cout << "Paste";
+        }
+        else if ( key == Key::Timeout ) {
+            cout << "Timeout";
+        }
+        else if ( key == Key::Unknown ) {
+            cout << "Unknown";
+        }
+        else {
+            cout << static_cast<int>(key);
+        }
+
+        auto& str = get<1>(event);
+        if ( !str.empty() ) {
+            cout << "(";
+            for ( auto c : str ) {
+                if ( c == '\033' ) {
+                    cout << "\\e";
+                }
+                else {
+                    cout << c;
+                }
+            }
+            cout << ")";
+        }
+        cout << " ";
+    }
+    cout << endl;
+}
+
+void feed(InputParser& parser, const string& input) {
+    parser.feed(input.data(), input.size());
+}
+
+int main(int argc, const char *argv[])
+{
+    InputParser::EscCodeMap esc_codes = {
+        { "\033[A", Key::Up },
+        { "\033OP", Key::F1 },
+        { "\033[[A", Key::F1 },
+        { "\033[3~", Key::Delete },
+        { "\033[23$", Key::Shift_F9 },
+        { "\033a", Key::Alt_A },
+    };
+    InputParser parser(esc_codes);
+
+    cout << "Up = " << static_cast<int>(Key::Up) << ", F1 = " << static_cast<int>(Key::F1)
+        << ", Delete = " << static_cast<int>(Key::Delete) << ", Shift_F9 = " << static_cast<int>(Key::Shift_F9)
+        << ", Alt_A = " << static_cast<int>(Key::Alt_A) << ", ESC = " << static_cast<int>(Key::ESC) << endl;
+
+    // characters, a control character and escape sequences in one read
+    feed(parser, "ab\xe4\xb8\xad\r\033[A\033[3~\033OP\033[[A\033[23$\033a");
+    print(parser);
+
+    // a lone ESC is known only after the timeout
+    feed(parser, "\033");
+    print(parser);
+    parser.timeout();
+    print(parser);
+    parser.timeout();
+    print(parser);
+
+    cout << "--------------------------------------" << endl;
+    // split across reads
+    feed(parser, "x\xe4\xb8");
+    feed(parser, "\xad\033[");
+    print(parser);
+    feed(parser, "A");
+    print(parser);
+
+    // mouse tracking and a cursor position report
+    feed(parser, "\033[<0;12;5M\033[M ab\033[20;1R");
+    print(parser);
+
+    cout << "--------------------------------------" << endl;
+    // bracketed paste, the end marker split across reads
+    feed(parser, "k\033[200~999\n\033[A9\t99\r\n\033[2");
+    print(parser);
+    feed(parser, "01~j");
+    print(parser);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "leaf.h"
+#include <stdio.h>
+#include <string.h>
+
+
+static void search(leaf_corpus* corpus, const char* const* lines, const char* pattern, uint32_t top) {
+    leaf_match matches[8];
+    uint32_t match_count = 0;
+    int32_t count = leaf_search(corpus, pattern, strlen(pattern), matches, top, &match_count, NULL);
+    printf("\"%s\": %d of %u matches\n", pattern, count, match_count);
+    for ( int32_t i = 0; i < count; ++i ) {
+        leaf_position positions[16];
+        uint32_t n = leaf_highlight(corpus, pattern, strlen(pattern), matches[i].index, positions, 16);
+        printf("    %u [%s] weight %s, matched:", matches[i].index, lines[matches[i].index],
+               pattern[0] == '\0' ? "0" : (matches[i].weight > 0 ? "> 0" : "<= 0"));
+        for ( uint32_t j = 0; j < n; ++j ) {
+            printf(" %.*s", positions[j].len, lines[matches[i].index] + positions[j].col);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    static const char* lines[] = {
+        "src/app.cpp",
+        "src/server.cpp",
+        "README.md",
+        "src/leaf.cpp",
+        "test/leafTest.c",
+    };
+    uint32_t lens[5];
+    for ( int i = 0; i < 5; ++i ) {
+        lens[i] = strlen(lines[i]);
+    }
+
+    printf("version: %u\n", leaf_version());
+
+    leaf_corpus* corpus = leaf_corpus_new(2);
+    int32_t appended = leaf_corpus_append(corpus, lines, lens, 3);
+    /* the lines are numbered in the order they are appended */
+    static const char text[] = "src/leaf.cpp\r\ntest/leafTest.c";
+    appended |= leaf_corpus_append_text(corpus, text, sizeof(text) - 1);
+    printf("appended: %d, size: %u\n", appended, leaf_corpus_size(corpus));
+
+    search(corpus, lines, "lf", 8);
+    search(corpus, lines, "cpp", 2);
+    search(corpus, lines, "", 2);
+    search(corpus, lines, "xyz", 8);
+
+    leaf_cancel* cancel = leaf_cancel_new();
+    leaf_match matches[8];
+    leaf_cancel_set(cancel);
+    printf("cancelled: %d\n", leaf_search(corpus, "cpp", 3, matches, 8, NULL, cancel));
+    leaf_cancel_reset(cancel);
+    printf("after reset: %d\n", leaf_search(corpus, "cpp", 3, matches, 8, NULL, cancel));
+    leaf_cancel_free(cancel);
+
+    leaf_corpus_free(corpus);
+    return 0;
+}
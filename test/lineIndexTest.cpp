@@ -0,0 +1,47 @@
+#include "lineIndex.h"
+#include "fuzzyMatch.h"
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace leaf;
+using namespace std;
+
+
+int main(int argc, const char *argv[])
+{
+    string file = "/tmp/lineIndexTest." + to_string(getpid());
+    string index_file = file + ".idx";
+
+    // "\r\n", '\r', an empty line and a last line without '\n'
+    {
+        ofstream out(file, ios::binary);
+        out << "main.cpp\r\nREADME.md\rutils.h\n\nlast line";
+    }
+
+    cout << "build: " << boolalpha << LineIndex::build(file, index_file) << endl;
+
+    LineIndex index;
+    string error;
+    cout << "load: " << index.load(index_file, error) << ", " << index.size() << " lines" << endl;
+    for ( uint64_t i = 0; i < index.size(); ++i ) {
+        string line(index.data() + index.offsets()[i], index.lengths()[i]);
+        cout << "[" << line << "] signature: " << hex << index.signatures()[i] << dec
+             << (index.signatures()[i] == FuzzyMatch::getSignature(line.data(), line.length()) ? "" : " (wrong)")
+             << endl;
+    }
+
+    // the index is rejected once the file has changed
+    {
+        ofstream out(file, ios::binary | ios::app);
+        out << "\nmore";
+    }
+    LineIndex stale;
+    cout << "load after the file has changed: " << stale.load(index_file, error) << endl;
+    cout << error.substr(error.find(" has")) << endl;
+
+    unlink(file.c_str());
+    unlink(index_file.c_str());
+    return 0;
+}
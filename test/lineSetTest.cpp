@@ -0,0 +1,63 @@
+#include "lineSet.h"
+#include "utils.h"
+#include <iostream>
+#include <string>
+
+using namespace leaf;
+using namespace std;
+
+
+uint64_t lineHash(const string& line) {
+    return utils::hash64(line.c_str(), line.length());
+}
+
+int main(int argc, const char *argv[])
+{
+    LineSet set;
+    const char* lines[] = { "src/app.cpp", "README.md", "src/app.cpp", "", "src/app.cpp", "README.md" };
+    for ( auto line : lines ) {
+        cout << "[" << line << "] new: " << boolalpha << set.insert(lineHash(line)) << endl;
+    }
+    cout << "size: " << set.size() << ", count of src/app.cpp: " << set.count(lineHash("src/app.cpp"))
+         << ", count of Makefile: " << set.count(lineHash("Makefile")) << endl;
+
+    // a duplicate gets the id of the hash inserted first
+    uint32_t id = 7;
+    auto count = set.insert(lineHash("Makefile"), id);
+    cout << "count: " << count << ", id: " << id;
+    id = 9;
+    count = set.insert(lineHash("Makefile"), id);
+    cout << ", then count: " << count << ", id: " << id << endl;
+
+    // the bytes after the 16th and the length count
+    cout << "hash differs: " << (lineHash("0123456789abcdefX") != lineHash("0123456789abcdefY")) << " "
+         << (lineHash(string("a\0", 2)) != lineHash("a")) << endl;
+
+    // the same shard and the same home slot, erasing the first moves the others back
+    uint64_t shard = 5ull << (64 - LineSet::ShardBits);
+    for ( uint64_t i = 0; i < 3; ++i ) {
+        set.insert(shard | (i << 6) | 1);
+    }
+    set.erase(shard | 1);
+    cout << "after erase: " << set.count(shard | 1) << " " << set.count(shard | (1 << 6) | 1) << " "
+         << set.count(shard | (2 << 6) | 1) << endl;
+
+    // the shards grow
+    LineSet big;
+    uint32_t inserted = 0;
+    for ( int round = 0; round < 2; ++round ) {
+        for ( int i = 0; i < 100000; ++i ) {
+            inserted += big.insert(lineHash("line " + to_string(i)));
+        }
+    }
+    for ( int i = 0; i < 100000; i += 2 ) {
+        big.erase(lineHash("line " + to_string(i)));
+    }
+    uint32_t found = 0;
+    for ( int i = 0; i < 100000; ++i ) {
+        found += big.count(lineHash("line " + to_string(i))) == 2;
+    }
+    cout << "inserted: " << inserted << ", size after erase: " << big.size() << ", counted twice: " << found << endl;
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "lruCache.h"
+#include <iostream>
+#include <string>
+
+using namespace leaf;
+using namespace std;
+
+
+void print(LruCache<int, string>& cache, int first, int last) {
+    for ( int i = first; i < last; ++i ) {
+        auto value = cache.get(i);
+        cout << i << ":" << (value ? *value : "-") << " ";
+    }
+    cout << "(size = " << cache.size() << ")" << endl;
+}
+
+int main(int argc, const char *argv[])
+{
+    LruCache<int, string> cache(3);
+    cache.put(1, "one");
+    cache.put(2, "two");
+    cache.put(3, "three");
+    print(cache, 1, 4);
+
+    // 1 is the least recently used one
+    cache.put(4, "four");
+    cout << "contains 1: " << boolalpha << cache.contains(1) << endl;
+
+    // get() makes 2 the most recently used one, so 3 is evicted
+    cache.get(2);
+    cache.put(5, "five");
+    cout << "contains 2: " << cache.contains(2) << ", contains 3: " << cache.contains(3) << endl;
+
+    // replacing a value does not evict
+    cache.put(5, "FIVE");
+    print(cache, 1, 6);
+
+    cache.reset(2);
+    cache.put(6, "six");
+    cache.put(7, "seven");
+    cache.put(8, "eight");
+    print(cache, 5, 9);
+
+    return 0;
+}
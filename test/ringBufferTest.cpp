@@ -342,6 +342,24 @@ int main(int argc, const char *argv[])
         test1.push_front(test2.begin(), test2.end());
         print(test1);
     }
+    cout << "--------------------------------------" << endl;
+    {
+        RingBuffer<int> test1(16, 12, 3);
+        init(test1);
+        print(test1);
+
+        for ( const auto& span : test1.spans() ) {
+            cout << "[";
+            for ( auto x : span ) {
+                cout << " " << x;
+            }
+            cout << " ] ";
+        }
+        cout << endl;
+
+        auto spans = RingBuffer<int>::spans(test1.cbegin() + 1, test1.cbegin() + 3);
+        cout << "spans = " << spans.size() << ", size = " << spans[0].size << endl;
+    }
     return 0;
 }
 
@@ -0,0 +1,71 @@
+#include "screen.h"
+#include <iostream>
+#include <string>
+
+using namespace leaf;
+using namespace std;
+
+
+// prints the escape sequences in a readable form
+void print(const string& out) {
+    for ( auto c : out ) {
+        if ( c == '\033' ) {
+            cout << "\\e";
+        }
+        else {
+            cout << c;
+        }
+    }
+    cout << " (" << out.size() << " bytes)" << endl;
+}
+
+void render(Screen& screen, uint32_t line, uint32_t col) {
+    string out;
+    screen.render(out, line, col);
+    print(out);
+}
+
+int main(int argc, const char *argv[])
+{
+    Screen screen;
+    screen.resize(4, 20);
+
+    screen.put(1, 1, "hello world", 11);
+    screen.put(2, 3, "\033[31mred\033[0m plain", 19);
+    render(screen, 4, 1);
+
+    cout << "--------------------------------------" << endl;
+    // nothing changed
+    screen.put(1, 1, "hello world", 11);
+    render(screen, 4, 1);
+
+    // small gaps are rewritten, large gaps are skipped
+    screen.put(1, 1, "jello wOrld", 11);
+    render(screen, 4, 1);
+    screen.put(1, 1, "Jello worlD", 11);
+    render(screen, 4, 1);
+
+    cout << "--------------------------------------" << endl;
+    // the style of the whole string
+    screen.put(3, 1, "abc", 3, "\033[1m");
+    render(screen, 1, 1);
+    screen.put(3, 1, "abc", 3, "\033[1m");
+    render(screen, 1, 1);
+
+    cout << "--------------------------------------" << endl;
+    // wide characters
+    cout << "next col = " << screen.put(4, 1, "简单a", 7) << endl;
+    render(screen, 1, 1);
+    // overwrite the right half of 简
+    screen.put(4, 2, "x", 1);
+    render(screen, 1, 1);
+    // the last column can not hold a wide character
+    cout << "next col = " << screen.put(4, 18, "ab单", 5) << endl;
+    render(screen, 1, 1);
+
+    cout << "--------------------------------------" << endl;
+    screen.invalidate();
+    render(screen, 1, 1);
+
+    return 0;
+}
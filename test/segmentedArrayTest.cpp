@@ -0,0 +1,101 @@
+#include "segmentedArray.h"
+#include "ringBuffer.h"
+#include <iostream>
+
+using namespace leaf;
+using namespace std;
+
+
+void print(const SpanList<int>& spans) {
+    for ( const auto& span : spans ) {
+        cout << "[";
+        for ( auto x : span ) {
+            cout << " " << x;
+        }
+        cout << " ] ";
+    }
+    cout << endl;
+}
+
+int main(int argc, const char *argv[])
+{
+    // 4 elements per block
+    SegmentedArray<int, 2> array;
+    for ( int i = 0; i < 10; ++i ) {
+        array.push_back(i);
+    }
+
+    array.publish();
+
+    auto old_snapshot = array.snapshot();
+    auto first = &old_snapshot[0];
+    auto fifth = &old_snapshot[4];
+    for ( int i = 10; i < 100; ++i ) {
+        array.push_back(i);
+    }
+    cout << "published size = " << array.size() << ", blocks = " << array.blockCount() << endl;
+    array.publish();
+
+    auto snapshot = array.snapshot();
+    cout << "size = " << snapshot.size() << ", epoch = " << snapshot.epoch()
+        << ", old size = " << old_snapshot.size() << ", old epoch = " << old_snapshot.epoch() << endl;
+    cout << "stable addresses: " << boolalpha << (first == &snapshot[0] && fifth == &snapshot[4]) << endl;
+
+    for ( auto iter = snapshot.cbegin() + 95; iter != snapshot.cend(); ++iter ) {
+        cout << *iter << " ";
+    }
+    cout << endl;
+
+    cout << "--------------------------------------" << endl;
+    print(snapshot.spans(0, 10));
+    print(snapshot.spans(3, 9));
+    print(snapshot.spans(5, 7));
+    print(snapshot.spans(7, 7));
+
+    cout << "--------------------------------------" << endl;
+    RingBuffer<int> ring_buffer;
+    ring_buffer.push_back(-1);
+    for ( const auto& span : snapshot.spans(2, 13) ) {
+        ring_buffer.append(span.data, span.size);
+    }
+    for ( auto x : ring_buffer ) {
+        cout << x << " ";
+    }
+    cout << endl;
+
+    // the snapshots still hold the old blocks
+    array.clear();
+    array.push_back(100);
+    array.publish();
+    cout << "size = " << array.size() << ", blocks = " << array.blockCount()
+        << ", array[0] = " << array.snapshot()[0] << ", old snapshot[99] = " << snapshot[99] << endl;
+
+    cout << "--------------------------------------" << endl;
+    for ( int i = 101; i < 110; ++i ) {
+        array.push_back(i);
+    }
+    array.publish();
+
+    // the popped elements stay in the snapshots taken before
+    auto before_pop = array.snapshot();
+    array.pop_front(6);
+    cout << "writer size = " << array.writerSize() << ", writer[0] = " << array.writerAt(0)
+        << ", published size = " << array.size() << endl;
+    array.publish();
+    auto after_pop = array.snapshot();
+    cout << "size = " << after_pop.size() << ", first = " << after_pop.first() << ", blocks = "
+        << array.blockCount() << ", old snapshot[0] = " << before_pop[0] << endl;
+    for ( auto x : after_pop ) {
+        cout << x << " ";
+    }
+    cout << endl;
+    print(after_pop.spans(0, after_pop.size()));
+
+    array.pop_front(100);
+    array.push_back(110);
+    array.publish();
+    cout << "size = " << array.size() << ", first = " << array.snapshot().first() << ", blocks = "
+        << array.blockCount() << ", array[0] = " << array.snapshot()[0] << endl;
+
+    return 0;
+}
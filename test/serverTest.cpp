@@ -0,0 +1,116 @@
+#include "protocol.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace leaf;
+using namespace std;
+
+
+bool receive(int fd, void* data, size_t len) {
+    size_t received = 0;
+    while ( received < len ) {
+        auto n = recv(fd, static_cast<char*>(data) + received, len - received, 0);
+        if ( n <= 0 ) {
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+string query(const string& pattern, uint32_t top) {
+    QueryHeader header{ static_cast<uint32_t>(pattern.length()), top };
+    string frame(reinterpret_cast<const char*>(&header), sizeof(header));
+    return frame + pattern;
+}
+
+void printReply(int fd) {
+    ReplyHeader reply;
+    if ( !receive(fd, &reply, sizeof(reply)) ) {
+        cout << "no reply" << endl;
+        return;
+    }
+    cout << reply.line_count << " of " << reply.match_count << " matches, " << reply.total << " lines" << endl;
+    for ( uint32_t i = 0; i < reply.line_count; ++i ) {
+        ReplyLine line;
+        receive(fd, &line, sizeof(line));
+        string text(line.len, '\0');
+        vector<HighlightPos> positions(line.position_count);
+        receive(fd, &text[0], text.length());
+        receive(fd, positions.data(), sizeof(HighlightPos) * positions.size());
+        cout << "    [" << text << "] weight " << (line.weight > 0 ? "> 0" : "<= 0") << ", matched:";
+        for ( const auto& pos : positions ) {
+            cout << " " << text.substr(pos.col, pos.len);
+        }
+        cout << endl;
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    string dir(argv[0]);
+    dir = dir.substr(0, dir.rfind('/') + 1);
+    string input = "/tmp/serverTest." + to_string(getpid());
+    string socket_path = input + ".sock";
+    {
+        ofstream out(input);
+        out << "src/app.cpp\nsrc/server.cpp\nREADME.md\nsrc/client.cpp\ntest/Makefile\n";
+    }
+
+    auto pid = fork();
+    if ( pid == 0 ) {
+        int fd = open(input.c_str(), O_RDONLY);
+        dup2(fd, STDIN_FILENO);
+        string arg = "--serve=" + socket_path;
+        execl((dir + "yy").c_str(), "yy", arg.c_str(), nullptr);
+        _exit(127);
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path.c_str());
+    int fd = -1;
+    for ( int i = 0; i < 500; ++i ) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ( connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0 ) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+        usleep(10000);
+    }
+    cout << "connected: " << boolalpha << (fd != -1) << endl;
+
+    // the queries are pipelined, and answered in order
+    string frames = query("srvcpp", 5) + query("cpp", 2) + query("", 3) + query("xyz", 5);
+    send(fd, frames.data(), frames.length(), 0);
+    for ( int i = 0; i < 4; ++i ) {
+        printReply(fd);
+    }
+
+    // a pattern longer than MaxPatternLen closes the connection
+    frames = query(string(MaxPatternLen + 1, 'a'), 1);
+    send(fd, frames.data(), frames.length(), 0);
+    char c;
+    cout << "closed: " << (recv(fd, &c, 1, 0) == 0) << endl;
+    close(fd);
+
+    kill(pid, SIGTERM);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    cout << "exit status: " << WEXITSTATUS(status) << ", socket removed: "
+         << (access(socket_path.c_str(), F_OK) != 0) << endl;
+
+    unlink(input.c_str());
+    return 0;
+}
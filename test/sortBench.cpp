@@ -0,0 +1,80 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <memory>
+#include <thread>
+#include "fuzzyEngine.h"
+
+using namespace leaf;
+using namespace std;
+
+/**
+ * usage: sortBench [COUNT]...
+ * e.g., sortBench 1000000 10000000 50000000
+ */
+
+void generate(MatchResult* results, uint32_t count) {
+    // weights of real matches are clustered, so there are a lot of equal weights
+    std::mt19937 gen(count);
+    std::uniform_int_distribution<int32_t> dist(0, 4000000);
+    for ( uint32_t i = 0; i < count; ++i ) {
+        results[i].weight = dist(gen);
+        results[i].index = i;
+    }
+}
+
+bool isSorted(const MatchResult* results, uint32_t count, bool stable) {
+    for ( uint32_t i = 1; i < count; ++i ) {
+        if ( results[i-1].weight < results[i].weight ) {
+            return false;
+        }
+        if ( stable && results[i-1].weight == results[i].weight
+             && results[i-1].index > results[i].index ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double bench(FuzzyEngine& engine, MatchResult* results, uint32_t count, SortMethod method) {
+    using namespace std::chrono;
+
+    generate(results, count);
+    auto start_time = steady_clock::now();
+    engine.sort(results, count, method);
+    auto end_time = steady_clock::now();
+    if ( !isSorted(results, count, method == SortMethod::Radix) ) {
+        cout << "sort failed!" << endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    return duration_cast<microseconds>(end_time - start_time).count() / 1000.0;
+}
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint32_t> counts;
+    for ( int i = 1; i < argc; ++i ) {
+        counts.push_back(std::stoul(argv[i]));
+    }
+    if ( counts.empty() ) {
+        counts = { 1000000, 5000000, 10000000, 50000000 };
+    }
+
+    auto cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    FuzzyEngine engine(cpus);
+
+    printf("cpus: %u\n", cpus);
+    printf("%12s %12s %12s\n", "count", "merge(ms)", "radix(ms)");
+    for ( auto count : counts ) {
+        std::unique_ptr<MatchResult[]> results(new MatchResult[count]);
+        auto merge_time = bench(engine, results.get(), count, SortMethod::Merge);
+        auto radix_time = bench(engine, results.get(), count, SortMethod::Radix);
+        printf("%12u %12.2f %12.2f\n", count, merge_time, radix_time);
+    }
+
+    return 0;
+}